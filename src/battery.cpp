@@ -32,6 +32,13 @@
 
 // #define SIMULATE_VOLTAGE 3.9
 
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+RTC_DATA_ATTR RtcBatteryData myRtcBatteryData = {0};
+RTC_DATA_ATTR BatteryEstimatorData myBatteryEstimatorData = {0};
+#else
+BatteryEstimatorData myBatteryEstimatorData = {0};
+#endif
+
 BatteryVoltage::BatteryVoltage(BatteryConfigInterface *batteryConfig, int pin) {
   _batteryConfig = batteryConfig;
   _pin = pin;
@@ -52,74 +59,221 @@ void BatteryVoltage::read() {
   // The analog pin can only handle 3.3V maximum voltage so we need to reduce
   // the voltage (from max 5V)
   float factor = _batteryConfig->getVoltageFactor();  // Default value is 1.63
-  int v = 0;
+  uint32_t samples[BATTERY_SAMPLES];
+  float v = 0;
 
   if (_pin >= 0) {
-    v = analogRead(_pin);
-  }
-
-  // An ESP8266 has a ADC range of 0-1023 and a maximum voltage of 3.3V
-  // An ESP32 has an ADC range of 0-4095 and a maximum voltage of 3.3V
+    // Single readings are noisy, so take several and remove the outliers
+    for (int i = 0; i < BATTERY_SAMPLES; i++) {
+#if defined(ESP8266)
+      samples[i] = analogRead(_pin);
+#else
+      // Uses the ADC calibration stored in eFuse, returns mV at the pin
+      samples[i] = analogReadMilliVolts(_pin);
+#endif
+    }
 
-  // Max input values per board (2.5V is the a good setting)
-  // ESP32-S2: 2500mV
-  // ESP32-S3: 3100mV
-  // ESP32-C3: 2500mV
-  // ESP32-C6: 3300mV
+    v = reduceBatterySamples(&samples[0], BATTERY_SAMPLES, BATTERY_TRIM);
+  }
 
+  // An ESP8266 has a ADC range of 0-1023 and a maximum voltage of 3.3V, on
+  // the ESP32 the calibrated value is already in mV.
 #if defined(ESP8266)
-  _batteryVoltage = ((3.3 / 1023) * v) * factor;
-#elif defined(ESP32S2)
-  _batteryVoltage = ((2.5 / ((1 << SOC_ADC_MAX_BITWIDTH) - 1)) * v) * factor;
-#elif defined(ESP32S3)
-  _batteryVoltage = ((3.1 / ((1 << SOC_ADC_MAX_BITWIDTH) - 1)) * v) * factor;
-#elif defined(ESP32C3)
-  _batteryVoltage = ((2.5 / ((1 << SOC_ADC_MAX_BITWIDTH) - 1)) * v) * factor;
+  _rawVoltage = ((3.3 / 1023) * v) * factor;
+#else
+  _rawVoltage = (v / 1000) * factor;
 #endif
 
+#if defined(SIMULATE_VOLTAGE)
+  _rawVoltage = SIMULATE_VOLTAGE;
+#endif
+
+  _batteryVoltage = smoothVoltage(_rawVoltage);
+
 #if LOG_LEVEL == 6
-  Log.verbose(
-      F("BATT: Reading voltage level. Factor=%F Value=%d, Voltage=%F." CR),
-      factor, v, _batteryVoltage);
+  Log.verbose(F("BATT: Reading voltage level. Factor=%F Value=%F, Voltage=%F, "
+                "Smoothed=%F." CR),
+              factor, v, _rawVoltage, _batteryVoltage);
 #endif
+}
 
-#if defined(SIMULATE_VOLTAGE)
-  _batteryVoltage = SIMULATE_VOLTAGE;
+void BatteryVoltage::reset() {
+  _hasVoltage = false;
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  myRtcBatteryData.IsDataAvailable = 0;
 #endif
 }
 
+float BatteryVoltage::smoothVoltage(float v) {
+  float prev = NAN;
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  if (myRtcBatteryData.IsDataAvailable == BATTERY_RTC_DATA_AVAILABLE)
+    prev = myRtcBatteryData.Voltage;
+#endif
+
+  if (_hasVoltage) prev = _batteryVoltage;
+
+  // A large jump means that the battery has been charged or replaced
+  if (!isnan(prev) && fabs(v - prev) < BATTERY_RESET_DELTA)
+    v = prev + BATTERY_SMOOTHING * (v - prev);
+
+  _hasVoltage = true;
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  myRtcBatteryData.IsDataAvailable = BATTERY_RTC_DATA_AVAILABLE;
+  myRtcBatteryData.Voltage = v;
+#endif
+
+  return v;
+}
+
+float reduceBatterySamples(uint32_t *samples, int count, int trim) {
+  if (count <= 0) return 0;
+
+  std::sort(samples, samples + count);
+
+  if (count - 2 * trim <= 0) {
+    if (count % 2) return samples[count / 2];
+    return (samples[count / 2 - 1] + samples[count / 2]) / 2.0;
+  }
+
+  uint32_t sum = 0;
+
+  for (int i = trim; i < count - trim; i++) sum += samples[i];
+
+  return static_cast<float>(sum) / (count - 2 * trim);
+}
+
+struct BatteryCurvePoint {
+  float voltage;
+  float percent;
+};
+
+// Resting voltage vs remaining charge at low load, highest voltage first
+const BatteryCurvePoint curveLithiumIon[] = {
+    {4.20, 100}, {4.06, 90}, {3.98, 80}, {3.92, 70}, {3.87, 60}, {3.82, 50},
+    {3.79, 40},  {3.77, 30}, {3.74, 20}, {3.68, 10}, {3.45, 5},  {3.00, 0}};
+
+const BatteryCurvePoint curveLiPo[] = {
+    {4.20, 100}, {4.11, 90}, {4.02, 80}, {3.95, 70}, {3.87, 60}, {3.84, 50},
+    {3.80, 40},  {3.77, 30}, {3.73, 20}, {3.69, 10}, {3.61, 5},  {3.30, 0}};
+
 float getBatteryPercentage(float value, BatteryType type) {
-  constexpr float MAX_VOLTAGE_LITHIUMION = 4.20;
-  constexpr float MIN_VOLTAGE_LITHIUMION = 3.00;
-  constexpr float MAX_VOLTAGE_LIPO = 4.20;
-  constexpr float MIN_VOLTAGE_LIPO = 3.30;
-
-  float percentage;
-
-  switch (type) {
-    case BatteryType::LiPo:
-      if (value >= MAX_VOLTAGE_LIPO) return 100;
-      if (value <= MIN_VOLTAGE_LIPO) return 0;
-
-      percentage =
-          ((value - MIN_VOLTAGE_LIPO) / (MAX_VOLTAGE_LIPO - MIN_VOLTAGE_LIPO)) *
-          100.0;
-      percentage = constrain(percentage, 0.0, 100.0);
-      return round(percentage);
-
-    default:
-    case BatteryType::LithiumIon:
-      if (value >= MAX_VOLTAGE_LITHIUMION) return 100.0f;
-      if (value <= MIN_VOLTAGE_LITHIUMION) return 0.0f;
-
-      percentage = ((value - MIN_VOLTAGE_LITHIUMION) /
-                    (MAX_VOLTAGE_LITHIUMION - MIN_VOLTAGE_LITHIUMION)) *
-                   100.0;
-      percentage = constrain(percentage, 0.0, 100.0);
-      return round(percentage);
+  const BatteryCurvePoint *curve = curveLithiumIon;
+  int size = sizeof(curveLithiumIon) / sizeof(BatteryCurvePoint);
+
+  if (type == BatteryType::LiPo) {
+    curve = curveLiPo;
+    size = sizeof(curveLiPo) / sizeof(BatteryCurvePoint);
+  }
+
+  if (value >= curve[0].voltage) return 100.0f;
+  if (value <= curve[size - 1].voltage) return 0.0f;
+
+  for (int i = 1; i < size; i++) {
+    if (value >= curve[i].voltage) {
+      float percentage =
+          curve[i].percent + (value - curve[i].voltage) /
+                                 (curve[i - 1].voltage - curve[i].voltage) *
+                                 (curve[i - 1].percent - curve[i].percent);
+      return round(constrain(percentage, 0.0, 100.0));
+    }
   }
 
   return 0.0;
 }
 
+void BatteryEstimator::addWake(float awakeTime, float radioTime,
+                               int sleepInterval, float percent) {
+  constexpr float alpha = 0.2;
+
+  if (!_data->IsDataAvailable) {
+    _data->IsDataAvailable = 1;
+    _data->AwakeTime = awakeTime;
+    _data->RadioTime = radioTime;
+    _data->AnchorPercent = percent;
+    _data->ConsumedMah = 0;
+  } else {
+    _data->AwakeTime += alpha * (awakeTime - _data->AwakeTime);
+    _data->RadioTime += alpha * (radioTime - _data->RadioTime);
+  }
+
+  // The counted charge will drift over time (and the battery can be
+  // recharged), so start over from the discharge curve when they disagree.
+  float capacity = _batteryConfig->getBatteryCapacity();
+  float counted = capacity > 0
+                      ? 100.0 * getRemainingMah(percent) / capacity
+                      : percent;
+
+  if (fabs(counted - percent) > BATTERY_REANCHOR_PERCENT) {
+    _data->AnchorPercent = percent;
+    _data->ConsumedMah = 0;
+  }
+
+  _data->ConsumedMah +=
+      getWakeMah(awakeTime, radioTime) +
+      sleepInterval * _batteryConfig->getBatterySleepCurrent() / 1000.0 / 3600;
+}
+
+float BatteryEstimator::getRemainingMah(float percent) const {
+  float capacity = _batteryConfig->getBatteryCapacity();
+
+  if (!_data->IsDataAvailable) return capacity * percent / 100;
+
+  float remaining = capacity * _data->AnchorPercent / 100 - _data->ConsumedMah;
+  return remaining < 0 ? 0 : remaining;
+}
+
+float BatteryEstimator::getAverageCurrent(int sleepInterval) const {
+  float awake = getAwakeTime();
+  float cycle = awake + sleepInterval;
+
+  if (cycle <= 0) return BATTERY_AWAKE_CURRENT;
+
+  return (getWakeMah(awake, getRadioTime()) * 3600 +
+          sleepInterval * _batteryConfig->getBatterySleepCurrent() / 1000.0) /
+         cycle;
+}
+
+float BatteryEstimator::getRemainingDays(float percent,
+                                         int sleepInterval) const {
+  float current = getAverageCurrent(sleepInterval);
+
+  if (current <= 0) return NAN;
+
+  return getRemainingMah(percent) / current / 24;
+}
+
+int BatteryEstimator::getSleepIntervalForDays(float percent, float days,
+                                              int minInterval,
+                                              int maxInterval) const {
+  // Average current that makes the remaining charge last the requested days
+  float budget = getRemainingMah(percent) / (days * 24);
+  float sleepCurrent = _batteryConfig->getBatterySleepCurrent() / 1000.0;
+
+  if (budget <= sleepCurrent) return maxInterval;
+
+  float awake = getAwakeTime();
+  float interval =
+      (getWakeMah(awake, getRadioTime()) * 3600 - awake * budget) /
+      (budget - sleepCurrent);
+
+  if (interval < minInterval) return minInterval;
+  if (interval > maxInterval) return maxInterval;
+  return static_cast<int>(ceil(interval));
+}
+
+int BatteryEstimator::getBatterySavingInterval(float percent,
+                                               int sleepInterval) const {
+  if (percent >= BATTERY_SAVING_PERCENT) return sleepInterval;
+
+  int interval =
+      getSleepIntervalForDays(percent, BATTERY_SAVING_DAYS, sleepInterval,
+                              BATTERY_SAVING_MAX_INTERVAL);
+  return interval < BATTERY_SAVING_MIN_INTERVAL ? BATTERY_SAVING_MIN_INTERVAL
+                                                : interval;
+}
+
 // EOF
@@ -26,6 +26,39 @@
 
 #include <Arduino.h>
 
+constexpr auto BATTERY_SAMPLES = 16;   // ADC readings per measurement
+constexpr auto BATTERY_TRIM = 4;       // Lowest/highest readings to discard
+constexpr auto BATTERY_SMOOTHING = 0.3;  // Weight of a new measurement
+constexpr auto BATTERY_RESET_DELTA = 0.25;  // V, restart smoothing (charged)
+
+// Typical current draw used by the runtime estimator
+constexpr auto BATTERY_AWAKE_CURRENT = 30.0;  // mA, cpu and gyro active
+constexpr auto BATTERY_RADIO_CURRENT = 80.0;  // mA, added when wifi/ble is on
+constexpr auto BATTERY_DEFAULT_AWAKE_TIME = 5.0;  // s, until measured
+constexpr auto BATTERY_DEFAULT_RADIO_TIME = 4.0;  // s, until measured
+constexpr auto BATTERY_REANCHOR_PERCENT = 10.0;   // Max drift from voltage
+constexpr auto BATTERY_SAVING_DAYS = 30.0;  // Target runtime in battery saving
+constexpr auto BATTERY_SAVING_PERCENT = 30.0;      // Below this level
+constexpr auto BATTERY_SAVING_MIN_INTERVAL = 3600;  // s, fixed interval before
+constexpr auto BATTERY_SAVING_MAX_INTERVAL = 10800;  // s, below ESP8266 max
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+
+#include <esp_attr.h>
+
+#define BATTERY_RTC_DATA_AVAILABLE \
+  static_cast<uint8_t>(107)  // Unique number to flag resume data is available
+
+// Smoothed battery voltage kept between deep sleep cycles
+struct RtcBatteryData {
+  uint8_t IsDataAvailable;
+  float Voltage;
+};
+
+extern RTC_DATA_ATTR RtcBatteryData myRtcBatteryData;
+
+#endif  // ESP32 && ENABLE_RTCMEM
+
 enum BatteryType {
   LiPo = 0,
   LithiumIon = 1  // 18650 battery
@@ -35,22 +68,82 @@ class BatteryConfigInterface {
  public:
   virtual float getVoltageFactor() const = 0;
   virtual BatteryType getBatteryType() const = 0;
+  virtual int getBatteryCapacity() const = 0;      // mAh
+  virtual int getBatterySleepCurrent() const = 0;  // uA
+};
+
+// Consumption history used for coulomb counting, kept in RTC memory when
+// available so it survives deep sleep.
+struct BatteryEstimatorData {
+  uint8_t IsDataAvailable;
+  float AwakeTime;      // s, average per wake
+  float RadioTime;      // s, average per wake
+  float ConsumedMah;    // Used since the anchor point
+  float AnchorPercent;  // Charge level from the discharge curve at anchor
+};
+
+extern BatteryEstimatorData myBatteryEstimatorData;
+
+class BatteryEstimator {
+ private:
+  BatteryConfigInterface *_batteryConfig;
+  BatteryEstimatorData *_data;
+
+  float getAwakeTime() const {
+    return _data->IsDataAvailable ? _data->AwakeTime
+                                  : BATTERY_DEFAULT_AWAKE_TIME;
+  }
+  float getRadioTime() const {
+    return _data->IsDataAvailable ? _data->RadioTime
+                                  : BATTERY_DEFAULT_RADIO_TIME;
+  }
+  float getWakeMah(float awakeTime, float radioTime) const {
+    return (awakeTime * BATTERY_AWAKE_CURRENT +
+            radioTime * BATTERY_RADIO_CURRENT) /
+           3600;
+  }
+
+ public:
+  BatteryEstimator(BatteryConfigInterface *batteryConfig,
+                   BatteryEstimatorData *data)
+      : _batteryConfig(batteryConfig), _data(data) {}
+
+  void addWake(float awakeTime, float radioTime, int sleepInterval,
+               float percent);
+  float getRemainingMah(float percent) const;
+  float getAverageCurrent(int sleepInterval) const;  // mA
+  float getRemainingDays(float percent, int sleepInterval) const;
+  int getSleepIntervalForDays(float percent, float days, int minInterval,
+                              int maxInterval) const;
+  // Sleep interval when battery saving is enabled, never shorter than the
+  // fixed interval that was used before the estimator
+  int getBatterySavingInterval(float percent, int sleepInterval) const;
 };
 
 class BatteryVoltage {
  private:
   float _batteryVoltage = 0;
+  float _rawVoltage = 0;
+  bool _hasVoltage = false;
   int _pin;
   BatteryConfigInterface *_batteryConfig = nullptr;
 
+  float smoothVoltage(float v);
+
  public:
   explicit BatteryVoltage(BatteryConfigInterface *batteryConfig, int pin = -1);
   void read();
-  float getVoltage() const { return _batteryVoltage; }
+  void reset();  // Restart smoothing, e.g. when voltage factor changed
+  float getVoltage() const { return _batteryVoltage; }  // Smoothed
+  float getRawVoltage() const { return _rawVoltage; }   // Last measurement
 };
 
 float getBatteryPercentage(float value, BatteryType type);
 
+// Sorts the samples and returns the mean after removing the trim lowest and
+// highest values, the median is used if nothing is left after trimming.
+float reduceBatterySamples(uint32_t *samples, int count, int trim);
+
 extern BatteryVoltage myBatteryVoltage;
 
 #endif  // SRC_BATTERY_HPP_
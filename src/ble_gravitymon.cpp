@@ -23,346 +23,302 @@
 
 #if defined(ENABLE_BLE) && defined(GRAVITYMON)
 
+#include <esp_pm.h>
+
 #include <ble_gravitymon.hpp>
+#include <bleencoder.hpp>
 #include <log.hpp>
-#include <string>
+#include <pushscheduler.hpp>
+
+class BleAckCallbacks : public NimBLECharacteristicCallbacks {
+ private:
+  SemaphoreHandle_t _semaphore;
+
+ public:
+  explicit BleAckCallbacks(SemaphoreHandle_t semaphore)
+      : _semaphore(semaphore) {}
+
+  void onWrite(NimBLECharacteristic*, NimBLEConnInfo&) override {
+    xSemaphoreGive(_semaphore);
+  }
+};
+
+// The gateway writes the sequence to read from as 4 bytes big endian
+class BleHistoryCursorCallbacks : public NimBLECharacteristicCallbacks {
+ private:
+  BleHistory* _history;
+
+ public:
+  explicit BleHistoryCursorCallbacks(BleHistory* history)
+      : _history(history) {}
+
+  void onWrite(NimBLECharacteristic* c, NimBLEConnInfo&) override {
+    NimBLEAttValue v = c->getValue();
+    if (v.length() != sizeof(BleUint32)) return;
+
+    _history->setCursor(reinterpret_cast<const BleUint32*>(v.data())->get());
+    Log.notice(F("BLE : History read from %u, %d records stored." CR),
+               _history->getCursor(), _history->getCount());
+  }
+};
+
+class BleHistoryRecordsCallbacks : public NimBLECharacteristicCallbacks {
+ private:
+  BleHistory* _history;
 
-// Tilt UUID variants and data format, based on tilt-sim
-//
-// https://github.com/spouliot/tilt-sim
-//
-// Tilt data format is described here. Only SG and Temp is transmitted over BLE.
-// https://kvurd.com/blog/tilt-hydrometer-ibeacon-data-format/
+ public:
+  explicit BleHistoryRecordsCallbacks(BleHistory* history)
+      : _history(history) {}
 
-void BleSender::init() {
+  void onRead(NimBLECharacteristic* c, NimBLEConnInfo&) override {
+    uint8_t buf[BLE_HISTORY_PAGE_SIZE];
+    size_t len = _history->readPage(buf, myPushScheduler.getDeviceClock());
+    c->setValue(buf, len);
+  }
+};
+
+void BleSender::init(int interval, int window, bool ack, BleHistory* history) {
   if (_initFlag) return;
 
+  _interval = interval;
+  _window = window;
+  _slot = window;
+  _ack = ack;
+  _history = history;
+  _chipId = getBleChipId(ESP.getEfuseMac());
+  _ackSemaphore = xSemaphoreCreateBinary();
+
+  uint32_t start = millis();
+
+#if !defined(BLE_DISABLE_RAW_ADV)
+  // Broadcasting does not need the host, only the connectable modes do
+  _raw = !_ack && !_history && _hci.begin();
+#endif
+
+  if (_raw)
+    esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, ESP_PWR_LVL_P9);
+  else
+    initHost();
+
+  Log.notice(F("BLE : Started %s in %dms." CR),
+             _raw ? "controller" : "NimBLE host", millis() - start);
+  _initFlag = true;
+}
+
+void BleSender::initHost() {
   BLEDevice::init("gravitymon");
   _advertising = BLEDevice::getAdvertising();
 
   esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_DEFAULT, ESP_PWR_LVL_P9);
   esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, ESP_PWR_LVL_P9);
-  esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_SCAN, ESP_PWR_LVL_P9);
 
-  _initFlag = true;
+  // Interval is in units of 0.625 ms
+  _advertising->setMinInterval(_interval * 8 / 5);
+  _advertising->setMaxInterval(_interval * 8 / 5);
+
+  if (_ack || _history) {
+    _server = BLEDevice::createServer();
+    _server->advertiseOnDisconnect(false);
+    _service = _server->createService(BLE_ACK_SERVICE_UUID);
+    _characteristic = _service->createCharacteristic(
+        BLE_ACK_CHARACTERISTIC_UUID,
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR);
+    _characteristic->setCallbacks(new BleAckCallbacks(_ackSemaphore));
+
+    if (_history) {
+      _service
+          ->createCharacteristic(BLE_HISTORY_CURSOR_UUID,
+                                 NIMBLE_PROPERTY::WRITE)
+          ->setCallbacks(new BleHistoryCursorCallbacks(_history));
+      _service
+          ->createCharacteristic(BLE_HISTORY_RECORDS_UUID,
+                                 NIMBLE_PROPERTY::READ, BLE_HISTORY_PAGE_SIZE)
+          ->setCallbacks(new BleHistoryRecordsCallbacks(_history));
+    }
+
+    _service->start();
+  }
 }
 
-void BleSender::sendEddystoneData(float battery, float tempC, float gravSG,
-                                  float angle) {
-  Log.info(F("Starting eddystone data transmission" CR));
-
-  char beacon_data[25];
+// Used when the controller does not accept a command, the NimBLE host is
+// slower to start but the advertising still goes out.
+void BleSender::useHost() {
+  Log.warning(F("BLE : Controller advertising failed, using NimBLE host." CR));
+  _hci.end();
+  _raw = false;
+  initHost();
+}
 
-  uint16_t g = isnan(gravSG) ? 0xffff : gravSG * 10000;
-  uint16_t t = isnan(tempC) ? 0xffff : tempC * 1000;
-  uint16_t b = isnan(battery) ? 0xffff : battery * 1000;
-  uint16_t a = isnan(angle) ? 0xffff : angle * 100;
-  uint32_t chipId = 0;
+// Starts advertising the data and waits for the slot or an ack from a
+// gateway, the task is blocked and not polling while waiting.
+void BleSender::advertise(const uint8_t* adv, size_t advLen,
+                          const uint8_t* resp, size_t respLen) {
+  setAdvertisement(adv, advLen, resp, respLen);
 
-  for (int i = 0; i < 17; i = i + 8) {
-    chipId |= ((ESP.getEfuseMac() >> (40 - i)) & 0xff) << i;
+  if (_raw && !_hci.enable(true)) {
+    useHost();
+    setAdvertisement(adv, advLen, resp, respLen);
   }
 
-  beacon_data[0] = 0x20;  // Eddystone Frame Type (Unencrypted Eddystone-TLM)
-  beacon_data[1] = 0x00;  // TLM version
-  beacon_data[2] = (b >> 8);
-  beacon_data[3] = (b & 0xFF);
-  beacon_data[4] = (t >> 8);
-  beacon_data[5] = (t & 0xFF);
-  beacon_data[6] = (g >> 8);
-  beacon_data[7] = (g & 0xFF);
-  beacon_data[8] = (a >> 8);
-  beacon_data[9] = (a & 0xFF);
-  beacon_data[10] = ((chipId & 0xFF000000) >> 24);
-  beacon_data[11] = ((chipId & 0xFF0000) >> 16);
-  beacon_data[12] = ((chipId & 0xFF00) >> 8);
-  beacon_data[13] = (chipId & 0xFF);
+  if (_server) _advertising->setConnectableMode(BLE_GAP_CONN_MODE_UND);
 
-  BLEAdvertisementData advData = BLEAdvertisementData();
-  BLEAdvertisementData respData = BLEAdvertisementData();
+  xSemaphoreTake(_ackSemaphore, 0);  // Drop an ack from the last beacon
+  enterLowPower();
 
-  respData.setFlags(0x06);
-  respData.setCompleteServices(BLEUUID("feaa"));
-  respData.setServiceData(BLEUUID("feaa"), std::string(beacon_data, 14));
+  uint32_t start = millis();
+  if (!_raw) _advertising->start();
+  bool acked = xSemaphoreTake(_ackSemaphore, pdMS_TO_TICKS(_slot)) == pdTRUE;
+  if (!_raw)
+    _advertising->stop();
+  else if (!_hci.enable(false))
+    Log.warning(F("BLE : Failed to stop controller advertising." CR));
+  uint32_t time = millis() - start;
 
-  advData.setName("gravitymon");
-  _advertising->setAdvertisementData(advData);
-  _advertising->setScanResponseData(respData);
+  exitLowPower();
 
-  _advertising->start();
-  delay(_beaconTime);
-  _advertising->stop();
-}
-
-void BleSender::sendTiltData(String& color, float tempF, float gravSG,
-                             bool tiltPro) {
-  Log.info(F("BLE : Starting tilt data transmission" CR));
-
-  if (!color.compareTo("red"))
-    _uuid = BLEUUID::fromString("A495BB10-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("green"))
-    _uuid = BLEUUID::fromString("A495BB20-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("black"))
-    _uuid = BLEUUID::fromString("A495BB30-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("purple"))
-    _uuid = BLEUUID::fromString("A495BB40-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("orange"))
-    _uuid = BLEUUID::fromString("A495BB50-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("blue"))
-    _uuid = BLEUUID::fromString("A495BB60-C5B1-4B44-B512-1370F02D74DE");
-  else if (!color.compareTo("yellow"))
-    _uuid = BLEUUID::fromString("A495BB70-C5B1-4B44-B512-1370F02D74DE");
-  else  // if (_color.compareTo("pink"))
-    _uuid = BLEUUID::fromString("A495BB80-C5B1-4B44-B512-1370F02D74DE");
-
-  uint16_t gravity =
-      isnan(gravSG) ? 0xffff
-                    : gravSG * 1000;  // SG * 1000 or SG * 10000 for Tilt Pro/HD
-  uint16_t temperature =
-      isnan(tempF) ? 0xffff : tempF;  // Deg F _or_ Deg F * 10 for Tilt Pro/HD
-
-  if (tiltPro) {
-    gravity = isnan(gravSG) ? 0xffff : gravSG * 10000;
-    temperature = isnan(tempF) ? 0xffff : tempF * 10;
+  if (_server) {
+    for (uint16_t handle : _server->getPeerDevices())
+      _server->disconnect(handle);
   }
 
-  BLEBeacon beacon = BLEBeacon();
-  beacon.setManufacturerId(0x4C00);
-  beacon.setProximityUUID(_uuid);
-  beacon.setMajor(temperature);
-  beacon.setMinor(gravity);
+  _radioTime += time;
+  Log.notice(F("BLE : Advertised for %dms, %s." CR), time,
+             acked ? "acknowledged by gateway" : "window ended");
+}
 
-  BLEAdvertisementData advData = BLEAdvertisementData();
-  advData.setFlags(0x04);
-  const NimBLEBeacon::BeaconData& beaconData = beacon.getData();
-  // advData.setManufacturerData(beacon.getData());
-  advData.setManufacturerData(std::string(
-      reinterpret_cast<const char*>(&beaconData), sizeof(beaconData)));
+// With tickless idle the cpu light sleeps between the advertising events and
+// is woken by the controller, otherwise the clock is lowered for the window.
+void BleSender::enterLowPower() {
+  _cpuFreq = getCpuFrequencyMhz();
 
-  _advertising->setAdvertisementData(advData);
-  // _advertising->setAdvertisementType(BLE_GAP_CONN_MODE_NON);
-  _advertising->setConnectableMode(BLE_GAP_CONN_MODE_NON);
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  esp_pm_config_t pm = {static_cast<int>(_cpuFreq), BLE_LOW_POWER_MHZ, true};
+  esp_pm_configure(&pm);
+#else
+  if (_cpuFreq > BLE_LOW_POWER_MHZ) setCpuFrequencyMhz(BLE_LOW_POWER_MHZ);
+#endif
+}
 
-  _advertising->start();
-  delay(_beaconTime);
-  _advertising->stop();
+void BleSender::exitLowPower() {
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  esp_pm_config_t pm = {static_cast<int>(_cpuFreq),
+                        static_cast<int>(_cpuFreq), false};
+  esp_pm_configure(&pm);
+#else
+  if (_cpuFreq > BLE_LOW_POWER_MHZ) setCpuFrequencyMhz(_cpuFreq);
+#endif
 }
 
-void BleSender::sendRaptV1Data(float batteryPercentage, float tempC,
-                               float gravSG, float angle) {
-  Log.info(F("Starting rapt v1 beacon data transmission" CR));
+void BleSender::sendEddystoneData(float battery, float tempC, float gravSG,
+                                  float angle) {
+  Log.info(F("Starting eddystone data transmission" CR));
 
-  _advertising->stop();
+  uint8_t buf[BLE_PAYLOAD_SIZE + 2];
+  buf[0] = 0xaa;  // Eddystone service uuid, little endian
+  buf[1] = 0xfe;
+  size_t len = encodeEddystone(buf + 2, _chipId, battery, tempC, gravSG, angle);
 
-  uint16_t t = isnan(tempC) ? 0xffff : (tempC + 273.15) * 128.0;
-  uint16_t b = isnan(batteryPercentage) ? 0xffff : batteryPercentage * 256;
-  uint16_t a = isnan(angle) ? 0xffff : angle * 16;
-  uint32_t chipId = 0;
+  uint8_t adv[BLE_ADV_DATA_SIZE], resp[BLE_ADV_DATA_SIZE];
+  const uint8_t flags = 0x06;
+  const char* name = "gravitymon";
 
-  union {  // For mapping the raw float to bytes
-    float f;
-    uint8_t b[4];
-  } floatUnion;
+  size_t advLen = addAdStructure(adv, 0, BLE_AD_COMPLETE_NAME,
+                                 reinterpret_cast<const uint8_t*>(name),
+                                 strlen(name));
+  size_t respLen = addAdStructure(resp, 0, BLE_AD_FLAGS, &flags, 1);
+  respLen = addAdStructure(resp, respLen, BLE_AD_COMPLETE_UUID16, buf, 2);
+  respLen =
+      addAdStructure(resp, respLen, BLE_AD_SERVICE_DATA16, buf, len + 2);
 
-  for (int i = 0; i < 17; i = i + 8) {
-    chipId |= ((ESP.getEfuseMac() >> (40 - i)) & 0xff) << i;
-  }
+  advertise(adv, advLen, resp, respLen);
+}
 
-  std::string mf = "";
-
-  /*
-    typedef struct __attribute__((packed)) {
-        char prefix[4];        // RAPT
-        uint8_t version;       // always 0x01
-        uint8_t mac[6];
-        uint16_t temperature;  // x / 128 - 273.15
-        float gravity;         // / 1000
-        int16_t x;             // x / 16
-        int16_t y;             // x / 16
-        int16_t z;             // x / 16
-        int16_t battery;       // x / 256
-    } RAPTPillMetricsV1;
-  */
-
-  mf += "RAPT";
-  mf += static_cast<char>(0x01);  // Rapt v1
-
-  mf += static_cast<char>(0x00);  // Mac adress, using that for ChipID
-  mf += static_cast<char>(0x00);  //
-  mf += static_cast<char>(((chipId & 0xFF000000) >> 24));
-  mf += static_cast<char>(((chipId & 0xFF0000) >> 16));
-  mf += static_cast<char>(((chipId & 0xFF00) >> 8));
-  mf += static_cast<char>((chipId & 0xFF));
-
-  mf += static_cast<char>((t >> 8));  // Temperature
-  mf += static_cast<char>((t & 0xFF));
-
-  floatUnion.f = gravSG * 1000;  // Gravity
-  mf += static_cast<char>(floatUnion.b[3]);
-  mf += static_cast<char>(floatUnion.b[2]);
-  mf += static_cast<char>(floatUnion.b[1]);
-  mf += static_cast<char>(floatUnion.b[0]);
-
-  mf += static_cast<char>((a >> 8));  // X, Angle
-  mf += static_cast<char>((a & 0xFF));
-  mf += static_cast<char>(0x00);  // Y
-  mf += static_cast<char>(0x00);
-  mf += static_cast<char>(0x00);  // Z
-  mf += static_cast<char>(0x00);
-
-  mf += static_cast<char>((b >> 8));  // Battery
-  mf += static_cast<char>((b & 0xFF));
+void BleSender::sendTiltData(String& color, float tempF, float gravSG,
+                             bool tiltPro) {
+  Log.info(F("BLE : Starting tilt data transmission" CR));
 
-#if LOG_LEVEL == 6
-  dumpPayload(mf.c_str(), mf.length());
-#endif
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  size_t len = encodeTilt(buf, getTiltColorIndex(color.c_str()), tempF,
+                          gravSG, tiltPro);
 
-  BLEAdvertisementData advData = BLEAdvertisementData();
-  advData.setFlags(0x04);
-  advData.setManufacturerData(mf);
-  _advertising->setAdvertisementData(advData);
+  sendManufacturerData(buf, len);
+}
 
-  _advertising->setConnectableMode(BLE_GAP_CONN_MODE_NON);
-  _advertising->start();
-  delay(_beaconTime);
-  _advertising->stop();
+void BleSender::sendRaptV1Data(float batteryPercentage, float tempC,
+                               float gravSG, float angle) {
+  Log.info(F("Starting rapt v1 beacon data transmission" CR));
+
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  size_t len =
+      encodeRaptV1(buf, _chipId, batteryPercentage, tempC, gravSG, angle);
+
+  sendManufacturerData(buf, len);
 }
 
 void BleSender::sendRaptV2Data(float batteryPercentage, float tempC,
                                float gravSG, float angle, float velocity) {
   Log.info(F("Starting rapt v2 beacon data transmission" CR));
 
-  _advertising->stop();
-
-  union {  // For mapping the raw float to bytes
-    float f;
-    uint8_t b[4];
-  } floatUnion;
-
-  uint16_t t = isnan(tempC) ? 0xffff : (tempC + 273.15) * 128.0;
-  uint16_t b = isnan(batteryPercentage) ? 0xffff : batteryPercentage * 256;
-  uint16_t a = isnan(angle) ? 0xffff : angle * 16;
-
-  std::string mf = "";
-
-  /*
-        https://gitlab.com/rapt.io/public/-/wikis/Pill-Hydrometer-Bluetooth-Transmissions
-
-        typedef struct __attribute__((packed)) {
-            char prefix[4];        // RAPT
-            uint8_t version;       // always 0x02
-            uint8_t padding;       // always 0x00
-            uint8_t gravity_velocity_valid; // boolean
-            float gravity_velocity;
-            uint16_t temperature;  // x / 128 - 273.15
-            float gravity;         // / 1000
-            int16_t x;             // x / 16
-            int16_t y;             // x / 16
-            int16_t z;             // x / 16
-            int16_t battery;       // x / 256
-        } RAPTPillMetricsV2;
-  */
-
-  mf += "RAPT";
-  mf += static_cast<char>(0x02);  // Rapt v2
-  mf += static_cast<char>(0x00);  // Padding
-
-  mf += static_cast<char>(isnan(velocity) ? 0x00 : 0x01);  // Velocity valid
-
-  floatUnion.f = velocity;  // Velocity
-  mf += static_cast<char>(floatUnion.b[3]);
-  mf += static_cast<char>(floatUnion.b[2]);
-  mf += static_cast<char>(floatUnion.b[1]);
-  mf += static_cast<char>(floatUnion.b[0]);
-
-  mf += static_cast<char>((t >> 8));  // Temperature
-  mf += static_cast<char>((t & 0xFF));
-
-  floatUnion.f = gravSG * 1000;  // Gravity
-  mf += static_cast<char>(floatUnion.b[3]);
-  mf += static_cast<char>(floatUnion.b[2]);
-  mf += static_cast<char>(floatUnion.b[1]);
-  mf += static_cast<char>(floatUnion.b[0]);
-
-  mf += static_cast<char>((a >> 8));  // X, Angle
-  mf += static_cast<char>((a & 0xFF));
-  mf += static_cast<char>(0x00);  // Y
-  mf += static_cast<char>(0x00);
-  mf += static_cast<char>(0x00);  // Z
-  mf += static_cast<char>(0x00);
-
-  mf += static_cast<char>((b >> 8));  // Battery (batt_v)
-  mf += static_cast<char>((b & 0xFF));
-
-#if LOG_LEVEL == 6
-  dumpPayload(mf.c_str(), mf.length());
-#endif
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  size_t len =
+      encodeRaptV2(buf, batteryPercentage, tempC, gravSG, angle, velocity);
 
-  BLEAdvertisementData advData = BLEAdvertisementData();
-  advData.setFlags(0x04);
-  advData.setManufacturerData(mf);
-  _advertising->setAdvertisementData(advData);
-
-  _advertising->setConnectableMode(BLE_GAP_CONN_MODE_NON);
-  _advertising->start();
-  delay(_beaconTime);
-  _advertising->stop();
+  sendManufacturerData(buf, len);
 }
 
 void BleSender::sendCustomBeaconData(float battery, float tempC, float gravSG,
                                      float angle) {
   Log.info(F("Starting custom beacon data transmission" CR));
-  _advertising->stop();
 
-  uint16_t g = isnan(gravSG) ? 0xffff : gravSG * 10000;
-  uint16_t t = isnan(tempC) ? 0xffff : tempC * 1000;
-  uint16_t b = isnan(battery) ? 0xffff : battery * 1000;
-  uint16_t a = isnan(angle) ? 0xffff : angle * 100;
-  uint32_t chipId = 0;
-
-  for (int i = 0; i < 17; i = i + 8) {
-    chipId |= ((ESP.getEfuseMac() >> (40 - i)) & 0xff) << i;
-  }
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  size_t len =
+      encodeGravitymonBeacon(buf, _chipId, battery, tempC, gravSG, angle);
 
-  std::string mf = "";
-
-  mf += static_cast<char>(0x4C);  // Manuf ID (Apple)
-  mf += static_cast<char>(0x00);
-  mf += static_cast<char>(0x03);  // SubType (standards is 0x02)
-  mf += static_cast<char>(0x15);  // SubType Length
-  mf += "GRAVMON.";
-  mf += static_cast<char>(((chipId & 0xFF000000) >> 24));  // Chipid
-  mf += static_cast<char>(((chipId & 0xFF0000) >> 16));
-  mf += static_cast<char>(((chipId & 0xFF00) >> 8));
-  mf += static_cast<char>((chipId & 0xFF));
-  mf += static_cast<char>((a >> 8));  // Angle (angle*100)
-  mf += static_cast<char>((a & 0xFF));
-  mf += static_cast<char>((b >> 8));  // Battery (batt_v*1000)
-  mf += static_cast<char>((b & 0xFF));
-  mf += static_cast<char>((g >> 8));  // Gravity (gravity_sg*10000)
-  mf += static_cast<char>((g & 0xFF));
-  mf += static_cast<char>((t >> 8));  // Temperature (temp_c*1000)
-  mf += static_cast<char>((t & 0xFF));
-  mf += static_cast<char>(0x00);  // Signal
+  sendManufacturerData(buf, len);
+}
 
+// The frame is copied into the advertisement so buf can be on the stack
+void BleSender::sendManufacturerData(const uint8_t* buf, size_t len) {
 #if LOG_LEVEL == 6
-  dumpPayload(mf.c_str(), mf.length());
+  dumpPayload(buf, len);
 #endif
 
+  uint8_t adv[BLE_ADV_DATA_SIZE];
+  const uint8_t flags = 0x04;
+
+  size_t advLen = addAdStructure(adv, 0, BLE_AD_FLAGS, &flags, 1);
+  advLen = addAdStructure(adv, advLen, BLE_AD_MANUFACTURER, buf, len);
+
+  advertise(adv, advLen);
+}
+
+// The beacons are not connectable, with a scan response they are scannable
+void BleSender::setAdvertisement(const uint8_t* adv, size_t advLen,
+                                 const uint8_t* resp, size_t respLen) {
+  if (_raw) {
+    if (_hci.setParams(_interval, respLen ? BLE_HCI_ADV_SCAN_IND
+                                          : BLE_HCI_ADV_NONCONN_IND) &&
+        _hci.setAdvertisingData(adv, advLen) &&
+        _hci.setScanResponseData(resp, respLen))
+      return;
+
+    useHost();
+  }
+
   BLEAdvertisementData advData = BLEAdvertisementData();
-  advData.setFlags(0x04);
-  advData.setManufacturerData(mf);
+  advData.addData(adv, advLen);
   _advertising->setAdvertisementData(advData);
 
+  BLEAdvertisementData respData = BLEAdvertisementData();
+  if (respLen) respData.addData(resp, respLen);
+  _advertising->setScanResponseData(respData);
+
   _advertising->setConnectableMode(BLE_GAP_CONN_MODE_NON);
-  _advertising->start();
-  delay(_beaconTime);
-  _advertising->stop();
 }
 
-void BleSender::dumpPayload(const char* p, int len) {
-  for (int i = 0; i < len; i++) {
-    EspSerial.printf("%X%X ", (*(p + i) & 0xf0) >> 4, (*(p + i) & 0x0f));
+void BleSender::dumpPayload(const uint8_t* p, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    EspSerial.printf("%X%X ", (p[i] & 0xf0) >> 4, (p[i] & 0x0f));
   }
   EspSerial.println();
 }
@@ -26,25 +26,70 @@
 
 #if defined(ENABLE_BLE) && defined(GRAVITYMON)
 
-#include <NimBLEBeacon.h>
 #include <NimBLEDevice.h>
 
+#include <blehci.hpp>
+#include <blehistory.hpp>
+
+constexpr auto BLE_ACK_SERVICE_UUID = "8b6f0d10-5c1e-4f57-9a6e-2f3c4d5e6f70";
+constexpr auto BLE_ACK_CHARACTERISTIC_UUID =
+    "8b6f0d11-5c1e-4f57-9a6e-2f3c4d5e6f70";
+constexpr auto BLE_HISTORY_CURSOR_UUID = "8b6f0d12-5c1e-4f57-9a6e-2f3c4d5e6f70";
+constexpr auto BLE_HISTORY_RECORDS_UUID =
+    "8b6f0d13-5c1e-4f57-9a6e-2f3c4d5e6f70";
+constexpr auto BLE_LOW_POWER_MHZ = 80;  // Lowest clock the controller allows
+
 class BleSender {
  private:
   BLEServer* _server = nullptr;
   BLEAdvertising* _advertising = nullptr;
   BLEService* _service = nullptr;
   BLECharacteristic* _characteristic = nullptr;
-  BLEUUID _uuid;
+  uint32_t _chipId = 0;
   bool _initFlag = false;
-  int _beaconTime = 1000;
+  bool _raw = false;  // Controller only, see BleHci
+  BleHci _hci;
+  int _interval = 100;  // ms between advertising events
+  int _window = 1000;   // ms, max time to advertise each measurement
+  int _slot = 1000;     // ms, part of the window for each format
+  bool _ack = false;
+  BleHistory* _history = nullptr;
+  SemaphoreHandle_t _ackSemaphore = nullptr;
+  uint32_t _cpuFreq = 0;
+  uint32_t _radioTime = 0;  // ms
 
-  void dumpPayload(const char* payload, int len);
+  void advertise(const uint8_t* adv, size_t advLen,
+                 const uint8_t* resp = nullptr, size_t respLen = 0);
+  void enterLowPower();
+  void exitLowPower();
+  void initHost();
+  void useHost();
+  void setAdvertisement(const uint8_t* adv, size_t advLen,
+                        const uint8_t* resp = nullptr, size_t respLen = 0);
+  void sendManufacturerData(const uint8_t* buf, size_t len);
+  void dumpPayload(const uint8_t* payload, size_t len);
 
  public:
   BleSender() {}
 
-  void init();
+  // With ack the advertising is connectable and stops as soon as a gateway
+  // writes to the ack characteristic, otherwise it runs for the window. With
+  // history the advertising is also connectable and a gateway can read the
+  // stored measurements before it writes the ack. Without these only the
+  // controller is started, which is faster than bringing up the host.
+  void init(int interval, int window, bool ack,
+            BleHistory* history = nullptr);
+
+  // Splits the window between the formats that are sent for a measurement,
+  // each format is then advertised for its slot so the radio is on for about
+  // the same time as with one format. A slot is at least two advertising
+  // intervals so each format is sent more than once.
+  void setFormatCount(int count) {
+    _slot = max(_window / (count > 0 ? count : 1), 2 * _interval);
+  }
+
+  // Time spent advertising since init
+  uint32_t getRadioTime() const { return _radioTime; }
 
   // Beacons
   void sendTiltData(String& color, float tempF, float gravSG, bool tiltPro);
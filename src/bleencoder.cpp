@@ -0,0 +1,166 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <bleencoder.hpp>
+
+// Tilt UUID variants, based on tilt-sim
+//
+// https://github.com/spouliot/tilt-sim
+//
+// Tilt data format is described here. Only SG and Temp is transmitted over BLE.
+// https://kvurd.com/blog/tilt-hydrometer-ibeacon-data-format/
+//
+// A495BBx0-C5B1-4B44-B512-1370F02D74DE where x is the color
+static const char* const tiltColors[BLE_TILT_COLORS] = {
+    "red", "green", "black", "purple", "orange", "blue", "yellow", "pink"};
+static const uint8_t tiltUuid[16] = {0xa4, 0x95, 0xbb, 0x00, 0xc5, 0xb1,
+                                     0x4b, 0x44, 0xb5, 0x12, 0x13, 0x70,
+                                     0xf0, 0x2d, 0x74, 0xde};
+
+static constexpr int8_t iBeaconPower = -59;  // dBm at 1 m, as sent by tilt
+
+int getTiltColorIndex(const char* color) {
+  for (int i = 0; i < BLE_TILT_COLORS; i++)
+    if (!strcmp(color, tiltColors[i])) return i;
+
+  return BLE_TILT_COLORS - 1;
+}
+
+uint32_t getBleChipId(uint64_t mac) {
+  uint32_t chipId = 0;
+
+  for (int i = 0; i < 17; i = i + 8) {
+    chipId |= ((mac >> (40 - i)) & 0xff) << i;
+  }
+
+  return chipId;
+}
+
+size_t addAdStructure(uint8_t* buf, size_t len, BleAdType type,
+                      const uint8_t* data, size_t size) {
+  if (len + size + 2 > BLE_ADV_DATA_SIZE) return len;
+
+  buf[len] = size + 1;  // Length includes the type
+  buf[len + 1] = type;
+  memcpy(buf + len + 2, data, size);
+  return len + size + 2;
+}
+
+// Scaled and truncated like the receivers expect, NAN is sent as 0xffff
+static uint16_t scale(float v, float factor) {
+  return isnan(v) ? 0xffff : static_cast<uint16_t>(v * factor);
+}
+
+size_t encodeTilt(uint8_t* buf, int color, float tempF, float gravSG,
+                  bool tiltPro) {
+  BleIBeaconFrame* f = reinterpret_cast<BleIBeaconFrame*>(buf);
+
+  f->company[0] = 0x4c;
+  f->company[1] = 0x00;
+  f->type = 0x02;
+  f->length = 0x15;
+  memcpy(f->uuid, tiltUuid, sizeof(tiltUuid));
+  f->uuid[3] = (color + 1) << 4;
+  f->major.set(scale(tempF, tiltPro ? 10 : 1));
+  f->minor.set(scale(gravSG, tiltPro ? 10000 : 1000));
+  f->power = iBeaconPower;
+  return sizeof(BleIBeaconFrame);
+}
+
+size_t encodeGravitymonBeacon(uint8_t* buf, uint32_t chipId, float battery,
+                              float tempC, float gravSG, float angle) {
+  BleGravitymonFrame* f = reinterpret_cast<BleGravitymonFrame*>(buf);
+
+  f->company[0] = 0x4c;  // Apple
+  f->company[1] = 0x00;
+  f->type = 0x03;  // Standard iBeacon is 0x02
+  f->length = 0x15;
+  memcpy(f->name, "GRAVMON.", sizeof(f->name));
+  f->chipId.set(chipId);
+  f->angle.set(scale(angle, 100));
+  f->battery.set(scale(battery, 1000));
+  f->gravity.set(scale(gravSG, 10000));
+  f->temp.set(scale(tempC, 1000));
+  f->signal = 0x00;
+  return sizeof(BleGravitymonFrame);
+}
+
+size_t encodeEddystone(uint8_t* buf, uint32_t chipId, float battery,
+                       float tempC, float gravSG, float angle) {
+  BleEddystoneFrame* f = reinterpret_cast<BleEddystoneFrame*>(buf);
+
+  f->type = 0x20;
+  f->version = 0x00;
+  f->battery.set(scale(battery, 1000));
+  f->temp.set(scale(tempC, 1000));
+  f->gravity.set(scale(gravSG, 10000));
+  f->angle.set(scale(angle, 100));
+  f->chipId.set(chipId);
+  return sizeof(BleEddystoneFrame);
+}
+
+static uint16_t getRaptTemp(float tempC) {
+  return isnan(tempC) ? 0xffff
+                      : static_cast<uint16_t>((tempC + 273.15) * 128.0);
+}
+
+size_t encodeRaptV1(uint8_t* buf, uint32_t chipId, float batteryPercentage,
+                    float tempC, float gravSG, float angle) {
+  BleRaptV1Frame* f = reinterpret_cast<BleRaptV1Frame*>(buf);
+
+  memcpy(f->prefix, "RAPT", sizeof(f->prefix));
+  f->version = 0x01;
+  f->mac[0] = 0x00;  // Mac address, the chip id is used instead
+  f->mac[1] = 0x00;
+  f->mac[2] = chipId >> 24;
+  f->mac[3] = (chipId >> 16) & 0xff;
+  f->mac[4] = (chipId >> 8) & 0xff;
+  f->mac[5] = chipId & 0xff;
+  f->temp.set(getRaptTemp(tempC));
+  f->gravity.set(gravSG * 1000);
+  f->x.set(scale(angle, 16));
+  f->y.set(0);
+  f->z.set(0);
+  f->battery.set(scale(batteryPercentage, 256));
+  return sizeof(BleRaptV1Frame);
+}
+
+size_t encodeRaptV2(uint8_t* buf, float batteryPercentage, float tempC,
+                    float gravSG, float angle, float velocity) {
+  BleRaptV2Frame* f = reinterpret_cast<BleRaptV2Frame*>(buf);
+
+  memcpy(f->prefix, "RAPT", sizeof(f->prefix));
+  f->version = 0x02;
+  f->padding = 0x00;
+  f->velocityValid = isnan(velocity) ? 0x00 : 0x01;
+  f->velocity.set(velocity);
+  f->temp.set(getRaptTemp(tempC));
+  f->gravity.set(gravSG * 1000);
+  f->x.set(scale(angle, 16));
+  f->y.set(0);
+  f->z.set(0);
+  f->battery.set(scale(batteryPercentage, 256));
+  return sizeof(BleRaptV2Frame);
+}
+
+// EOF
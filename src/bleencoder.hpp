@@ -0,0 +1,180 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_BLEENCODER_HPP_
+#define SRC_BLEENCODER_HPP_
+
+#include <Arduino.h>
+
+constexpr auto BLE_PAYLOAD_SIZE = 25;  // Largest frame, iBeacon and RAPT
+constexpr auto BLE_ADV_DATA_SIZE = 31;  // Legacy advertising or scan response
+constexpr auto BLE_EDDYSTONE_SIZE = 14;
+constexpr auto BLE_TILT_COLORS = 8;
+
+// Big endian fields, the frames are sent as they are laid out in memory
+struct __attribute__((packed)) BleUint16 {
+  uint8_t b[2];
+
+  void set(uint16_t v) {
+    b[0] = v >> 8;
+    b[1] = v & 0xff;
+  }
+  uint16_t get() const { return b[0] << 8 | b[1]; }
+};
+
+struct __attribute__((packed)) BleUint32 {
+  uint8_t b[4];
+
+  void set(uint32_t v) {
+    b[0] = v >> 24;
+    b[1] = (v >> 16) & 0xff;
+    b[2] = (v >> 8) & 0xff;
+    b[3] = v & 0xff;
+  }
+  uint32_t get() const {
+    return static_cast<uint32_t>(b[0]) << 24 | b[1] << 16 | b[2] << 8 | b[3];
+  }
+};
+
+struct __attribute__((packed)) BleFloat {
+  BleUint32 u;
+
+  void set(float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    u.set(v);
+  }
+  float get() const {
+    uint32_t v = u.get();
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+  }
+};
+
+// Apple iBeacon manufacturer data, used by Tilt and Tilt Pro
+struct __attribute__((packed)) BleIBeaconFrame {
+  uint8_t company[2];  // 0x4c 0x00
+  uint8_t type;        // 0x02
+  uint8_t length;      // 0x15
+  uint8_t uuid[16];
+  BleUint16 major;  // F, F * 10 for Tilt Pro
+  BleUint16 minor;  // SG * 1000, SG * 10000 for Tilt Pro
+  int8_t power;     // dBm at 1 m
+};
+
+// GravityMon iBeacon, same header as iBeacon with its own type
+struct __attribute__((packed)) BleGravitymonFrame {
+  uint8_t company[2];  // 0x4c 0x00
+  uint8_t type;        // 0x03
+  uint8_t length;      // 0x15
+  char name[8];        // GRAVMON.
+  BleUint32 chipId;
+  BleUint16 angle;    // angle * 100
+  BleUint16 battery;  // V * 1000
+  BleUint16 gravity;  // SG * 10000
+  BleUint16 temp;     // C * 1000
+  uint8_t signal;
+};
+
+// Eddystone TLM service data with the GravityMon values, also used for the
+// binary http payload
+struct __attribute__((packed)) BleEddystoneFrame {
+  uint8_t type;       // 0x20, unencrypted TLM
+  uint8_t version;    // 0x00
+  BleUint16 battery;  // V * 1000
+  BleUint16 temp;     // C * 1000
+  BleUint16 gravity;  // SG * 10000
+  BleUint16 angle;    // angle * 100
+  BleUint32 chipId;
+};
+
+// RAPT pill layouts, see Pill-Hydrometer-Bluetooth-Transmissions in the wiki
+// at gitlab.com/rapt.io/public
+struct __attribute__((packed)) BleRaptV1Frame {
+  char prefix[4];  // RAPT
+  uint8_t version;  // 0x01
+  uint8_t mac[6];   // 0x00 0x00 and the chip id
+  BleUint16 temp;   // K * 128
+  BleFloat gravity;  // SG * 1000
+  BleUint16 x;       // angle * 16
+  BleUint16 y;
+  BleUint16 z;
+  BleUint16 battery;  // % * 256
+};
+
+struct __attribute__((packed)) BleRaptV2Frame {
+  char prefix[4];  // RAPT
+  uint8_t version;  // 0x02
+  uint8_t padding;
+  uint8_t velocityValid;
+  BleFloat velocity;  // SG points per day
+  BleUint16 temp;     // K * 128
+  BleFloat gravity;   // SG * 1000
+  BleUint16 x;        // angle * 16
+  BleUint16 y;
+  BleUint16 z;
+  BleUint16 battery;  // % * 256
+};
+
+static_assert(sizeof(BleIBeaconFrame) == 25, "iBeacon frame size");
+static_assert(sizeof(BleGravitymonFrame) == 25, "GravityMon frame size");
+static_assert(sizeof(BleEddystoneFrame) == BLE_EDDYSTONE_SIZE,
+              "Eddystone frame size");
+static_assert(sizeof(BleRaptV1Frame) == 25, "RAPT v1 frame size");
+static_assert(sizeof(BleRaptV2Frame) == 25, "RAPT v2 frame size");
+
+// Advertising data types used by the beacons
+enum BleAdType {
+  BLE_AD_FLAGS = 0x01,
+  BLE_AD_COMPLETE_UUID16 = 0x03,
+  BLE_AD_COMPLETE_NAME = 0x09,
+  BLE_AD_SERVICE_DATA16 = 0x16,
+  BLE_AD_MANUFACTURER = 0xff,
+};
+
+// Appends an AD structure to the advertising data in buf, which must hold
+// BLE_ADV_DATA_SIZE bytes. Returns the new length, or len if it does not fit.
+size_t addAdStructure(uint8_t* buf, size_t len, BleAdType type,
+                      const uint8_t* data, size_t size);
+
+// Color name to index in the tilt uuid table, unknown colors are pink
+int getTiltColorIndex(const char* color);
+uint32_t getBleChipId(uint64_t mac);
+
+// The encoders write the frame into buf, which must hold BLE_PAYLOAD_SIZE
+// bytes, and return the length. Values that are NAN are sent as 0xffff.
+size_t encodeTilt(uint8_t* buf, int color, float tempF, float gravSG,
+                  bool tiltPro);
+size_t encodeGravitymonBeacon(uint8_t* buf, uint32_t chipId, float battery,
+                              float tempC, float gravSG, float angle);
+size_t encodeEddystone(uint8_t* buf, uint32_t chipId, float battery,
+                       float tempC, float gravSG, float angle);
+size_t encodeRaptV1(uint8_t* buf, uint32_t chipId, float batteryPercentage,
+                    float tempC, float gravSG, float angle);
+size_t encodeRaptV2(uint8_t* buf, float batteryPercentage, float tempC,
+                    float gravSG, float angle, float velocity);
+
+#endif  // SRC_BLEENCODER_HPP_
+
+// EOF
@@ -0,0 +1,174 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#if defined(ENABLE_BLE) && defined(GRAVITYMON)
+
+#include <esp_bt.h>
+
+#include <bleencoder.hpp>
+#include <blehci.hpp>
+#include <log.hpp>
+
+// HCI packets and LE controller commands, Bluetooth Core Vol 4 Part E
+constexpr uint8_t HCI_COMMAND_PACKET = 0x01;
+constexpr uint8_t HCI_EVENT_PACKET = 0x04;
+constexpr uint8_t HCI_COMMAND_COMPLETE = 0x0e;
+constexpr uint8_t HCI_COMMAND_STATUS = 0x0f;
+constexpr uint16_t HCI_RESET = 0x0c03;
+constexpr uint16_t HCI_LE_SET_ADV_PARAMS = 0x2006;
+constexpr uint16_t HCI_LE_SET_ADV_DATA = 0x2008;
+constexpr uint16_t HCI_LE_SET_SCAN_RESPONSE_DATA = 0x2009;
+constexpr uint16_t HCI_LE_SET_ADV_ENABLE = 0x200a;
+
+static SemaphoreHandle_t hciSemaphore = nullptr;
+static uint8_t hciStatus = 0;
+
+static void hciSendAvailable() {}
+
+// Called from the controller task for each event
+static int hciReceive(uint8_t* data, uint16_t len) {
+  if (len < 2 || data[0] != HCI_EVENT_PACKET) return 0;
+
+  if (data[1] == HCI_COMMAND_COMPLETE && len >= 7) {
+    hciStatus = data[6];
+    xSemaphoreGive(hciSemaphore);
+  } else if (data[1] == HCI_COMMAND_STATUS && len >= 4) {
+    hciStatus = data[3];
+    xSemaphoreGive(hciSemaphore);
+  }
+
+  return 0;
+}
+
+static esp_vhci_host_callback_t hciCallback = {hciSendAvailable, hciReceive};
+
+bool BleHci::begin() {
+  if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_IDLE) {
+    esp_bt_controller_config_t cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+
+    if (esp_bt_controller_init(&cfg) != ESP_OK) {
+      Log.error(F("BLE : Failed to init the controller." CR));
+      return false;
+    }
+  }
+
+  if (esp_bt_controller_get_status() != ESP_BT_CONTROLLER_STATUS_ENABLED &&
+      esp_bt_controller_enable(ESP_BT_MODE_BLE) != ESP_OK) {
+    Log.error(F("BLE : Failed to enable the controller." CR));
+    end();
+    return false;
+  }
+
+  if (!hciSemaphore) hciSemaphore = xSemaphoreCreateBinary();
+
+  esp_vhci_host_register_callback(&hciCallback);
+
+  if (!command(HCI_RESET, nullptr, 0)) {
+    Log.error(F("BLE : Controller did not respond to reset." CR));
+    end();
+    return false;
+  }
+
+  return true;
+}
+
+void BleHci::end() {
+  if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_ENABLED)
+    esp_bt_controller_disable();
+  if (esp_bt_controller_get_status() == ESP_BT_CONTROLLER_STATUS_INITED)
+    esp_bt_controller_deinit();
+}
+
+bool BleHci::command(uint16_t opcode, const uint8_t* params, uint8_t len) {
+  uint8_t buf[4 + BLE_ADV_DATA_SIZE + 1];
+
+  buf[0] = HCI_COMMAND_PACKET;
+  buf[1] = opcode & 0xff;
+  buf[2] = opcode >> 8;
+  buf[3] = len;
+  if (len) memcpy(buf + 4, params, len);
+
+  uint32_t start = millis();
+  while (!esp_vhci_host_check_send_available()) {
+    if (millis() - start > BLE_HCI_TIMEOUT) return false;
+    delay(1);
+  }
+
+  xSemaphoreTake(hciSemaphore, 0);
+  esp_vhci_host_send_packet(buf, len + 4);
+
+  if (xSemaphoreTake(hciSemaphore, pdMS_TO_TICKS(BLE_HCI_TIMEOUT)) !=
+      pdTRUE) {
+    Log.error(F("BLE : No response to command %x." CR), opcode);
+    return false;
+  }
+
+  if (hciStatus) {
+    Log.error(F("BLE : Command %x failed with %d." CR), opcode, hciStatus);
+    return false;
+  }
+
+  return true;
+}
+
+bool BleHci::setParams(int interval, BleHciAdvType type) {
+  uint16_t units = interval * 8 / 5;  // 0.625 ms
+  uint8_t params[15] = {0};
+
+  params[0] = units & 0xff;  // Min interval
+  params[1] = units >> 8;
+  params[2] = units & 0xff;  // Max interval
+  params[3] = units >> 8;
+  params[4] = type;
+  params[5] = 0x00;   // Public address
+  params[13] = 0x07;  // All three channels
+  params[14] = 0x00;  // No filter
+  return command(HCI_LE_SET_ADV_PARAMS, params, sizeof(params));
+}
+
+bool BleHci::setData(uint16_t opcode, const uint8_t* data, size_t len) {
+  uint8_t params[BLE_ADV_DATA_SIZE + 1] = {0};
+
+  if (len > BLE_ADV_DATA_SIZE) return false;
+
+  params[0] = len;
+  if (len) memcpy(params + 1, data, len);
+  return command(opcode, params, sizeof(params));
+}
+
+bool BleHci::setAdvertisingData(const uint8_t* data, size_t len) {
+  return setData(HCI_LE_SET_ADV_DATA, data, len);
+}
+
+bool BleHci::setScanResponseData(const uint8_t* data, size_t len) {
+  return setData(HCI_LE_SET_SCAN_RESPONSE_DATA, data, len);
+}
+
+bool BleHci::enable(bool on) {
+  uint8_t params[1] = {static_cast<uint8_t>(on ? 0x01 : 0x00)};
+  return command(HCI_LE_SET_ADV_ENABLE, params, sizeof(params));
+}
+
+#endif  // ENABLE_BLE && GRAVITYMON
+
+// EOF
@@ -0,0 +1,62 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_BLEHCI_HPP_
+#define SRC_BLEHCI_HPP_
+
+#if defined(ENABLE_BLE) && defined(GRAVITYMON)
+
+#include <Arduino.h>
+
+constexpr auto BLE_HCI_TIMEOUT = 100;  // ms, per command
+
+enum BleHciAdvType {
+  BLE_HCI_ADV_SCAN_IND = 0x02,  // Scannable, not connectable
+  BLE_HCI_ADV_NONCONN_IND = 0x03,
+};
+
+// Advertising with the controller only, the commands are sent over VHCI so
+// the NimBLE host is never started. Only used for broadcasting, connections
+// need the host.
+class BleHci {
+ private:
+  bool command(uint16_t opcode, const uint8_t* params, uint8_t len);
+  bool setData(uint16_t opcode, const uint8_t* data, size_t len);
+
+ public:
+  BleHci() {}
+
+  bool begin();
+  void end();
+
+  bool setParams(int interval, BleHciAdvType type);  // ms
+  bool setAdvertisingData(const uint8_t* data, size_t len);
+  bool setScanResponseData(const uint8_t* data, size_t len);
+  bool enable(bool on);
+};
+
+#endif  // ENABLE_BLE && GRAVITYMON
+
+#endif  // SRC_BLEHCI_HPP_
+
+// EOF
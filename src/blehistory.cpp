@@ -0,0 +1,93 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <blehistory.hpp>
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM) && defined(ENABLE_BLE)
+RTC_DATA_ATTR BleHistoryData myBleHistoryData = {0};
+#else
+BleHistoryData myBleHistoryData = {0};
+#endif
+
+BleHistory myBleHistory(&myBleHistoryData);
+
+void BleHistory::add(const MeasurementRecord& r) {
+  if (_data->Count < BLE_HISTORY_SIZE) {
+    _data->Records[(_data->Head + _data->Count) % BLE_HISTORY_SIZE] = r;
+    _data->Count++;
+  } else {  // Full, replace the oldest
+    _data->Records[_data->Head] = r;
+    _data->Head = (_data->Head + 1) % BLE_HISTORY_SIZE;
+  }
+
+  _data->Sequence++;
+}
+
+void BleHistory::setCursor(uint32_t sequence) {
+  uint32_t first = getFirstSequence();
+
+  // A sequence before the oldest record drops nothing, one after the newest
+  // drops all. The distance is signed so the sequence can wrap.
+  int32_t drop = static_cast<int32_t>(sequence - first);
+  if (drop < 0) drop = 0;
+  if (drop > _data->Count) drop = _data->Count;
+
+  _data->Head = (_data->Head + drop) % BLE_HISTORY_SIZE;
+  _data->Count -= drop;
+  _cursor = first + drop;
+}
+
+size_t BleHistory::readPage(uint8_t* buf, uint32_t clock) {
+  BleHistoryHeader* h = reinterpret_cast<BleHistoryHeader*>(buf);
+  BleHistoryRecord* out =
+      reinterpret_cast<BleHistoryRecord*>(buf + sizeof(BleHistoryHeader));
+
+  uint32_t first = getFirstSequence();
+  int32_t skip = static_cast<int32_t>(_cursor - first);
+  if (skip < 0) skip = 0;  // Cursor is outside the ring
+  if (skip > _data->Count) skip = _data->Count;
+
+  int count = _data->Count - skip;
+  if (count > BLE_HISTORY_PAGE) count = BLE_HISTORY_PAGE;
+
+  for (int i = 0; i < count; i++) {
+    const MeasurementRecord& r =
+        _data->Records[(_data->Head + skip + i) % BLE_HISTORY_SIZE];
+
+    out[i].time.set(r.time);
+    out[i].angle.set(r.angle);
+    out[i].tempC.set(r.tempC);
+    out[i].gravity.set(r.gravity);
+    out[i].corrGravity.set(r.corrGravity);
+    out[i].velocity.set(r.velocity);
+    out[i].battery.set(r.battery);
+  }
+
+  h->sequence.set(first + skip);
+  h->clock.set(clock);
+  h->count = count;
+  _cursor = first + skip + count;
+  return sizeof(BleHistoryHeader) + count * sizeof(BleHistoryRecord);
+}
+
+// EOF
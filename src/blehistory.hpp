@@ -0,0 +1,118 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_BLEHISTORY_HPP_
+#define SRC_BLEHISTORY_HPP_
+
+#include <Arduino.h>
+
+#include <bleencoder.hpp>
+#include <measurementqueue.hpp>
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM) && defined(ENABLE_BLE)
+constexpr auto BLE_HISTORY_SIZE = 32;  // Records kept in RTC memory
+#else
+constexpr auto BLE_HISTORY_SIZE = 8;  // Only kept while the device is awake
+#endif
+
+constexpr auto BLE_HISTORY_PAGE = 30;  // Records per read, max 512 bytes
+
+#define BLE_HISTORY_DATA_AVAILABLE \
+  static_cast<uint8_t>(111)  // Unique number to flag resume data is available
+
+// Record as sent to the gateway, big endian. A value that was not available
+// is sent as 0x8000 for the signed fields and 0xffff for the unsigned ones,
+// same as in the measurement queue.
+struct __attribute__((packed)) BleHistoryRecord {
+  BleUint32 time;         // s, device clock
+  BleUint16 angle;        // degrees * 100, signed
+  BleUint16 tempC;        // C * 100, signed
+  BleUint16 gravity;      // SG * 10000
+  BleUint16 corrGravity;  // SG * 10000
+  BleUint16 velocity;     // SG points per day * 100, signed
+  BleUint16 battery;      // mV
+};
+
+// Header of each page, followed by count records
+struct __attribute__((packed)) BleHistoryHeader {
+  BleUint32 sequence;  // Sequence of the first record in the page
+  BleUint32 clock;     // s, device clock when read, for the record age
+  uint8_t count;
+};
+
+static_assert(sizeof(BleHistoryRecord) == 16, "History record size");
+static_assert(sizeof(BleHistoryHeader) +
+                      BLE_HISTORY_PAGE * sizeof(BleHistoryRecord) <=
+                  512,
+              "History page does not fit in a characteristic");
+
+constexpr auto BLE_HISTORY_PAGE_SIZE =
+    sizeof(BleHistoryHeader) + BLE_HISTORY_PAGE * sizeof(BleHistoryRecord);
+
+struct BleHistoryData {
+  uint8_t IsDataAvailable;
+  uint8_t Head;   // Index of the oldest record
+  uint8_t Count;      // Records in the ring
+  uint32_t Sequence;  // Sequence of the next record added
+  MeasurementRecord Records[BLE_HISTORY_SIZE];
+};
+
+extern BleHistoryData myBleHistoryData;
+
+// The last measurements with a sequence number each, so a gateway that
+// missed beacons can read them over a connection. The gateway writes the
+// sequence it wants to read from, which also acknowledges and drops all
+// older records, and then reads pages until the count is zero.
+class BleHistory {
+ private:
+  BleHistoryData* _data;
+  uint32_t _cursor = 0;
+
+ public:
+  explicit BleHistory(BleHistoryData* data) : _data(data) {
+    if (_data->IsDataAvailable != BLE_HISTORY_DATA_AVAILABLE) {
+      memset(_data, 0, sizeof(BleHistoryData));
+      _data->IsDataAvailable = BLE_HISTORY_DATA_AVAILABLE;
+    }
+  }
+
+  uint32_t getFirstSequence() const { return _data->Sequence - _data->Count; }
+  uint32_t getNextSequence() const { return _data->Sequence; }
+  int getCount() const { return _data->Count; }
+
+  void add(const MeasurementRecord& r);
+
+  // Drops the records before sequence and reads from there
+  void setCursor(uint32_t sequence);
+  uint32_t getCursor() const { return _cursor; }
+
+  // Writes the page at the cursor to buf, which must hold
+  // BLE_HISTORY_PAGE_SIZE bytes, and moves the cursor past it
+  size_t readPage(uint8_t* buf, uint32_t clock);
+};
+
+extern BleHistory myBleHistory;
+
+#endif  // SRC_BLEHISTORY_HPP_
+
+// EOF
@@ -38,6 +38,8 @@ void BrewingConfig::createJson(JsonObject& doc) const {
   doc[CONFIG_TOKEN2] = getToken2();
   doc[CONFIG_SLEEP_INTERVAL] = getSleepInterval();
   doc[CONFIG_BATTERY_TYPE] = static_cast<int>(getBatteryType());
+  doc[CONFIG_BATTERY_CAPACITY] = getBatteryCapacity();
+  doc[CONFIG_BATTERY_SLEEP_CURRENT] = getBatterySleepCurrent();
   doc[CONFIG_VOLTAGE_FACTOR] =
       serialized(String(getVoltageFactor(), DECIMALS_BATTERY));
   doc[CONFIG_VOLTAGE_CONFIG] =
@@ -50,8 +52,30 @@ void BrewingConfig::createJson(JsonObject& doc) const {
   doc[CONFIG_PUSH_INTERVAL_GET] = this->getPushIntervalGet();
   doc[CONFIG_PUSH_INTERVAL_INFLUX] = this->getPushIntervalInflux();
   doc[CONFIG_PUSH_INTERVAL_MQTT] = this->getPushIntervalMqtt();
+  doc[CONFIG_PUSH_BATCH] = this->getPushBatch();
+  doc[CONFIG_HTTP_POST_ENCODING] =
+      static_cast<int>(this->getHttpPostEncoding());
+  doc[CONFIG_HTTP_POST2_ENCODING] =
+      static_cast<int>(this->getHttpPost2Encoding());
+  doc[CONFIG_MQTT_RETAIN] = this->isMqttRetain();
+  doc[CONFIG_INFLUXDB2_ENCODING] =
+      static_cast<int>(this->getInfluxDb2Encoding());
+  doc[CONFIG_INFLUXDB2_GZIP] = this->isInfluxDb2Gzip();
 
   doc[CONFIG_TEMPSENSOR_RESOLUTION] = this->getTempSensorResolution();
+  doc[CONFIG_TEMPSENSOR_AGGREGATION] =
+      static_cast<int>(this->getTempSensorAggregation());
+
+  JsonArray probes = doc[CONFIG_TEMPSENSOR_PROBES].to<JsonArray>();
+  for (int i = 0; i < _tempProbeCount; i++) {
+    char buf[17];
+    convertTempAddressToString(&_tempProbes[i].address[0], &buf[0],
+                               sizeof(buf));
+    probes[i]["address"] = buf;
+    probes[i]["adj"] =
+        serialized(String(_tempProbes[i].adjC, DECIMALS_TEMP));
+    probes[i]["weight"] = serialized(String(_tempProbes[i].weight, 2));
+  }
 }
 
 void BrewingConfig::parseJson(JsonObject& doc) {
@@ -76,6 +100,10 @@ void BrewingConfig::parseJson(JsonObject& doc) {
     setTempSensorAdjC(doc[CONFIG_TEMP_ADJ].as<float>());
   if (!doc[CONFIG_BATTERY_TYPE].isNull())
     setBatteryType(doc[CONFIG_BATTERY_TYPE].as<int>());
+  if (!doc[CONFIG_BATTERY_CAPACITY].isNull())
+    setBatteryCapacity(doc[CONFIG_BATTERY_CAPACITY].as<int>());
+  if (!doc[CONFIG_BATTERY_SLEEP_CURRENT].isNull())
+    setBatterySleepCurrent(doc[CONFIG_BATTERY_SLEEP_CURRENT].as<int>());
 
   if (!doc[CONFIG_SKIP_SSL_ON_TEST].isNull())
     setSkipSslOnTest(doc[CONFIG_SKIP_SSL_ON_TEST].as<bool>());
@@ -90,9 +118,48 @@ void BrewingConfig::parseJson(JsonObject& doc) {
     this->setPushIntervalInflux(doc[CONFIG_PUSH_INTERVAL_INFLUX].as<int>());
   if (!doc[CONFIG_PUSH_INTERVAL_MQTT].isNull())
     this->setPushIntervalMqtt(doc[CONFIG_PUSH_INTERVAL_MQTT].as<int>());
+  if (!doc[CONFIG_PUSH_BATCH].isNull())
+    this->setPushBatch(doc[CONFIG_PUSH_BATCH].as<int>());
+  if (!doc[CONFIG_HTTP_POST_ENCODING].isNull())
+    this->setHttpPostEncoding(doc[CONFIG_HTTP_POST_ENCODING].as<int>());
+  if (!doc[CONFIG_HTTP_POST2_ENCODING].isNull())
+    this->setHttpPost2Encoding(doc[CONFIG_HTTP_POST2_ENCODING].as<int>());
+  if (!doc[CONFIG_MQTT_RETAIN].isNull())
+    this->setMqttRetain(doc[CONFIG_MQTT_RETAIN].as<bool>());
+  if (!doc[CONFIG_INFLUXDB2_ENCODING].isNull())
+    this->setInfluxDb2Encoding(doc[CONFIG_INFLUXDB2_ENCODING].as<int>());
+  if (!doc[CONFIG_INFLUXDB2_GZIP].isNull())
+    this->setInfluxDb2Gzip(doc[CONFIG_INFLUXDB2_GZIP].as<bool>());
 
   if (!doc[CONFIG_TEMPSENSOR_RESOLUTION].isNull())
     this->setTempSensorResolution(doc[CONFIG_TEMPSENSOR_RESOLUTION].as<int>());
+  if (!doc[CONFIG_TEMPSENSOR_AGGREGATION].isNull())
+    this->setTempSensorAggregation(
+        doc[CONFIG_TEMPSENSOR_AGGREGATION].as<int>());
+
+  if (!doc[CONFIG_TEMPSENSOR_PROBES].isNull()) {
+    JsonArray array = doc[CONFIG_TEMPSENSOR_PROBES].as<JsonArray>();
+    clearTempProbeConfig();
+
+    for (JsonVariant v : array) {
+      TempProbeConfig probe;
+
+      if (!convertTempAddressFromString(v["address"].as<const char*>(),
+                                        &probe.address[0])) {
+        Log.warning(F("CFG : Ignoring temp probe with invalid address" CR));
+        continue;
+      }
+
+      probe.adjC = v["adj"].isNull() ? 0 : v["adj"].as<float>();
+      probe.weight = v["weight"].isNull() ? 1 : v["weight"].as<float>();
+
+      if (!setTempProbeConfig(probe)) {
+        Log.warning(F("CFG : Too many temp probes defined (%d)" CR),
+                    TEMP_MAX_SENSORS);
+        break;
+      }
+    }
+  }
 }
 
 // EOF
@@ -40,6 +40,8 @@ constexpr auto CONFIG_SLEEP_INTERVAL = "sleep_interval";
 constexpr auto CONFIG_VOLTAGE_FACTOR = "voltage_factor";
 constexpr auto CONFIG_VOLTAGE_CONFIG = "voltage_config";
 constexpr auto CONFIG_BATTERY_TYPE = "battery_type";
+constexpr auto CONFIG_BATTERY_CAPACITY = "battery_capacity";
+constexpr auto CONFIG_BATTERY_SLEEP_CURRENT = "battery_sleep_current";
 constexpr auto CONFIG_TEMP_ADJ = "temp_adjustment_value";
 constexpr auto CONFIG_BLE_FORMAT = "ble_format";
 constexpr auto CONFIG_PUSH_INTERVAL_POST = "http_post_int";
@@ -51,6 +53,25 @@ constexpr auto CONFIG_IGNORE_LOW_ANGLES = "ignore_low_angles";
 constexpr auto CONFIG_BATTERY_SAVING = "battery_saving";
 constexpr auto CONFIG_TEMPSENSOR_RESOLUTION = "tempsensor_resolution";
 constexpr auto CONFIG_FLASH_LOGGING = "flash_logging";
+constexpr auto CONFIG_TEMPSENSOR_AGGREGATION = "tempsensor_aggregation";
+constexpr auto CONFIG_TEMPSENSOR_PROBES = "tempsensor_probes";
+constexpr auto CONFIG_PUSH_BATCH = "push_batch";
+constexpr auto CONFIG_HTTP_POST_ENCODING = "http_post_encoding";
+constexpr auto CONFIG_HTTP_POST2_ENCODING = "http_post2_encoding";
+constexpr auto CONFIG_MQTT_RETAIN = "mqtt_retain";
+constexpr auto CONFIG_INFLUXDB2_ENCODING = "influxdb2_encoding";
+constexpr auto CONFIG_INFLUXDB2_GZIP = "influxdb2_gzip";
+
+constexpr auto PUSH_BATCH_MAX = 48;  // Measurements per upload
+
+// Body of the http post and influxdb targets, only the template encoding
+// uses the data format
+enum PushEncoding {
+  PUSH_ENCODING_TEMPLATE = 0,
+  PUSH_ENCODING_MSGPACK = 1,        // Same fields as the default json template
+  PUSH_ENCODING_BINARY = 2,         // Gravitymon BLE eddystone layout, 14 bytes
+  PUSH_ENCODING_LINE_PROTOCOL = 3,  // Influxdb only, default template fields
+};
 
 class BrewingConfig : public BaseConfig,
                       public BatteryConfigInterface,
@@ -72,9 +93,11 @@ class BrewingConfig : public BaseConfig,
 #else
 #error "Unknown platform"
 #endif
-  BatteryType _batteryType;
+  BatteryType _batteryType = BatteryType::LithiumIon;
 
   float _voltageConfig = 4.15;
+  int _batteryCapacity = 2200;     // mAh
+  int _batterySleepCurrent = 100;  // uA, board and gyro in deep sleep
   float _tempSensorAdjC = 0;
   int _sleepInterval = 900;
 
@@ -94,8 +117,18 @@ class BrewingConfig : public BaseConfig,
   int _pushIntervalGet = 0;
   int _pushIntervalInflux = 0;
   int _pushIntervalMqtt = 0;
+  int _pushBatch = 1;
+  PushEncoding _httpPostEncoding = PushEncoding::PUSH_ENCODING_TEMPLATE;
+  PushEncoding _httpPost2Encoding = PushEncoding::PUSH_ENCODING_TEMPLATE;
+  bool _mqttRetain = false;
+  PushEncoding _influxDb2Encoding = PushEncoding::PUSH_ENCODING_TEMPLATE;
+  bool _influxDb2Gzip = false;
 
   int _tempSensorResolution = 9;  // bits
+  TempSensorAggregation _tempSensorAggregation =
+      TempSensorAggregation::TEMP_AGGREGATION_FIRST;
+  TempProbeConfig _tempProbes[TEMP_MAX_SENSORS];
+  int _tempProbeCount = 0;
 
  public:
   explicit BrewingConfig(String baseMDNS, String fileName);
@@ -153,6 +186,18 @@ class BrewingConfig : public BaseConfig,
     _saveNeeded = true;
   }
 
+  int getBatteryCapacity() const { return _batteryCapacity; }
+  void setBatteryCapacity(int c) {
+    if (c > 0) _batteryCapacity = c;
+    _saveNeeded = true;
+  }
+
+  int getBatterySleepCurrent() const { return _batterySleepCurrent; }
+  void setBatterySleepCurrent(int c) {
+    if (c >= 0) _batterySleepCurrent = c;
+    _saveNeeded = true;
+  }
+
   float getTempSensorAdjC() const { return _tempSensorAdjC; }
   void setTempSensorAdjC(float f) {
     _tempSensorAdjC = f;
@@ -179,6 +224,48 @@ class BrewingConfig : public BaseConfig,
     _saveNeeded = true;
   }
 
+  TempSensorAggregation getTempSensorAggregation() const {
+    return _tempSensorAggregation;
+  }
+  void setTempSensorAggregation(int t) {
+    if (t >= TempSensorAggregation::TEMP_AGGREGATION_FIRST &&
+        t <= TempSensorAggregation::TEMP_AGGREGATION_WEIGHTED)
+      _tempSensorAggregation = (TempSensorAggregation)t;
+    _saveNeeded = true;
+  }
+
+  int getTempProbeCount() const { return _tempProbeCount; }
+  const TempProbeConfig* getTempProbeConfig(int index) const {
+    if (index < 0 || index >= _tempProbeCount) return nullptr;
+    return &_tempProbes[index];
+  }
+  const TempProbeConfig* getTempProbeConfig(const uint8_t* address) const {
+    for (int i = 0; i < _tempProbeCount; i++) {
+      if (!memcmp(&_tempProbes[i].address[0], address, 8))
+        return &_tempProbes[i];
+    }
+    return nullptr;
+  }
+  bool setTempProbeConfig(const TempProbeConfig& probe) {
+    for (int i = 0; i < _tempProbeCount; i++) {
+      if (!memcmp(&_tempProbes[i].address[0], &probe.address[0], 8)) {
+        _tempProbes[i] = probe;
+        _saveNeeded = true;
+        return true;
+      }
+    }
+
+    if (_tempProbeCount >= TEMP_MAX_SENSORS) return false;
+
+    _tempProbes[_tempProbeCount++] = probe;
+    _saveNeeded = true;
+    return true;
+  }
+  void clearTempProbeConfig() {
+    _tempProbeCount = 0;
+    _saveNeeded = true;
+  }
+
   bool isWifiPushActive() const {
     return (hasTargetHttpPost() || hasTargetHttpPost2() || hasTargetHttpGet() ||
             hasTargetInfluxDb2() || hasTargetMqtt() || isWifiDirect())
@@ -216,6 +303,46 @@ class BrewingConfig : public BaseConfig,
     _saveNeeded = true;
   }
 
+  // Number of measurements collected before they are pushed, 1 = every wake
+  int getPushBatch() const { return _pushBatch; }
+  void setPushBatch(int b) {
+    if (b >= 1 && b <= PUSH_BATCH_MAX) _pushBatch = b;
+    _saveNeeded = true;
+  }
+
+  PushEncoding getHttpPostEncoding() const { return _httpPostEncoding; }
+  void setHttpPostEncoding(int e) {
+    if (e >= PUSH_ENCODING_TEMPLATE && e <= PUSH_ENCODING_BINARY)
+      _httpPostEncoding = static_cast<PushEncoding>(e);
+    _saveNeeded = true;
+  }
+
+  PushEncoding getHttpPost2Encoding() const { return _httpPost2Encoding; }
+  void setHttpPost2Encoding(int e) {
+    if (e >= PUSH_ENCODING_TEMPLATE && e <= PUSH_ENCODING_BINARY)
+      _httpPost2Encoding = static_cast<PushEncoding>(e);
+    _saveNeeded = true;
+  }
+
+  bool isMqttRetain() const { return _mqttRetain; }
+  void setMqttRetain(bool b) {
+    _mqttRetain = b;
+    _saveNeeded = true;
+  }
+
+  PushEncoding getInfluxDb2Encoding() const { return _influxDb2Encoding; }
+  void setInfluxDb2Encoding(int e) {
+    if (e == PUSH_ENCODING_TEMPLATE || e == PUSH_ENCODING_LINE_PROTOCOL)
+      _influxDb2Encoding = static_cast<PushEncoding>(e);
+    _saveNeeded = true;
+  }
+
+  bool isInfluxDb2Gzip() const { return _influxDb2Gzip; }
+  void setInfluxDb2Gzip(bool b) {
+    _influxDb2Gzip = b;
+    _saveNeeded = true;
+  }
+
   bool isPushIntervalActive() const {
     return (_pushIntervalPost + _pushIntervalPost2 + _pushIntervalGet +
             _pushIntervalInflux + _pushIntervalMqtt) == 0
@@ -51,10 +51,21 @@ void GravitymonConfig::createJson(JsonObject& doc) const {
   cal["gy"] = _gyroCalibration.gy;
   cal["gz"] = _gyroCalibration.gz;
 
+  JsonObject comp = doc[CONFIG_GYRO_TEMP_COMPENSATION].to<JsonObject>();
+  comp["ref"] = _gyroTempCompensation.refTempC;
+  comp["c1"] = _gyroTempCompensation.c1;
+  comp["c2"] = _gyroTempCompensation.c2;
+  if (!isnan(_gyroTempCompensation.residualDrift))
+    comp["drift"] = _gyroTempCompensation.residualDrift;
+
+  // Formatted on the stack, a String per value fragments the heap
   JsonArray fdArray = doc[CONFIG_FORMULA_DATA].to<JsonArray>();
   for (int i = 0; i < FORMULA_DATA_SIZE; i++) {
-    fdArray[i]["a"] = serialized(String(_formulaData.a[i], DECIMALS_TILT));
-    fdArray[i]["g"] = serialized(String(_formulaData.g[i], DECIMALS_SG));
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%.*f", DECIMALS_TILT, _formulaData.a[i]);
+    fdArray[i]["a"] = serialized(buf);
+    snprintf(buf, sizeof(buf), "%.*f", DECIMALS_SG, _formulaData.g[i]);
+    fdArray[i]["g"] = serialized(buf);
   }
 
   doc[CONFIG_GYRO_READ_COUNT] = this->getGyroReadCount();
@@ -65,6 +76,11 @@ void GravitymonConfig::createJson(JsonObject& doc) const {
   doc[CONFIG_FORMULA_CALIBRATION_TEMP] = this->getDefaultCalibrationTemp();
   doc[CONFIG_IGNORE_LOW_ANGLES] = this->isIgnoreLowAngles();
   doc[CONFIG_BLE_FORMAT] = getGravitymonBleFormat();
+  doc[CONFIG_BLE_INTERVAL] = this->getBleInterval();
+  doc[CONFIG_BLE_WINDOW] = this->getBleWindow();
+  doc[CONFIG_BLE_ACK] = this->isBleAck();
+  doc[CONFIG_BLE_HISTORY] = this->isBleHistory();
+  doc[CONFIG_BLE_FORMAT_EXTRA] = this->getBleFormatExtra();
   doc[CONFIG_BATTERY_SAVING] = this->isBatterySaving();
   doc[CONFIG_CHARGING_PIN_ENABLED] = this->isPinChargingMode();
 
@@ -112,6 +128,14 @@ void GravitymonConfig::parseJson(JsonObject& doc) {
   if (!doc[CONFIG_GYRO_CALIBRATION]["gz"].isNull())
     _gyroCalibration.gz = doc[CONFIG_GYRO_CALIBRATION]["gz"];
 
+  if (!doc[CONFIG_GYRO_TEMP_COMPENSATION].isNull()) {
+    JsonObject comp = doc[CONFIG_GYRO_TEMP_COMPENSATION].as<JsonObject>();
+    _gyroTempCompensation.refTempC = comp["ref"] | 0.0f;
+    _gyroTempCompensation.c1 = comp["c1"] | 0.0f;
+    _gyroTempCompensation.c2 = comp["c2"] | 0.0f;
+    _gyroTempCompensation.residualDrift = comp["drift"] | NAN;
+  }
+
   if (!doc[CONFIG_FORMULA_DATA].isNull()) {
     JsonArray array = doc[CONFIG_FORMULA_DATA].as<JsonArray>();
     int i = 0;
@@ -144,6 +168,16 @@ void GravitymonConfig::parseJson(JsonObject& doc) {
     setIgnoreLowAngles(doc[CONFIG_IGNORE_LOW_ANGLES].as<bool>());
   if (!doc[CONFIG_BLE_FORMAT].isNull())
     setGravitymonBleFormat(doc[CONFIG_BLE_FORMAT].as<int>());
+  if (!doc[CONFIG_BLE_INTERVAL].isNull())
+    setBleInterval(doc[CONFIG_BLE_INTERVAL].as<int>());
+  if (!doc[CONFIG_BLE_WINDOW].isNull())
+    setBleWindow(doc[CONFIG_BLE_WINDOW].as<int>());
+  if (!doc[CONFIG_BLE_ACK].isNull())
+    setBleAck(doc[CONFIG_BLE_ACK].as<bool>());
+  if (!doc[CONFIG_BLE_HISTORY].isNull())
+    setBleHistory(doc[CONFIG_BLE_HISTORY].as<bool>());
+  if (!doc[CONFIG_BLE_FORMAT_EXTRA].isNull())
+    setBleFormatExtra(doc[CONFIG_BLE_FORMAT_EXTRA].as<int>());
   if (!doc[CONFIG_BATTERY_SAVING].isNull())
     setBatterySaving(doc[CONFIG_BATTERY_SAVING].as<bool>());
   if (!doc[CONFIG_CHARGING_PIN_ENABLED].isNull())
@@ -38,6 +38,7 @@ constexpr auto CONFIG_GYRO_TEMP = "gyro_temp";
 constexpr auto CONFIG_GYRO_FILTER = "gyro_filter";
 constexpr auto CONFIG_GYRO_TYPE = "gyro_type";
 constexpr auto CONFIG_GYRO_SWAP_XY = "gyro_swap_xy";
+constexpr auto CONFIG_GYRO_TEMP_COMPENSATION = "gyro_temp_compensation";
 constexpr auto CONFIG_STORAGE_SLEEP = "storage_sleep";
 constexpr auto CONFIG_FORMULA_DATA = "formula_calculation_data";
 constexpr auto CONFIG_GRAVITY = "gravity";
@@ -48,6 +49,18 @@ constexpr auto CONFIG_FORMULA_DEVIATION = "formula_max_deviation";
 constexpr auto CONFIG_FORMULA_CALIBRATION_TEMP = "formula_calibration_temp";
 constexpr auto CONFIG_CHARGING_PIN_ENABLED = "charging_pin_enabled";
 constexpr auto CONFIG_REGISTERED = "registered";
+constexpr auto CONFIG_BLE_INTERVAL = "ble_interval";
+constexpr auto CONFIG_BLE_WINDOW = "ble_window";
+constexpr auto CONFIG_BLE_ACK = "ble_ack";
+constexpr auto CONFIG_BLE_HISTORY = "ble_history";
+constexpr auto CONFIG_BLE_FORMAT_EXTRA = "ble_format_extra";
+
+// ms, non connectable and scannable legacy advertising needs at least 100 ms
+// on BT 4.2 controllers so that is the lower limit for all formats.
+constexpr auto BLE_INTERVAL_MIN = 100;
+constexpr auto BLE_INTERVAL_MAX = 10240;
+constexpr auto BLE_WINDOW_MIN = 100;  // ms
+constexpr auto BLE_WINDOW_MAX = 10000;
 
 enum GravitymonBleFormat {
   BLE_DISABLED = 0,
@@ -59,6 +72,9 @@ enum GravitymonBleFormat {
   BLE_RAPT_V2 = 7,
 };
 
+// Bit per GravitymonBleFormat value
+constexpr auto BLE_FORMAT_MASK = 0xf6;
+
 // Used for holding formulaData (used for calculating formula on device)
 #define FORMULA_DATA_SIZE 20
 
@@ -73,6 +89,7 @@ class GravitymonConfig : public BrewingConfig, public GyroConfigInterface {
   String _bleTiltColor;
 
   RawGyroData _gyroCalibration = {0, 0, 0, 0, 0, 0};
+  GyroTempCompensation _gyroTempCompensation = {0, 0, 0, NAN};
   RawFormulaData _formulaData = {
       {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
       {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}};
@@ -97,6 +114,12 @@ class GravitymonConfig : public BrewingConfig, public GyroConfigInterface {
   int _gyroReadCount = 50;
   int _gyroReadDelay = 3150;  // us, empirical, to hold sampling to 200 Hz
 
+  int _bleInterval = 100;  // ms
+  int _bleWindow = 1000;   // ms
+  bool _bleAck = false;
+  bool _bleHistory = false;
+  uint8_t _bleFormatExtra = 0;  // Formats sent after the primary format
+
   bool _registered = false;
 
  public:
@@ -184,6 +207,14 @@ class GravitymonConfig : public BrewingConfig, public GyroConfigInterface {
                : true;
   }
 
+  const GyroTempCompensation& getGyroTempCompensation() const {
+    return _gyroTempCompensation;
+  }
+  void setGyroTempCompensation(const GyroTempCompensation& t) {
+    _gyroTempCompensation = t;
+    _saveNeeded = true;
+  }
+
   const RawFormulaData& getFormulaData() const { return _formulaData; }
   void setFormulaData(const RawFormulaData& r) {
     _formulaData = r;
@@ -224,9 +255,7 @@ class GravitymonConfig : public BrewingConfig, public GyroConfigInterface {
     _saveNeeded = true;
   }
 
-  bool isBleActive() const {
-    return (_gravitymonBleFormat != GravitymonBleFormat::BLE_DISABLED);
-  }
+  bool isBleActive() const { return getBleFormats() != 0; }
 
   const GravitymonBleFormat getGravitymonBleFormat() const {
     return _gravitymonBleFormat;
@@ -240,6 +269,46 @@ class GravitymonConfig : public BrewingConfig, public GyroConfigInterface {
     _saveNeeded = true;
   }
 
+  int getBleInterval() const { return _bleInterval; }
+  void setBleInterval(int i) {
+    if (i >= BLE_INTERVAL_MIN && i <= BLE_INTERVAL_MAX) _bleInterval = i;
+    _saveNeeded = true;
+  }
+
+  int getBleWindow() const { return _bleWindow; }
+  void setBleWindow(int w) {
+    if (w >= BLE_WINDOW_MIN && w <= BLE_WINDOW_MAX) _bleWindow = w;
+    _saveNeeded = true;
+  }
+
+  // Additional formats as a mask with bit n set for format n, the formats are
+  // sent one after the other within the advertising window
+  uint8_t getBleFormatExtra() const { return _bleFormatExtra; }
+  void setBleFormatExtra(int m) {
+    _bleFormatExtra = m & BLE_FORMAT_MASK;
+    _saveNeeded = true;
+  }
+
+  // All formats to send, the primary format included
+  uint8_t getBleFormats() const {
+    uint8_t mask = _bleFormatExtra;
+    if (_gravitymonBleFormat != GravitymonBleFormat::BLE_DISABLED)
+      mask |= 1 << _gravitymonBleFormat;
+    return mask & BLE_FORMAT_MASK;
+  }
+
+  bool isBleAck() const { return _bleAck; }
+  void setBleAck(bool b) {
+    _bleAck = b;
+    _saveNeeded = true;
+  }
+
+  bool isBleHistory() const { return _bleHistory; }
+  void setBleHistory(bool b) {
+    _bleHistory = b;
+    _saveNeeded = true;
+  }
+
   bool isIgnoreLowAngles() const { return _ignoreLowAngles; }
   void setIgnoreLowAngles(bool b) {
     _ignoreLowAngles = b;
@@ -151,6 +151,21 @@ bool GyroSensor::read() {
     _angle = SIMULATE_ANGLE;
 #endif
 
+    _rawAngle = _angle;
+
+    if (_tempCompCalibration) _tempCompCalibration->addSample(_temp, _angle);
+
+    // Remove the thermal drift of the accelerometer before filtering
+    const GyroTempCompensation& comp = _gyroConfig->getGyroTempCompensation();
+
+    if (comp.isActive()) {
+      _angle -= comp.getOffset(_temp);
+#if LOG_LEVEL == 6
+      Log.verbose(F("GYRO: Temp compensated angle %F -> %F at %F C." CR),
+                  _rawAngle, _angle, _temp);
+#endif
+    }
+
     if (isnan(_initialSensorTemp)) {
       Log.notice(F("GYRO: Assigning initial gyro temperature %F." CR), resultData.temp);
       _initialSensorTemp = resultData.temp;
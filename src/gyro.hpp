@@ -34,6 +34,7 @@
 
 #include <lowpass.hpp>
 #include <memory>
+#include <tempcomp.hpp>
 #include <tempsensor.hpp>
 
 enum GyroType {
@@ -111,6 +112,7 @@ class GyroConfigInterface {
   virtual bool isGyroSwapXY() const = 0;
   virtual int getGyroSensorMovingThreashold() const = 0;
   virtual GyroType getGyroType() const = 0;
+  virtual const GyroTempCompensation& getGyroTempCompensation() const = 0;
 
   // Methods for ICM42670p
   virtual int getSleepInterval() const = 0;
@@ -161,9 +163,11 @@ class GyroSensor : public SecondayTempSensorInterface {
 #if defined(ESP32)
   std::unique_ptr<FilterBase> _filter;
 #endif
+  std::unique_ptr<GyroTempCompCalibration> _tempCompCalibration;
 
   RawGyroData _lastGyroData = {0};
   float _angle = 0;
+  float _rawAngle = 0;
   float _filteredAngle = 0;
   float _temp = 0;
   float _initialSensorTemp = NAN;
@@ -200,6 +204,7 @@ class GyroSensor : public SecondayTempSensorInterface {
 
   const RawGyroData& getLastGyroData() const { return _lastGyroData; }
   float getAngle() const { return _angle; }
+  float getRawAngle() const { return _rawAngle; }  // Before temp compensation
   float getFilteredAngle() const { return _filteredAngle; }
   float getSensorTempC() const { return _temp; }
   float getInitialSensorTempC() const { return _initialSensorTemp; }
@@ -210,6 +215,16 @@ class GyroSensor : public SecondayTempSensorInterface {
   bool hasValue() const { return _valid; }
   bool needCalibration() { return _impl ? _impl->needCalibration() : false; }
   void enterSleep();
+
+  // Guided calibration of the temperature compensation, samples are collected
+  // on each read until the calibration is stopped.
+  void startTempCompCalibration() {
+    _tempCompCalibration.reset(new GyroTempCompCalibration());
+  }
+  void stopTempCompCalibration() { _tempCompCalibration.reset(); }
+  GyroTempCompCalibration* getTempCompCalibration() {
+    return _tempCompCalibration.get();
+  }
 };
 
 extern GyroSensor myGyro;
@@ -0,0 +1,196 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <gzip.hpp>
+#include <memory>
+#include <new>
+
+static constexpr auto minMatch = 3;
+static constexpr auto maxMatch = 258;
+static constexpr auto windowSize = 32768;
+static constexpr uint16_t noPosition = 0xffff;
+
+// Base value and extra bits for the length codes 257-285 and the distance
+// codes 0-29, RFC 1951 3.2.5
+static const uint16_t lengthBase[] = {3,  4,  5,  6,  7,  8,  9,  10,
+                                      11, 13, 15, 17, 19, 23, 27, 31,
+                                      35, 43, 51, 59, 67, 83, 99, 115,
+                                      131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                      1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                      4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distBase[] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+static const uint8_t distExtra[] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                    4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                    9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+class BitWriter {
+ private:
+  uint8_t* _buf;
+  size_t _size;
+  size_t _length = 0;
+  uint32_t _bits = 0;
+  int _count = 0;
+  bool _overflow = false;
+
+ public:
+  BitWriter(uint8_t* buf, size_t size) : _buf(buf), _size(size) {}
+
+  void put(uint8_t b) {
+    if (_length < _size)
+      _buf[_length++] = b;
+    else
+      _overflow = true;
+  }
+
+  // Values are stored lsb first
+  void write(uint32_t value, int bits) {
+    _bits |= value << _count;
+    _count += bits;
+
+    while (_count >= 8) {
+      put(_bits & 0xff);
+      _bits >>= 8;
+      _count -= 8;
+    }
+  }
+
+  // Huffman codes are stored msb first
+  void writeCode(uint32_t code, int bits) {
+    uint32_t reversed = 0;
+
+    for (int i = 0; i < bits; i++)
+      reversed |= ((code >> i) & 1) << (bits - 1 - i);
+    write(reversed, bits);
+  }
+
+  void flush() {
+    if (_count) put(_bits & 0xff);
+    _bits = 0;
+    _count = 0;
+  }
+
+  size_t getLength() const { return _overflow ? 0 : _length; }
+};
+
+static void writeSymbol(BitWriter& w, int sym) {
+  if (sym < 144)
+    w.writeCode(0x30 + sym, 8);
+  else if (sym < 256)
+    w.writeCode(0x190 + sym - 144, 9);
+  else if (sym < 280)
+    w.writeCode(sym - 256, 7);
+  else
+    w.writeCode(0xc0 + sym - 280, 8);
+}
+
+static void writeMatch(BitWriter& w, int length, int dist) {
+  int i = 28;
+  while (lengthBase[i] > length) i--;
+  writeSymbol(w, 257 + i);
+  w.write(length - lengthBase[i], lengthExtra[i]);
+
+  i = 29;
+  while (distBase[i] > dist) i--;
+  w.writeCode(i, 5);
+  w.write(dist - distBase[i], distExtra[i]);
+}
+
+static inline uint16_t getHash(const uint8_t* p) {
+  uint32_t v = p[0] << 16 | p[1] << 8 | p[2];
+  return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+uint32_t getCrc32(const uint8_t* in, size_t length) {
+  uint32_t crc = 0xffffffff;
+
+  for (size_t i = 0; i < length; i++) {
+    crc ^= in[i];
+    for (int j = 0; j < 8; j++) crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+
+  return ~crc;
+}
+
+size_t gzipCompress(const uint8_t* in, size_t length, uint8_t* out,
+                    size_t size) {
+  if (length >= noPosition) return 0;
+
+  // Last position of each hash, only the newest candidate is tried
+  std::unique_ptr<uint16_t[]> head(new (std::nothrow)
+                                       uint16_t[1 << GZIP_HASH_BITS]);
+  if (!head) return 0;
+
+  memset(head.get(), 0xff, sizeof(uint16_t) << GZIP_HASH_BITS);
+
+  BitWriter w(out, size);
+  const uint8_t header[] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+
+  for (uint8_t b : header) w.put(b);
+
+  w.write(1, 1);  // Last block
+  w.write(1, 2);  // Fixed codes
+
+  size_t i = 0;
+  while (i < length) {
+    size_t best = 0, dist = 0;
+
+    if (i + minMatch <= length) {
+      uint16_t h = getHash(&in[i]);
+      uint16_t candidate = head[h];
+      head[h] = i;
+
+      if (candidate != noPosition && i - candidate <= windowSize) {
+        size_t max = length - i < maxMatch ? length - i : maxMatch;
+        while (best < max && in[candidate + best] == in[i + best]) best++;
+        dist = i - candidate;
+      }
+    }
+
+    if (best >= minMatch) {
+      writeMatch(w, best, dist);
+
+      // Positions inside the match are added so later lines can refer to them
+      for (size_t j = i + 1; j < i + best && j + minMatch <= length; j++)
+        head[getHash(&in[j])] = j;
+      i += best;
+    } else {
+      writeSymbol(w, in[i]);
+      i++;
+    }
+  }
+
+  writeSymbol(w, 256);  // End of block
+  w.flush();
+
+  uint32_t crc = getCrc32(in, length);
+  for (int j = 0; j < 32; j += 8) w.put(crc >> j);
+  for (int j = 0; j < 32; j += 8) w.put(length >> j);
+
+  return w.getLength();
+}
+
+// EOF
@@ -0,0 +1,42 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_GZIP_HPP_
+#define SRC_GZIP_HPP_
+
+#include <Arduino.h>
+
+constexpr auto GZIP_HASH_BITS = 10;
+constexpr auto GZIP_OVERHEAD = 18;  // Header and trailer
+
+// Compresses into a gzip stream with the fixed deflate codes, which needs no
+// tables to be built and does well on the repeated names in line protocol.
+// Returns 0 if the result does not fit in size, the input is 64 kb or more
+// or memory is low.
+size_t gzipCompress(const uint8_t* in, size_t length, uint8_t* out,
+                    size_t size);
+uint32_t getCrc32(const uint8_t* in, size_t length);
+
+#endif  // SRC_GZIP_HPP_
+
+// EOF
@@ -0,0 +1,184 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <lineprotocol.hpp>
+#include <pushtarget.hpp>
+
+struct LineProtocolKey {
+  const char* name;
+  const char* variable;
+};
+
+// Same names as the default influxdb templates, tags are sorted by key which
+// is the order the server prefers
+static const LineProtocolKey gravityTags[] = {
+    {"device", TPL_ID},
+    {"gravity-format", TPL_GRAVITY_UNIT},
+    {"host", TPL_MDNS},
+    {"temp-format", TPL_TEMP_UNITS},
+};
+
+static const LineProtocolKey gravityFields[] = {
+    {"gravity", TPL_GRAVITY},
+    {"velocity", TPL_VELOCITY},
+    {"corr-gravity", TPL_GRAVITY_CORR},
+    {"angle", TPL_ANGLE},
+    {"temp", TPL_TEMP},
+    {"battery", TPL_BATTERY},
+    {"rssi", TPL_RSSI},
+};
+
+static const LineProtocolKey pressureTags[] = {
+    {"device", TPL_ID},
+    {"host", TPL_MDNS},
+    {"pressure-unit", TPL_PRESSURE_UNIT},
+    {"temperature-unit", TPL_TEMP_UNITS},
+};
+
+static const LineProtocolKey pressureFields[] = {
+    {"pressure", TPL_PRESSURE},
+    {"temp", TPL_TEMP},
+    {"battery", TPL_BATTERY},
+    {"rssi", TPL_RSSI},
+};
+
+void LineProtocolWriter::escape(const char* s, size_t length,
+                                const char* special) {
+  for (size_t i = 0; i < length; i++) {
+    if (s[i] == '\n' || s[i] == '\r') continue;  // Not allowed anywhere
+    if (strchr(special, s[i])) _out += '\\';
+    _out += s[i];
+  }
+}
+
+void LineProtocolWriter::beginLine(const char* measurement) {
+  if (_out.length()) _out += '\n';
+
+  _lineStart = _out.length();
+  _fields = 0;
+  escape(measurement, strlen(measurement), ", ");
+}
+
+void LineProtocolWriter::addTag(const char* key, const char* value,
+                                size_t length) {
+  if (!length) return;
+
+  _out += ',';
+  escape(key, strlen(key), ",= ");
+  _out += '=';
+  escape(value, length, ",= ");
+}
+
+void LineProtocolWriter::addField(const char* key,
+                                  const TemplateValues& values, int id) {
+  TemplateValueType type = values.getType(id);
+
+  if (type == TEMPLATE_VALUE_NONE) return;
+  if (type == TEMPLATE_VALUE_FLOAT && !isfinite(values.getFloat(id))) return;
+
+  _out += _fields ? ',' : ' ';
+  escape(key, strlen(key), ",= ");
+  _out += '=';
+
+  if (type == TEMPLATE_VALUE_FLOAT || type == TEMPLATE_VALUE_INT) {
+    _out.concat(values.getVal(id), values.getLength(id));
+  } else {
+    _out += '"';
+    escape(values.getVal(id), values.getLength(id), "\"\\");
+    _out += '"';
+  }
+
+  _fields++;
+}
+
+bool LineProtocolWriter::endLine(uint32_t timestamp) {
+  if (!_fields) {
+    _out.remove(_lineStart ? _lineStart - 1 : 0);
+    return false;
+  }
+
+  // Nanoseconds, the default precision of the write api
+  if (timestamp) {
+    _out += ' ';
+    _out += String(timestamp);
+    _out += "000000000";
+  }
+
+  _lines++;
+  return true;
+}
+
+bool writeLineProtocol(LineProtocolWriter& w, const TemplateValues& values,
+                       bool pressure) {
+  const LineProtocolKey* tags = pressure ? &pressureTags[0] : &gravityTags[0];
+  const LineProtocolKey* fields =
+      pressure ? &pressureFields[0] : &gravityFields[0];
+  int tagCount = pressure ? sizeof(pressureTags) / sizeof(LineProtocolKey)
+                          : sizeof(gravityTags) / sizeof(LineProtocolKey);
+  int fieldCount = pressure
+                       ? sizeof(pressureFields) / sizeof(LineProtocolKey)
+                       : sizeof(gravityFields) / sizeof(LineProtocolKey);
+  int timestampId = getTemplateVariableId(TPL_TIMESTAMP);
+
+  w.beginLine("measurement");
+
+  for (int i = 0; i < tagCount; i++) {
+    int id = getTemplateVariableId(tags[i].variable);
+    if (values.hasVal(id))
+      w.addTag(tags[i].name, values.getVal(id), values.getLength(id));
+  }
+
+  for (int i = 0; i < fieldCount; i++) {
+    w.addField(fields[i].name, values,
+               getTemplateVariableId(fields[i].variable));
+  }
+
+  return w.endLine(values.hasVal(timestampId) ? values.getInt(timestampId)
+                                              : 0);
+}
+
+uint64_t getLineProtocolVariables(bool pressure) {
+  uint64_t mask = 0;
+
+  auto add = [&mask](const LineProtocolKey& k) {
+    int id = getTemplateVariableId(k.variable);
+    if (id >= 0) mask |= static_cast<uint64_t>(1) << id;
+  };
+
+  if (pressure) {
+    for (const LineProtocolKey& k : pressureTags) add(k);
+    for (const LineProtocolKey& k : pressureFields) add(k);
+  } else {
+    for (const LineProtocolKey& k : gravityTags) add(k);
+    for (const LineProtocolKey& k : gravityFields) add(k);
+  }
+
+  add({"", TPL_TIMESTAMP});
+  return mask;
+}
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
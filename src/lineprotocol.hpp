@@ -0,0 +1,70 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_LINEPROTOCOL_HPP_
+#define SRC_LINEPROTOCOL_HPP_
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <Arduino.h>
+
+#include <templatecompiler.hpp>
+
+// Appends InfluxDB line protocol to a String, one point per line. Names and
+// tag values are escaped. Empty tags and fields without a usable value are
+// left out since the server rejects the whole request for those.
+class LineProtocolWriter {
+ private:
+  String& _out;
+  size_t _lineStart = 0;
+  int _fields = 0;
+  int _lines = 0;
+
+  void escape(const char* s, size_t length, const char* special);
+
+ public:
+  explicit LineProtocolWriter(String& out) : _out(out) {}
+
+  void beginLine(const char* measurement);
+  void addTag(const char* key, const char* value, size_t length);
+  // Numbers are written as floats like the template does, so points from
+  // both end up with the same field type
+  void addField(const char* key, const TemplateValues& values, int id);
+  // Ends the point with the time in seconds, 0 lets the server set the time.
+  // Returns false and removes the line if it has no fields.
+  bool endLine(uint32_t timestamp);
+
+  int getLineCount() const { return _lines; }
+};
+
+// Writes one point with the same measurement, tags and fields as the default
+// influxdb template, the timestamp is taken from ${timestamp} when set.
+bool writeLineProtocol(LineProtocolWriter& w, const TemplateValues& values,
+                       bool pressure);
+uint64_t getLineProtocolVariables(bool pressure);
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+#endif  // SRC_LINEPROTOCOL_HPP_
+
+// EOF
@@ -35,11 +35,14 @@
 #include <ota.hpp>
 #include <perf.hpp>
 #include <serialws.hpp>
+#include <telemetryws.hpp>
 #include <wificonnection.hpp>
 
 // Common
 #include <battery.hpp>
 #include <helper.hpp>
+#include <measurementqueue.hpp>
+#include <pushscheduler.hpp>
 #include <pushtarget.hpp>
 #include <utils.hpp>
 
@@ -90,9 +93,13 @@ uint32_t pushMillis = 0;  // Used to control how often we will send push data
 uint32_t runtimeMillis;   // Used to calculate the total time since start/wakeup
 uint32_t stableGyroMillis;  // Used to calculate the total time since last
                             // stable gyro reading
+uint32_t wifiStartMillis = 0;  // When the wifi radio was turned on
+uint32_t bleRadioMillis = 0;   // Time spent sending BLE data
+bool pushDeferred = false;     // Measurement is queued, pushed on a later wake
 RunMode runMode = RunMode::measurementMode;
 
 void checkSleepMode(float angle, float volt);
+bool pushQueuedMeasurements();
 void runGpioHardwareTests();
 
 void setup() {
@@ -192,7 +199,7 @@ void setup() {
       }
 
       myBatteryVoltage.read();
-      checkSleepMode(myGyro.getAngle(), myBatteryVoltage.getVoltage());
+      checkSleepMode(myGyro.getAngle(), myBatteryVoltage.getRawVoltage());
       Log.notice(F("Main: Battery %F V, Gyro=%F, Run-mode=%d." CR),
                  myBatteryVoltage.getVoltage(), myGyro.getAngle(), runMode);
 
@@ -205,8 +212,22 @@ void setup() {
       }
 #endif
 
+      if (runMode == RunMode::measurementMode && myConfig.isWifiPushActive() &&
+          !myConfig.isWifiDirect()) {
+        myMeasurementQueue.addWake();
+
+        if (myMeasurementQueue.getWakes() < myConfig.getPushBatch()) {
+          Log.notice(F("Main: Queueing measurement %d of %d, skipping wifi "
+                       "connection." CR),
+                     myMeasurementQueue.getWakes(), myConfig.getPushBatch());
+          pushDeferred = true;
+          needWifi = false;
+        }
+      }
+
       if (needWifi) {
         PERF_BEGIN("main-wifi-connect");
+        wifiStartMillis = millis();
         if (myConfig.isWifiDirect() && runMode == RunMode::measurementMode) {
           if (!myWifi.connect(true)) {
             Log.notice(
@@ -249,6 +270,7 @@ void setup() {
           myWebServer.setupWebServer("gravitymon");  // Takes less than 4ms, so
                                                      // skip this measurement
           mySerialWebSocket.begin(myWebServer.getWebServer(), &Serial);
+          myTelemetryWebSocket.begin(myWebServer.getWebServer());
           mySerial.begin(&mySerialWebSocket);
       } else {
         // We cant use LED on ESP32C3 since that pin is connected to GYRO
@@ -328,6 +350,10 @@ bool loopReadGravity() {
                  "corr_gravity=%F, velocity=%F." CR),
                angle, filteredAngle, tempC, gravitySG, corrGravitySG, velocity);
 
+    if (runMode != RunMode::measurementMode)
+      myTelemetryWebSocket.send(true, myGyro.isSensorMoving(), angle, tempC,
+                                gravitySG, myBatteryVoltage.getVoltage());
+
     bool pushExpired = (abs(static_cast<int32_t>((millis() - pushMillis))) >
                         (myConfig.getSleepInterval() * 1000));
     bool angleValid = true;
@@ -346,62 +372,118 @@ bool loopReadGravity() {
 
 #if defined(ENABLE_BLE)
       if (myConfig.isBleActive() && angleValid) {
-        myBleSender.init();
-
-        switch (myConfig.getGravitymonBleFormat()) {
-          case GravitymonBleFormat::BLE_TILT: {
-            String color = myConfig.getBleTiltColor();
-            myBleSender.sendTiltData(color, convertCtoF(tempC), gravitySG,
-                                     false);
-          } break;
-          case GravitymonBleFormat::BLE_TILT_PRO: {
-            String color = myConfig.getBleTiltColor();
-            myBleSender.sendTiltData(color, convertCtoF(tempC), gravitySG,
-                                     true);
-          } break;
-          case GravitymonBleFormat::BLE_GRAVITYMON_IBEACON: {
-            myBleSender.sendCustomBeaconData(myBatteryVoltage.getVoltage(),
-                                             tempC, gravitySG, angle);
-          } break;
-
-          case GravitymonBleFormat::BLE_GRAVITYMON_EDDYSTONE: {
-            myBleSender.sendEddystoneData(myBatteryVoltage.getVoltage(), tempC,
-                                          gravitySG, angle);
-          } break;
-
-          case GravitymonBleFormat::BLE_RAPT_V1: {
-            myBleSender.sendRaptV1Data(
-                getBatteryPercentage(myBatteryVoltage.getVoltage(),
-                                     BatteryType::LithiumIon),
-                tempC, gravitySG, angle);
-          } break;
-
-          case GravitymonBleFormat::BLE_RAPT_V2: {
-            myBleSender.sendRaptV2Data(
-                getBatteryPercentage(myBatteryVoltage.getVoltage(),
-                                     BatteryType::LithiumIon),
-                tempC, gravitySG, angle, gv.isVelocityValid() ? velocity : NAN);
-          } break;
+        uint32_t bleStart = millis();
+        myBleSender.init(myConfig.getBleInterval(), myConfig.getBleWindow(),
+                         myConfig.isBleAck(),
+                         myConfig.isBleHistory() ? &myBleHistory : nullptr);
+
+        if (myConfig.isBleHistory() && runMode == RunMode::measurementMode) {
+          MeasurementRecord r;
+          r.set(myPushScheduler.getDeviceClock(), angle, tempC, gravitySG,
+                corrGravitySG, velocity, myBatteryVoltage.getVoltage());
+          myBleHistory.add(r);
         }
+
+        uint8_t formats = myConfig.getBleFormats();
+        int count = __builtin_popcount(formats);
+
+        myBleSender.setFormatCount(count);
+        uint32_t bleRadio = myBleSender.getRadioTime();
+
+        // The primary format goes first, then the extra ones in bit order
+        int primary = static_cast<int>(myConfig.getGravitymonBleFormat());
+
+        for (int n = -1; n < 8; n++) {
+          int i = n < 0 ? primary : n;
+          if (n >= 0 && i == primary) continue;
+          if (!(formats & (1 << i))) continue;
+
+          GravitymonBleFormat format = static_cast<GravitymonBleFormat>(i);
+
+          switch (format) {
+            case GravitymonBleFormat::BLE_TILT: {
+              String color = myConfig.getBleTiltColor();
+              myBleSender.sendTiltData(color, convertCtoF(tempC), gravitySG,
+                                       false);
+            } break;
+            case GravitymonBleFormat::BLE_TILT_PRO: {
+              String color = myConfig.getBleTiltColor();
+              myBleSender.sendTiltData(color, convertCtoF(tempC), gravitySG,
+                                       true);
+            } break;
+            case GravitymonBleFormat::BLE_GRAVITYMON_IBEACON: {
+              myBleSender.sendCustomBeaconData(myBatteryVoltage.getVoltage(),
+                                               tempC, gravitySG, angle);
+            } break;
+
+            case GravitymonBleFormat::BLE_GRAVITYMON_EDDYSTONE: {
+              myBleSender.sendEddystoneData(myBatteryVoltage.getVoltage(),
+                                            tempC, gravitySG, angle);
+            } break;
+
+            case GravitymonBleFormat::BLE_RAPT_V1: {
+              myBleSender.sendRaptV1Data(
+                  getBatteryPercentage(myBatteryVoltage.getVoltage(),
+                                       myConfig.getBatteryType()),
+                  tempC, gravitySG, angle);
+            } break;
+
+            case GravitymonBleFormat::BLE_RAPT_V2: {
+              myBleSender.sendRaptV2Data(
+                  getBatteryPercentage(myBatteryVoltage.getVoltage(),
+                                       myConfig.getBatteryType()),
+                  tempC, gravitySG, angle,
+                  gv.isVelocityValid() ? velocity : NAN);
+            } break;
+          }
+        }
+
+        // A single format is advertised for the whole window
+        bleRadio = myBleSender.getRadioTime() - bleRadio;
+        Log.notice(
+            F("MAIN: Sent %d BLE formats in %dms, %d%% of single format." CR),
+            count, bleRadio, bleRadio * 100 / myConfig.getBleWindow());
+
+        bleRadioMillis += millis() - bleStart;
       }
 #endif  // ENABLE_BLE
 
-      if (myWifi.isConnected() && angleValid) {  // no need to try if there is
-                                                 // no wifi connection.
+      // Store the measurement when it cant be pushed now, or when older
+      // measurements are waiting so they are sent in order.
+      bool queued = false;
+
+      if (angleValid && runMode == RunMode::measurementMode &&
+          myConfig.isWifiPushActive() && !myConfig.isWifiDirect() &&
+          (pushDeferred || !myWifi.isConnected() ||
+           myMeasurementQueue.getCount() > 0)) {
+        MeasurementRecord r;
+        r.set(myPushScheduler.getDeviceClock(), angle, tempC, gravitySG,
+              corrGravitySG, velocity, myBatteryVoltage.getVoltage());
+        myMeasurementQueue.add(r);
+        queued = true;
+
+        if (myWifi.isConnected() && !pushDeferred) pushQueuedMeasurements();
+      }
+
+      if (myWifi.isConnected() && angleValid &&
+          !queued) {  // no need to try if there is no wifi connection.
         if (myConfig.isWifiDirect() && runMode == RunMode::measurementMode &&
             WiFi.SSID() == String(myConfig.getWifiDirectSSID())) {
           Log.notice(F(
               "Main: Sending data via Wifi Direct to Gravitymon Gateway." CR));
 
-          TemplatingEngine engine;
+          TemplateValues values;
+          CompiledTemplate tpl;
           BrewingPush push(&myConfig);
-          setupTemplateEngineGravity(&myConfig, engine, angle, velocity,
+          tpl.compile(push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1,
+                                       true));  // Use default post template
+          push.clearTemplate();
+          values.setNeeded(tpl.getVariables());
+          setupTemplateEngineGravity(&myConfig, values, angle, velocity,
                                      gravitySG, corrGravitySG, tempC,
                                      (millis() - runtimeMillis) / 1000,
                                      myBatteryVoltage.getVoltage());
-          String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1,
-                                        true);  // Use default post template
-          String payload = engine.create(tpl.c_str());
+          String payload = tpl.render(values);
           myConfig.setTargetHttpPost(
               "http://192.168.4.1/post");  // Default URL for Gravitymon Gateway
                                            // v0.3+
@@ -411,20 +493,25 @@ bool loopReadGravity() {
         } else if (angleValid) {
           Log.notice(F("Main: Sending data to all defined push targets." CR));
 
-          TemplatingEngine engine;
+          TemplateValues values;
           BrewingPush push(&myConfig);
 
-          setupTemplateEngineGravity(&myConfig, engine, angle, velocity,
+          values.setNeeded(push.getTemplateVariables(
+              BrewingPush::MeasurementType::GRAVITY));
+          setupTemplateEngineGravity(&myConfig, values, angle, velocity,
                                      gravitySG, corrGravitySG, tempC,
                                      (millis() - runtimeMillis) / 1000,
                                      myBatteryVoltage.getVoltage());
-          push.sendAll(engine, BrewingPush::MeasurementType::GRAVITY);
+          push.sendAll(values, BrewingPush::MeasurementType::GRAVITY);
         }
       }
       PERF_END("loop-push");
 
-      // Send stats to influx after each push run.
+      // Send stats to influx after each push run. In measurement mode the
+      // push targets are completed in goToSleep()
       if (runMode == RunMode::configurationMode) {
+        myPushDispatcher.wait();
+        myPushScheduler.commit();
         PERF_PUSH();
       }
     }
@@ -432,6 +519,9 @@ bool loopReadGravity() {
   } else {
     // Log.error(F("MAIN: No gyro value found, the device might be moving."
     // CR));
+    if (runMode != RunMode::measurementMode)
+      myTelemetryWebSocket.send(false, myGyro.isSensorMoving(), 0, tempC, NAN,
+                                myBatteryVoltage.getVoltage());
   }
   return false;
 }
@@ -439,6 +529,10 @@ bool loopReadGravity() {
 // Wrapper for loopGravity that only calls every 200ms so that we dont overload
 // this.
 void loopGravityOnInterval() {
+  // A calibration, scan or push test started from the web ui uses the i2c bus
+  // and the push targets, wait until it is done
+  if (myWebServer.isTaskBusy()) return;
+
   if (timerLoop.hasExpired()) {
     loopReadGravity();
     timerLoop.reset();
@@ -447,10 +541,119 @@ void loopGravityOnInterval() {
     myGyro.read();
     PERF_END("loop-gyro-read");
     myBatteryVoltage.read();
+    myWebServer.setStatusStale();
 
     if (runMode != RunMode::wifiSetupMode)
-      checkSleepMode(myGyro.getAngle(), myBatteryVoltage.getVoltage());
+      checkSleepMode(myGyro.getAngle(), myBatteryVoltage.getRawVoltage());
+  }
+}
+
+// Returns the current time, the clock is synced when the queue is pushed so
+// the measurements get a timestamp. Returns 0 if the time is not known.
+time_t syncClock() {
+  time_t now = time(nullptr);
+
+  if (now < 1600000000) {
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+
+    uint32_t start = millis();
+    while ((now = time(nullptr)) < 1600000000 && (millis() - start) < 2000)
+      delay(50);
   }
+
+  return now < 1600000000 ? 0 : now;
+}
+
+static_assert(QUEUE_TARGETS == PUSH_TARGETS, "Queue needs a count per target");
+
+// Push the queued measurements, oldest first, in batches. Each target
+// continues from the records it has already accepted, and records are removed
+// when all targets have them. A target that fails is retried on the next push
+// while the others continue.
+bool pushQueuedMeasurements() {
+  PERF_BEGIN("loop-push-queue");
+  MeasurementRecord records[QUEUE_BATCH_SIZE];
+  time_t now = syncClock();
+  uint32_t clock = myPushScheduler.getDeviceClock();
+  int total = myMeasurementQueue.getCount();
+  BrewingPush push(&myConfig);
+  uint8_t targets = push.getBatchTargets();
+  uint8_t failed = 0;
+
+  Log.notice(F("Main: Pushing %d queued measurements." CR), total);
+
+  // Targets that are not due skip these measurements, the same as when each
+  // measurement is pushed on its own wake
+  for (int i = 0; i < QUEUE_TARGETS; i++)
+    if (!((targets >> i) & 1)) myMeasurementQueue.setSent(i, total);
+
+  while (true) {
+    int offset = total;
+    uint8_t batch = 0;
+
+    for (int i = 0; i < QUEUE_TARGETS; i++) {
+      if ((((targets & ~failed) >> i) & 1) &&
+          myMeasurementQueue.getSent(i) < offset)
+        offset = myMeasurementQueue.getSent(i);
+    }
+
+    if (offset >= total) break;
+
+    int n = myMeasurementQueue.read(&records[0], QUEUE_BATCH_SIZE, offset);
+    if (!n) break;
+
+    for (int i = 0; i < QUEUE_TARGETS; i++) {
+      if ((((targets & ~failed) >> i) & 1) &&
+          myMeasurementQueue.getSent(i) == offset)
+        batch |= 1 << i;
+    }
+
+    uint8_t success = push.sendBatch(
+        BrewingPush::MeasurementType::GRAVITY, n, batch,
+        [&](int i, TemplateValues& values) {
+          const MeasurementRecord& r = records[i];
+          setupTemplateEngineGravity(&myConfig, values, r.getAngle(),
+                                     r.getVelocity(), r.getGravity(),
+                                     r.getCorrGravity(), r.getTempC(), 0,
+                                     r.getBattery());
+
+          if (now)
+            values.setVal(TPL_TIMESTAMP,
+                          static_cast<int>(now - (clock - r.time)));
+        });
+
+    for (int i = 0; i < QUEUE_TARGETS; i++) {
+      if (!((batch >> i) & 1)) continue;
+
+      if ((success >> i) & 1)
+        myMeasurementQueue.setSent(i, offset + n);
+      else
+        failed |= 1 << i;
+    }
+  }
+
+  for (int i = 0; i < QUEUE_TARGETS; i++)
+    if (((targets & ~failed) >> i) & 1) myPushScheduler.setDone(i);
+  myPushScheduler.save();
+
+  int done = total;
+  for (int i = 0; i < QUEUE_TARGETS; i++)
+    if (myMeasurementQueue.getSent(i) < done)
+      done = myMeasurementQueue.getSent(i);
+
+  myMeasurementQueue.remove(done);
+
+  if (myMeasurementQueue.getCount() == 0)
+    myMeasurementQueue.clear();
+  else
+    myMeasurementQueue.saveSent();
+
+  if (failed)
+    Log.warning(F("Main: Failed to push queued measurements, %d left." CR),
+                myMeasurementQueue.getCount());
+
+  PERF_END("loop-push-queue");
+  return !failed;
 }
 
 void goToSleep(int sleepInterval) {
@@ -462,21 +665,45 @@ void goToSleep(int sleepInterval) {
              sleepInterval,
              reduceFloatPrecision(runtime / 1000, DECIMALS_RUNTIME), volt);
   myGyro.enterSleep();
+  myPushDispatcher.wait();  // Background push requests must complete first
+  myPushScheduler.commit();
   PERF_END("run-time");
   PERF_PUSH();
 
-  if (myConfig.isBatterySaving() &&
-      getBatteryPercentage(volt, BatteryType::LithiumIon) < 30) {
-    sleepInterval = 3600;
+  float percent = getBatteryPercentage(volt, myConfig.getBatteryType());
+  BatteryEstimator estimator(&myConfig, &myBatteryEstimatorData);
+
+  if (myConfig.isBatterySaving() && percent < BATTERY_SAVING_PERCENT) {
+    // Stretch the interval so the remaining charge lasts a reasonable time
+    sleepInterval = estimator.getBatterySavingInterval(
+        percent, myConfig.getSleepInterval());
     Log.notice(F("MAIN: Battery saving is enabled, sleeping for %ds." CR),
                sleepInterval);
   }
 
+  uint32_t radio = bleRadioMillis;
+  if (wifiStartMillis) radio += millis() - wifiStartMillis;
+
+#if defined(ENABLE_BLE)
+  Log.notice(F("MAIN: Radio on for %dms, BLE advertising %dms." CR), radio,
+             myBleSender.getRadioTime());
+#else
+  Log.notice(F("MAIN: Radio on for %dms." CR), radio);
+#endif
+
+  estimator.addWake(runtime / 1000, static_cast<float>(radio) / 1000,
+                    sleepInterval, percent);
+  Log.notice(F("MAIN: Battery level %F, estimated %F days remaining." CR),
+             percent, estimator.getRemainingDays(percent, sleepInterval));
+
+  myPushScheduler.advanceDeviceClock(runtime / 1000 + sleepInterval);
+  myMeasurementQueue.save();
+
   myWifi.stopDoubleReset();  // Ensure we dont go into wifi mode when wakeup
   LittleFS.end();
   ledOff();
   delay(100);
-  uint32_t wake = sleepInterval * 1000000;
+  uint64_t wake = sleepInterval * 1000000ULL;  // Overflows 32 bits at 71min
   ESP.deepSleep(wake);
 }
 
@@ -489,20 +716,27 @@ void loop() {
     case RunMode::wifiSetupMode:
     case RunMode::configurationMode:
       myWebServer.loop();
+      myTelemetryWebSocket.loop();
       myWifi.loop();
       loopGravityOnInterval();
       delay(1);
       break;
 
     case RunMode::measurementMode:
-      // If we didnt get a wifi connection, we enter sleep for a short time to
-      // conserve battery.
-      if (!myWifi.isConnected() &&
-          myConfig.isWifiPushActive()) {  // no connection to wifi and we have
-                                          // defined push targets.
-        Log.notice(
-            F("MAIN: No connection to wifi established, sleeping for 60s." CR));
-        goToSleep(60);
+      // If we didnt get a wifi connection the measurement is queued and
+      // pushed when the connection works again.
+      if (!myWifi.isConnected() && myConfig.isWifiPushActive() &&
+          !pushDeferred) {  // no connection to wifi and we have defined push
+                            // targets.
+        if (myConfig.isWifiDirect()) {
+          Log.notice(F(
+              "MAIN: No connection to wifi established, sleeping for 60s." CR));
+          goToSleep(60);
+        }
+
+        Log.notice(F("MAIN: No connection to wifi established, queueing the "
+                     "measurement." CR));
+        pushDeferred = true;
       }
 
       if (loopReadGravity()) {
@@ -0,0 +1,301 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <LittleFS.h>
+
+#include <log.hpp>
+#include <measurementqueue.hpp>
+#include <memory>
+#include <new>
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+RTC_DATA_ATTR MeasurementQueueData myMeasurementQueueData = {0};
+#else
+MeasurementQueueData myMeasurementQueueData = {0};
+#endif
+
+MeasurementQueue myMeasurementQueue(&myMeasurementQueueData, QUEUE_FILENAME,
+                                    true);
+
+static constexpr auto recordSize = sizeof(MeasurementRecord);
+static constexpr auto ringSize = QUEUE_RTC_SIZE ? QUEUE_RTC_SIZE : 1;
+
+#if defined(ESP8266)
+// Only the header is kept in RTC user memory, the records are in the file
+struct MeasurementQueueRtc {
+  uint32_t Checksum;
+  uint8_t Header[offsetof(MeasurementQueueData, Records)];
+};
+
+static_assert(sizeof(MeasurementQueueRtc) <= 512 - QUEUE_RTC_OFFSET * 4,
+              "Queue header does not fit in RTC user memory");
+
+static uint32_t getHeaderChecksum(const uint8_t* p, size_t len) {
+  uint32_t sum = QUEUE_RTC_DATA_AVAILABLE;
+
+  for (size_t i = 0; i < len; i++) sum = (sum << 1 | sum >> 31) ^ p[i];
+
+  return sum;
+}
+#endif
+
+MeasurementQueue::MeasurementQueue(MeasurementQueueData* data,
+                                   const char* fileName, bool rtcUser)
+    : _data(data), _fileName(fileName), _rtcUser(rtcUser) {
+#if defined(ESP8266)
+  if (_rtcUser) {
+    MeasurementQueueRtc rtc;
+
+    ESP.rtcUserMemoryRead(QUEUE_RTC_OFFSET, reinterpret_cast<uint32_t*>(&rtc),
+                          sizeof(rtc));
+    if (rtc.Checksum == getHeaderChecksum(rtc.Header, sizeof(rtc.Header)))
+      memcpy(_data, rtc.Header, sizeof(rtc.Header));
+  }
+#endif
+
+  if (_data->IsDataAvailable != QUEUE_RTC_DATA_AVAILABLE) {
+    memset(_data, 0, sizeof(MeasurementQueueData));
+    _data->IsDataAvailable = QUEUE_RTC_DATA_AVAILABLE;
+  }
+}
+
+void MeasurementQueue::save() {
+#if defined(ESP8266)
+  if (!_rtcUser) return;
+
+  MeasurementQueueRtc rtc;
+
+  memcpy(rtc.Header, _data, sizeof(rtc.Header));
+  rtc.Checksum = getHeaderChecksum(rtc.Header, sizeof(rtc.Header));
+  ESP.rtcUserMemoryWrite(QUEUE_RTC_OFFSET, reinterpret_cast<uint32_t*>(&rtc),
+                         sizeof(rtc));
+#endif
+}
+
+int MeasurementQueue::getFileCount() const {
+  if (!_fileName || !LittleFS.exists(_fileName)) return 0;
+
+  File file = LittleFS.open(_fileName, "r");
+  if (!file) return 0;
+
+  int count = file.size() / recordSize;
+  file.close();
+  return count;
+}
+
+// Keep the newest records in the file, the others are dropped
+static bool trimFile(const char* fileName, int keep) {
+  File file = LittleFS.open(fileName, "r");
+  if (!file) return false;
+
+  int count = file.size() / recordSize;
+  keep = keep < count ? keep : count;
+
+  std::unique_ptr<MeasurementRecord[]> buf(new (std::nothrow)
+                                               MeasurementRecord[keep + 1]);
+  if (!buf) {
+    file.close();
+    return false;
+  }
+
+  file.seek((count - keep) * recordSize);
+  int read = file.read(reinterpret_cast<uint8_t*>(buf.get()),
+                       keep * recordSize) /
+             recordSize;
+  file.close();
+
+  file = LittleFS.open(fileName, "w");
+  if (!file) return false;
+
+  file.write(reinterpret_cast<const uint8_t*>(buf.get()), read * recordSize);
+  file.close();
+  return true;
+}
+
+// Returns the number of oldest records dropped to keep the file size
+static int appendFile(const char* fileName, const MeasurementRecord* r,
+                      int count) {
+  if (!fileName) {
+    Log.warning(F("QUE : No queue file, dropping %d records." CR), count);
+    return 0;
+  }
+
+  File file = LittleFS.open(fileName, "a");
+  if (!file) {
+    Log.error(F("QUE : Failed to open %s, dropping %d records." CR), fileName,
+              count);
+    return 0;
+  }
+
+  file.write(reinterpret_cast<const uint8_t*>(r), count * recordSize);
+  int total = file.size() / recordSize;
+  file.close();
+
+  if (total > QUEUE_FILE_SIZE) {
+    Log.warning(F("QUE : Queue file is full, dropping %d oldest records." CR),
+                total - QUEUE_FILE_SIZE);
+    trimFile(fileName, QUEUE_FILE_SIZE);
+    return total - QUEUE_FILE_SIZE;
+  }
+
+  return 0;
+}
+
+void MeasurementQueue::spill(int count) {
+  MeasurementRecord buf[QUEUE_RTC_SIZE ? QUEUE_RTC_SIZE : 1];
+
+  count = count < _data->Count ? count : _data->Count;
+
+  for (int i = 0; i < count; i++)
+    buf[i] = _data->Records[(_data->Head + i) % ringSize];
+
+  dropSent(appendFile(_fileName, &buf[0], count));
+  _data->Head = (_data->Head + count) % ringSize;
+  _data->Count -= count;
+}
+
+void MeasurementQueue::add(const MeasurementRecord& r) {
+  if (QUEUE_RTC_SIZE == 0) {
+    dropSent(appendFile(_fileName, &r, 1));
+    return;
+  }
+
+  // Move the older half to flash so the file is not written on every wake
+  if (_data->Count >= QUEUE_RTC_SIZE) spill(QUEUE_RTC_SIZE / 2);
+
+  _data->Records[(_data->Head + _data->Count) % ringSize] = r;
+  _data->Count++;
+}
+
+int MeasurementQueue::read(MeasurementRecord* records, int max,
+                           int offset) const {
+  int n = 0;
+  int fileCount = getFileCount();
+
+  // The file holds the oldest records
+  if (offset < fileCount) {
+    File file = LittleFS.open(_fileName, "r");
+    if (!file) return 0;
+
+    int count = fileCount - offset < max ? fileCount - offset : max;
+    file.seek(offset * recordSize);
+    n = file.read(reinterpret_cast<uint8_t*>(records), count * recordSize) /
+        recordSize;
+    file.close();
+    offset = 0;
+  } else {
+    offset -= fileCount;
+  }
+
+  for (int i = offset; i < _data->Count && n < max; i++)
+    records[n++] = _data->Records[(_data->Head + i) % ringSize];
+
+  return n;
+}
+
+void MeasurementQueue::dropSent(int count) {
+  if (!count) return;
+
+  for (int i = 0; i < QUEUE_TARGETS; i++)
+    setSent(i, getSent(i) > count ? getSent(i) - count : 0);
+}
+
+void MeasurementQueue::remove(int count) {
+  int fileCount = getFileCount();
+
+  dropSent(count);
+
+  if (fileCount > 0) {
+    if (count >= fileCount)
+      LittleFS.remove(_fileName);
+    else
+      trimFile(_fileName, fileCount - count);
+
+    count -= fileCount;
+  }
+
+  if (count <= 0) return;
+
+  count = count < _data->Count ? count : _data->Count;
+  _data->Head = (_data->Head + count) % ringSize;
+  _data->Count -= count;
+}
+
+void MeasurementQueue::clear() {
+  if (getFileCount() > 0) LittleFS.remove(_fileName);
+
+  _data->Head = 0;
+  _data->Count = 0;
+  _data->Wakes = 0;
+  memset(&_data->Sent[0], 0, sizeof(_data->Sent));
+  saveSent();
+}
+
+void MeasurementQueue::loadSent() {
+  if (QUEUE_RTC_SIZE || _sentLoaded) return;
+
+  _sentLoaded = true;
+  File file = LittleFS.open(QUEUE_SENT_FILENAME, "r");
+
+  if (file) {
+    file.read(reinterpret_cast<uint8_t*>(&_data->Sent[0]),
+              sizeof(_data->Sent));
+    file.close();
+  }
+}
+
+int MeasurementQueue::getSent(int target) {
+  loadSent();
+  return _data->Sent[target];
+}
+
+void MeasurementQueue::setSent(int target, int count) {
+  loadSent();
+  _data->Sent[target] = count;
+}
+
+void MeasurementQueue::saveSent() {
+  if (QUEUE_RTC_SIZE) return;
+
+  loadSent();
+  bool empty = true;
+
+  for (int i = 0; i < QUEUE_TARGETS; i++)
+    if (_data->Sent[i]) empty = false;
+
+  // Only written after a target has failed, normally the file does not exist
+  if (empty) {
+    if (LittleFS.exists(QUEUE_SENT_FILENAME))
+      LittleFS.remove(QUEUE_SENT_FILENAME);
+    return;
+  }
+
+  File file = LittleFS.open(QUEUE_SENT_FILENAME, "w");
+  if (!file) return;
+
+  file.write(reinterpret_cast<const uint8_t*>(&_data->Sent[0]),
+             sizeof(_data->Sent));
+  file.close();
+}
+
+// EOF
@@ -0,0 +1,161 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_MEASUREMENTQUEUE_HPP_
+#define SRC_MEASUREMENTQUEUE_HPP_
+
+#include <Arduino.h>
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+#include <esp_attr.h>
+constexpr auto QUEUE_RTC_SIZE = 32;  // Records kept in RTC memory
+#else
+constexpr auto QUEUE_RTC_SIZE = 0;  // No RTC memory, records go to the file
+#endif
+
+constexpr auto QUEUE_FILE_SIZE = 256;  // Records kept in the file
+constexpr auto QUEUE_BATCH_SIZE = 16;  // Records per push request
+constexpr auto QUEUE_FILENAME = "/queue.dat";
+
+#define QUEUE_RTC_DATA_AVAILABLE \
+  static_cast<uint8_t>(112)  // Unique number to flag resume data is available
+constexpr auto QUEUE_RTC_OFFSET = 118;  // Blocks of 4 bytes, ESP8266
+
+constexpr auto QUEUE_TARGETS = 5;  // Same as PUSH_TARGETS
+constexpr auto QUEUE_SENT_FILENAME = "/queue.sent";
+constexpr int16_t QUEUE_NAN_INT16 = INT16_MIN;  // Stored for NaN
+constexpr uint16_t QUEUE_NAN_UINT16 = UINT16_MAX;
+
+// Scaled and clamped to the field, NaN is stored as the sentinel
+inline int16_t toQueueInt16(float v, float scale) {
+  if (isnan(v)) return QUEUE_NAN_INT16;
+  v = roundf(v * scale);
+  return static_cast<int16_t>(v < -32767 ? -32767 : v > 32767 ? 32767 : v);
+}
+
+inline uint16_t toQueueUint16(float v, float scale) {
+  if (isnan(v)) return QUEUE_NAN_UINT16;
+  v = roundf(v * scale);
+  return static_cast<uint16_t>(v < 0 ? 0 : v > 65534 ? 65534 : v);
+}
+
+inline float fromQueueInt16(int16_t v, float scale) {
+  return v == QUEUE_NAN_INT16 ? NAN : v / scale;
+}
+
+inline float fromQueueUint16(uint16_t v, float scale) {
+  return v == QUEUE_NAN_UINT16 ? NAN : v / scale;
+}
+
+// Compact measurement, 16 bytes. Values outside the range of a field are
+// clamped and NaN is stored as the lowest (signed) or highest value.
+struct MeasurementRecord {
+  uint32_t time;         // s, device clock, see PushScheduler::getDeviceClock()
+  int16_t angle;         // degrees * 100
+  int16_t tempC;         // C * 100
+  uint16_t gravity;      // SG * 10000
+  uint16_t corrGravity;  // SG * 10000
+  int16_t velocity;      // SG points per day * 100
+  uint16_t battery;      // mV
+
+  void set(uint32_t t, float a, float c, float g, float cg, float v, float b) {
+    time = t;
+    angle = toQueueInt16(a, 100);
+    tempC = toQueueInt16(c, 100);
+    gravity = toQueueUint16(g, 10000);
+    corrGravity = toQueueUint16(cg, 10000);
+    velocity = toQueueInt16(v, 100);
+    battery = toQueueUint16(b, 1000);
+  }
+
+  float getAngle() const { return fromQueueInt16(angle, 100); }
+  float getTempC() const { return fromQueueInt16(tempC, 100); }
+  float getGravity() const { return fromQueueUint16(gravity, 10000); }
+  float getCorrGravity() const { return fromQueueUint16(corrGravity, 10000); }
+  float getVelocity() const { return fromQueueInt16(velocity, 100); }
+  float getBattery() const { return fromQueueUint16(battery, 1000); }
+};
+
+// Ring of the newest records, kept in RTC memory when available
+struct MeasurementQueueData {
+  uint8_t IsDataAvailable;
+  uint8_t Head;   // Index of the oldest record
+  uint8_t Count;  // Records in the ring
+  uint16_t Wakes;
+  uint16_t Sent[QUEUE_TARGETS];  // Oldest records accepted by each target
+  MeasurementRecord Records[QUEUE_RTC_SIZE ? QUEUE_RTC_SIZE : 1];
+};
+
+extern MeasurementQueueData myMeasurementQueueData;
+
+// Measurements waiting to be pushed. The ring in RTC memory spills the oldest
+// records to a file when full, without RTC memory all records are written to
+// the file. Records are read oldest first.
+class MeasurementQueue {
+ private:
+  MeasurementQueueData* _data;
+  const char* _fileName;
+  bool _rtcUser;
+
+  bool _sentLoaded = false;
+
+  void spill(int count);
+  int getFileCount() const;
+  void loadSent();
+  void dropSent(int count);
+
+ public:
+  // With rtcUser the header (wakes, counts) is restored from RTC user memory
+  // on ESP8266, where the data itself can not be placed in RTC memory
+  MeasurementQueue(MeasurementQueueData* data, const char* fileName,
+                   bool rtcUser = false);
+
+  // Wakes since the last upload, used for pushing every N wakes
+  int getWakes() const { return _data->Wakes; }
+  void addWake() {
+    if (_data->Wakes < 0xffff) _data->Wakes++;
+  }
+
+  // Records are only removed when all targets have accepted them, the count
+  // per target avoids sending them again to the targets that already have.
+  // Without RTC memory the counts are kept in a file while they are not 0.
+  int getSent(int target);
+  void setSent(int target, int count);
+  void saveSent();
+
+  // Writes the header to RTC user memory before deep sleep, only needed on
+  // ESP8266
+  void save();
+
+  void add(const MeasurementRecord& r);
+  int getCount() const { return _data->Count + getFileCount(); }
+  int read(MeasurementRecord* records, int max, int offset = 0) const;
+  void remove(int count);
+  void clear();
+};
+
+extern MeasurementQueue myMeasurementQueue;
+
+#endif  // SRC_MEASUREMENTQUEUE_HPP_
+
+// EOF
@@ -0,0 +1,244 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <bleencoder.hpp>
+#include <lineprotocol.hpp>
+#include <payloadencoder.hpp>
+#include <pushtarget.hpp>
+
+struct PayloadField {
+  const char* name;
+  const char* variable;
+};
+
+// Same names as the default http post templates
+static const PayloadField gravityFields[] = {
+    {"name", TPL_MDNS},
+    {"ID", TPL_ID},
+    {"token", TPL_TOKEN},
+    {"interval", TPL_SLEEP_INTERVAL},
+    {"temperature", TPL_TEMP},
+    {"temp_units", TPL_TEMP_UNITS},
+    {"gravity", TPL_GRAVITY},
+    {"velocity", TPL_VELOCITY},
+    {"angle", TPL_ANGLE},
+    {"battery", TPL_BATTERY},
+    {"RSSI", TPL_RSSI},
+    {"corr-gravity", TPL_GRAVITY_CORR},
+    {"gravity-unit", TPL_GRAVITY_UNIT},
+    {"run-time", TPL_RUN_TIME},
+};
+
+static const PayloadField pressureFields[] = {
+    {"name", TPL_MDNS},
+    {"id", TPL_ID},
+    {"token", TPL_TOKEN},
+    {"interval", TPL_SLEEP_INTERVAL},
+    {"temperature", TPL_TEMP},
+    {"temperature-unit", TPL_TEMP_UNITS},
+    {"pressure", TPL_PRESSURE},
+    {"pressure-unit", TPL_PRESSURE_UNIT},
+    {"battery", TPL_BATTERY},
+    {"rssi", TPL_RSSI},
+    {"run-time", TPL_RUN_TIME},
+};
+
+// Variables used by the gravitymon BLE layout
+static const char* const binaryVariables[] = {TPL_BATTERY, TPL_TEMP_C,
+                                              TPL_GRAVITY_G, TPL_ANGLE, TPL_ID};
+
+void MsgPackWriter::writeMap(uint8_t count) {
+  if (count < 16) {
+    put(0x80 | count);
+  } else {
+    put(0xde);
+    put16(count);
+  }
+}
+
+void MsgPackWriter::writeArray(uint16_t count) {
+  if (count < 16) {
+    put(0x90 | count);
+  } else {
+    put(0xdc);
+    put16(count);
+  }
+}
+
+void MsgPackWriter::writeString(const char* s, size_t length) {
+  if (length < 32) {
+    put(0xa0 | length);
+  } else if (length < 256) {
+    put(0xd9);
+    put(length);
+  } else {
+    put(0xda);
+    put16(length);
+  }
+
+  for (size_t i = 0; i < length; i++) put(s[i]);
+}
+
+void MsgPackWriter::writeInt(int32_t v) {
+  if (v >= 0 && v < 128) {
+    put(v);
+  } else if (v < 0 && v >= -32) {
+    put(static_cast<uint8_t>(v));
+  } else if (v >= -32768 && v < 32768) {
+    put(0xd1);
+    put16(static_cast<uint16_t>(v));
+  } else {
+    put(0xd2);
+    put32(static_cast<uint32_t>(v));
+  }
+}
+
+void MsgPackWriter::writeFloat(float v) {
+  union {
+    float f;
+    uint32_t u;
+  } floatUnion;
+
+  floatUnion.f = v;
+  put(0xca);
+  put32(floatUnion.u);
+}
+
+static void writeValue(MsgPackWriter& w, const TemplateValues& values,
+                       int id) {
+  switch (values.getType(id)) {
+    case TEMPLATE_VALUE_INT:
+      w.writeInt(values.getInt(id));
+      break;
+    case TEMPLATE_VALUE_FLOAT: {
+      // Rounded like the text format so both give the same value
+      float scale = powf(10, values.getDecimals(id));
+      w.writeFloat(roundf(values.getFloat(id) * scale) / scale);
+    } break;
+    case TEMPLATE_VALUE_STRING:
+    case TEMPLATE_VALUE_CHAR:
+      w.writeString(values.getVal(id), values.getLength(id));
+      break;
+    default:
+      w.writeNil();
+      break;
+  }
+}
+
+size_t encodeMsgPack(const TemplateValues& values, bool pressure, uint8_t* buf,
+                     size_t size) {
+  const PayloadField* fields =
+      pressure ? &pressureFields[0] : &gravityFields[0];
+  int count = pressure ? sizeof(pressureFields) / sizeof(PayloadField)
+                       : sizeof(gravityFields) / sizeof(PayloadField);
+  MsgPackWriter w(buf, size);
+
+  w.writeMap(count);
+
+  for (int i = 0; i < count; i++) {
+    w.writeString(fields[i].name);
+    writeValue(w, values, getTemplateVariableId(fields[i].variable));
+  }
+
+  return w.getLength();
+}
+
+static uint16_t getScaled(const TemplateValues& values, const char* key,
+                          float scale) {
+  int id = getTemplateVariableId(key);
+
+  if (!values.hasVal(id)) return 0xffff;
+  return static_cast<uint16_t>(
+      static_cast<int32_t>(roundf(values.getFloat(id) * scale)));
+}
+
+size_t encodeBinary(const TemplateValues& values, uint8_t* buf, size_t size) {
+  if (size < PAYLOAD_BINARY_SIZE) return 0;
+
+  uint16_t b = getScaled(values, TPL_BATTERY, 1000);
+  uint16_t t = getScaled(values, TPL_TEMP_C, 1000);
+  uint16_t g = getScaled(values, TPL_GRAVITY_G, 10000);
+  uint16_t a = getScaled(values, TPL_ANGLE, 100);
+  int id = getTemplateVariableId(TPL_ID);
+  uint32_t chipId = values.hasVal(id) ? strtoul(values.getVal(id), NULL, 16)
+                                      : 0;
+
+  BleEddystoneFrame* f = reinterpret_cast<BleEddystoneFrame*>(buf);
+
+  f->type = 0x20;  // Eddystone Frame Type (Unencrypted Eddystone-TLM)
+  f->version = 0x00;
+  f->battery.set(b);
+  f->temp.set(t);
+  f->gravity.set(g);
+  f->angle.set(a);
+  f->chipId.set(chipId);
+  return PAYLOAD_BINARY_SIZE;
+}
+
+uint64_t getEncodingVariables(PushEncoding encoding, bool pressure) {
+  uint64_t mask = 0;
+
+  auto add = [&mask](const char* key) {
+    int id = getTemplateVariableId(key);
+    if (id >= 0) mask |= static_cast<uint64_t>(1) << id;
+  };
+
+  switch (encoding) {
+    case PUSH_ENCODING_MSGPACK:
+      if (pressure) {
+        for (const PayloadField& f : pressureFields) add(f.variable);
+      } else {
+        for (const PayloadField& f : gravityFields) add(f.variable);
+      }
+      break;
+    case PUSH_ENCODING_BINARY:
+      for (const char* v : binaryVariables) add(v);
+      break;
+    case PUSH_ENCODING_LINE_PROTOCOL:
+      mask = getLineProtocolVariables(pressure);
+      break;
+    default:
+      break;
+  }
+
+  return mask;
+}
+
+const char* getEncodingContentType(PushEncoding encoding) {
+  switch (encoding) {
+    case PUSH_ENCODING_MSGPACK:
+      return "application/msgpack";
+    case PUSH_ENCODING_BINARY:
+      return "application/octet-stream";
+    case PUSH_ENCODING_LINE_PROTOCOL:
+      return "text/plain";
+    default:
+      return "application/json";
+  }
+}
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
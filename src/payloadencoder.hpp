@@ -0,0 +1,86 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_PAYLOADENCODER_HPP_
+#define SRC_PAYLOADENCODER_HPP_
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <Arduino.h>
+
+#include <config_brewing.hpp>
+#include <templatecompiler.hpp>
+
+constexpr auto PAYLOAD_BUFFER_SIZE = 384;
+constexpr auto PAYLOAD_BINARY_SIZE = 14;
+
+// Writes MessagePack into a fixed buffer, the length is 0 if it did not fit
+class MsgPackWriter {
+ private:
+  uint8_t* _buf;
+  size_t _size;
+  size_t _length = 0;
+  bool _overflow = false;
+
+  void put(uint8_t b) {
+    if (_length < _size)
+      _buf[_length++] = b;
+    else
+      _overflow = true;
+  }
+  void put16(uint16_t v) {
+    put(v >> 8);
+    put(v & 0xff);
+  }
+  void put32(uint32_t v) {
+    put16(v >> 16);
+    put16(v & 0xffff);
+  }
+
+ public:
+  MsgPackWriter(uint8_t* buf, size_t size) : _buf(buf), _size(size) {}
+
+  void writeMap(uint8_t count);
+  void writeArray(uint16_t count);
+  void writeString(const char* s, size_t length);
+  void writeString(const char* s) { writeString(s, strlen(s)); }
+  void writeInt(int32_t v);
+  void writeFloat(float v);
+  void writeNil() { put(0xc0); }
+
+  size_t getLength() const { return _overflow ? 0 : _length; }
+};
+
+// Compact bodies for the http post targets. The fields are taken from the
+// same values as the templates so both are always in sync.
+size_t encodeMsgPack(const TemplateValues& values, bool pressure, uint8_t* buf,
+                     size_t size);
+size_t encodeBinary(const TemplateValues& values, uint8_t* buf, size_t size);
+uint64_t getEncodingVariables(PushEncoding encoding, bool pressure);
+const char* getEncodingContentType(PushEncoding encoding);
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+#endif  // SRC_PAYLOADENCODER_HPP_
+
+// EOF
@@ -27,6 +27,7 @@
 #include <main.hpp>
 #include <push_gravitymon.hpp>
 #include <pushtarget.hpp>
+#include <tempsensor.hpp>
 
 #if defined(ESP8266)
 #include <ESP8266WiFi.h>
@@ -34,9 +35,18 @@
 #include <WiFi.h>
 #endif
 
-void setupTemplateEngineGravity(GravitymonConfig* config,
-                                TemplatingEngine& engine, float angle,
-                                float velocity, float gravitySG,
+// The templating engine has no knowledge of the template so all values are
+// needed, the compiled templates only need what the active templates use.
+static bool isNeeded(const TemplatingEngine&, const char*) { return true; }
+static bool isNeeded(const TemplateValues& values, const char* key) {
+  return values.isNeeded(key);
+}
+
+// Shared by the templating engine and the compiled templates since both use
+// the same setVal() interface.
+template <class Engine>
+void setupTemplateValuesGravity(GravitymonConfig* config, Engine& engine,
+                                float angle, float velocity, float gravitySG,
                                 float corrGravitySG, float tempC, float runTime,
                                 float voltage) {
   // Names
@@ -56,16 +66,39 @@ void setupTemplateEngineGravity(GravitymonConfig* config,
   engine.setVal(TPL_TEMP_F, convertCtoF(tempC), DECIMALS_TEMP);
   engine.setVal(TPL_TEMP_UNITS, config->getTempFormat());
 
+  const char* probes[TEMP_MAX_SENSORS] = {TPL_TEMP1, TPL_TEMP2, TPL_TEMP3,
+                                          TPL_TEMP4};
+
+  for (int i = 0; i < TEMP_MAX_SENSORS; i++) {
+    if (!isNeeded(engine, probes[i])) continue;
+
+    float probeC = myTempSensor.getProbeTempC(i);
+    engine.setVal(probes[i],
+                  config->isTempFormatC() ? probeC : convertCtoF(probeC),
+                  DECIMALS_TEMP);
+  }
+
   // Battery & Timer
   engine.setVal(TPL_BATTERY, voltage, DECIMALS_BATTERY);
   engine.setVal(TPL_SLEEP_INTERVAL, config->getSleepInterval());
 
-  engine.setVal(TPL_BATTERY_PERCENT,
-                getBatteryPercentage(voltage, BatteryType::LithiumIon));
+  if (isNeeded(engine, TPL_BATTERY_PERCENT) ||
+      isNeeded(engine, TPL_BATTERY_DAYS)) {
+    float percent = getBatteryPercentage(voltage, config->getBatteryType());
+    // Whole percent, same as the engine rendered the float before
+    engine.setVal(TPL_BATTERY_PERCENT, static_cast<int>(percent));
+
+    if (isNeeded(engine, TPL_BATTERY_DAYS)) {
+      BatteryEstimator estimator(config, &myBatteryEstimatorData);
+      engine.setVal(
+          TPL_BATTERY_DAYS,
+          estimator.getRemainingDays(percent, config->getSleepInterval()), 1);
+    }
+  }
 
   // Performance metrics
   engine.setVal(TPL_RUN_TIME, runTime, DECIMALS_RUNTIME);
-  engine.setVal(TPL_RSSI, WiFi.RSSI());
+  if (isNeeded(engine, TPL_RSSI)) engine.setVal(TPL_RSSI, WiFi.RSSI());
 
   // Angle/Tilt
   engine.setVal(TPL_TILT, angle, DECIMALS_TILT);
@@ -93,6 +126,24 @@ void setupTemplateEngineGravity(GravitymonConfig* config,
   engine.setVal(TPL_APP_BUILD, CFG_GITREV);
 }
 
+void setupTemplateEngineGravity(GravitymonConfig* config,
+                                TemplatingEngine& engine, float angle,
+                                float velocity, float gravitySG,
+                                float corrGravitySG, float tempC, float runTime,
+                                float voltage) {
+  setupTemplateValuesGravity(config, engine, angle, velocity, gravitySG,
+                             corrGravitySG, tempC, runTime, voltage);
+}
+
+void setupTemplateEngineGravity(GravitymonConfig* config,
+                                TemplateValues& values, float angle,
+                                float velocity, float gravitySG,
+                                float corrGravitySG, float tempC, float runTime,
+                                float voltage) {
+  setupTemplateValuesGravity(config, values, angle, velocity, gravitySG,
+                             corrGravitySG, tempC, runTime, voltage);
+}
+
 #endif  // GRAVITYMON
 
 // EOF
@@ -27,6 +27,7 @@
 #if defined(GRAVITYMON)
 
 #include <config_gravitymon.hpp>
+#include <templatecompiler.hpp>
 #include <templating.hpp>
 
 void setupTemplateEngineGravity(GravitymonConfig* config,
@@ -34,6 +35,11 @@ void setupTemplateEngineGravity(GravitymonConfig* config,
                                 float velocity, float gravitySG,
                                 float corrGravitySG, float tempC, float runTime,
                                 float voltage);
+void setupTemplateEngineGravity(GravitymonConfig* config,
+                                TemplateValues& values, float angle,
+                                float velocity, float gravitySG,
+                                float corrGravitySG, float tempC, float runTime,
+                                float voltage);
 
 #endif  // GRAVITYMON
 
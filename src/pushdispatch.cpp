@@ -0,0 +1,567 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <gzip.hpp>
+#include <log.hpp>
+#include <new>
+#include <perf.hpp>
+#include <pushdispatch.hpp>
+
+PushDispatcher myPushDispatcher;
+
+// Same names as used for the sequential push in the perf data
+static const char* const pushPerfNames[PUSH_TARGETS] = {
+    "push-http", "push-http2", "push-http3", "push-influxdb2", "push-mqtt"};
+
+static const char* const pushTargetNames[PUSH_TARGETS] = {
+    "http_post", "http_post2", "http_get", "influxdb2", "mqtt"};
+
+AsyncPushRequest::~AsyncPushRequest() {
+  if (_client) {
+    // The abort can raise any of the callbacks, none may reach this object
+    _client->onConnect(nullptr, nullptr);
+    _client->onAck(nullptr, nullptr);
+    _client->onData(nullptr, nullptr);
+    _client->onError(nullptr, nullptr);
+    _client->onTimeout(nullptr, nullptr);
+    _client->onDisconnect(nullptr, nullptr);
+    _client->close(true);
+    delete _client;
+    _client = nullptr;
+  }
+}
+
+bool AsyncHttpRequest::parseUrl(const char* url, String& host, uint16_t& port,
+                                String& path) {
+  if (strncmp(url, "http://", 7)) return false;  // https is not supported
+
+  const char* h = url + 7;
+  const char* p = strchr(h, '/');
+  const char* q = strchr(h, '?');
+
+  if (!p || (q && q < p)) p = q;
+
+  String hostPort = p ? String(h).substring(0, p - h) : String(h);
+  path = p ? String(p) : String("/");
+  if (path.startsWith("?")) path = "/" + path;
+
+  int colon = hostPort.indexOf(':');
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = hostPort.substring(colon + 1).toInt();
+  } else {
+    host = hostPort;
+    port = 80;
+  }
+
+  return host.length() > 0 && port > 0;
+}
+
+bool AsyncHttpRequest::buildRequest(const char* method, const char* url,
+                                    const char* header1, const char* header2,
+                                    const char* contentType, size_t length,
+                                    bool gzip) {
+  String path;
+
+  if (!parseUrl(url, _host, _port, path)) return false;
+
+  _request.reserve(length + strlen(url) + 200);
+  _request = method;
+  _request += " " + path + " HTTP/1.1\r\nHost: " + _host;
+  if (_port != 80) _request += ":" + String(_port);
+  _request += "\r\nConnection: close\r\n";
+
+  for (const char* h : {header1, header2}) {
+    if (!strlen(h) || (contentType && !strncasecmp(h, "Content-Type:", 13)))
+      continue;
+    _request += String(h) + "\r\n";
+  }
+
+  if (contentType)
+    _request += String("Content-Type: ") + contentType + "\r\n";
+  if (gzip) _request += "Content-Encoding: gzip\r\n";
+  if (length) _request += "Content-Length: " + String(length) + "\r\n";
+  _request += "\r\n";
+  return true;
+}
+
+bool AsyncHttpRequest::begin(const char* method, const char* url,
+                             const char* header1, const char* header2,
+                             const String& body, uint32_t timeout,
+                             bool gzip) {
+  size_t length = 0;
+
+  if (gzip && body.length()) {
+    _compressed.reset(new (std::nothrow) uint8_t[body.length()]);
+
+    if (_compressed)
+      length = gzipCompress(reinterpret_cast<const uint8_t*>(body.c_str()),
+                            body.length(), _compressed.get(), body.length());
+    if (!length) _compressed.reset();
+
+#if LOG_LEVEL == 6
+    Log.verbose(F("PUSH: Gzip %d bytes to %d bytes." CR), body.length(),
+                length);
+#endif
+  }
+
+  if (!buildRequest(method, url, header1, header2, nullptr,
+                    length ? length : body.length(), length > 0))
+    return false;
+
+  if (length) {
+    _body = _compressed.get();
+    _bodyLength = length;
+  } else {
+    _request += body;
+  }
+
+  connect(timeout);
+  return true;
+}
+
+bool AsyncHttpRequest::begin(const char* method, const char* url,
+                             const char* header1, const char* header2,
+                             const char* contentType, const uint8_t* body,
+                             size_t length, uint32_t timeout) {
+  if (!buildRequest(method, url, header1, header2, contentType, length))
+    return false;
+
+  _body = body;
+  _bodyLength = length;
+  connect(timeout);
+  return true;
+}
+
+void AsyncPushRequest::connect(uint32_t timeout) {
+  _client = new AsyncClient();
+  _start = millis();
+  _timeout = timeout;
+
+  _client->onConnect(
+      [](void* arg, AsyncClient*) {
+        static_cast<AsyncPushRequest*>(arg)->sendPending();
+      },
+      this);
+  _client->onAck(
+      [](void* arg, AsyncClient*, size_t len, uint32_t) {
+        AsyncPushRequest* request = static_cast<AsyncPushRequest*>(arg);
+        request->_acked += len;
+        request->sendPending();
+        request->handleAck();
+      },
+      this);
+  _client->onData(
+      [](void* arg, AsyncClient*, void* data, size_t len) {
+        static_cast<AsyncPushRequest*>(arg)->handleData(
+            static_cast<const char*>(data), len);
+      },
+      this);
+  _client->onError(
+      [](void* arg, AsyncClient*, int8_t) {
+        static_cast<AsyncPushRequest*>(arg)->finish(
+            PUSH_ERROR_CONNECTION_FAILED);
+      },
+      this);
+  _client->onTimeout(
+      [](void* arg, AsyncClient*, uint32_t) {
+        static_cast<AsyncPushRequest*>(arg)->finish(PUSH_ERROR_READ_TIMEOUT);
+      },
+      this);
+  _client->onDisconnect(
+      [](void* arg, AsyncClient*) {
+        static_cast<AsyncPushRequest*>(arg)->finish(
+            PUSH_ERROR_CONNECTION_LOST);
+      },
+      this);
+
+  _client->setRxTimeout((timeout + 999) / 1000);
+
+  if (!_client->connect(_host.c_str(), _port))
+    finish(PUSH_ERROR_CONNECTION_FAILED);  // Reported as a failed target
+}
+
+void AsyncPushRequest::sendPending() {
+  size_t header = _request.length();
+
+  while (_sent < header + _bodyLength && _client->space()) {
+    const char* p = _sent < header
+                        ? _request.c_str() + _sent
+                        : reinterpret_cast<const char*>(_body) + _sent - header;
+    size_t left =
+        _sent < header ? header - _sent : header + _bodyLength - _sent;
+    size_t n = min(left, _client->space());
+
+    _client->add(p, n);
+    _sent += n;
+  }
+
+  _client->send();
+}
+
+void AsyncHttpRequest::handleData(const char* data, size_t len) {
+  if (_done) return;
+
+  // Status line, "HTTP/1.1 200 OK"
+  for (size_t i = 0; i < len && _responseLength < sizeof(_response) - 1; i++)
+    _response[_responseLength++] = data[i];
+  _response[_responseLength] = 0;
+
+  if (_responseLength < 12) return;
+
+  const char* s = strchr(&_response[0], ' ');
+  finish(s ? atoi(s + 1) : PUSH_ERROR_CONNECTION_LOST);
+  _client->close();
+}
+
+// Remaining length of the fixed header, 1 to 4 bytes
+static size_t putMqttLength(uint8_t* buf, size_t length) {
+  size_t n = 0;
+
+  do {
+    uint8_t b = length % 128;
+    length /= 128;
+    if (length) b |= 0x80;
+    if (buf) buf[n] = b;
+    n++;
+  } while (length);
+
+  return n;
+}
+
+static size_t putMqttString(uint8_t* buf, const char* s, size_t length) {
+  if (buf) {
+    buf[0] = length >> 8;
+    buf[1] = length & 0xff;
+    memcpy(buf + 2, s, length);
+  }
+
+  return length + 2;
+}
+
+static size_t putMqttPacket(uint8_t* buf, uint8_t type, size_t length) {
+  if (buf) buf[0] = type;
+  return 1 + putMqttLength(buf ? buf + 1 : nullptr, length);
+}
+
+static void trimSpan(const char*& s, const char*& e) {
+  while (s < e && isspace(*s)) s++;
+  while (e > s && isspace(*(e - 1))) e--;
+}
+
+size_t AsyncMqttRequest::encode(uint8_t* buf, const char* clientId,
+                                const char* user, const char* pass,
+                                const String& doc, bool retain) {
+  size_t n = 0;
+  auto at = [&]() { return buf ? buf + n : nullptr; };
+
+  // CONNECT
+  size_t length = 10 + 2 + strlen(clientId);
+  uint8_t flags = 0x02;  // Clean session
+
+  if (strlen(user)) {
+    length += 2 + strlen(user);
+    flags |= 0x80;
+  }
+  if (strlen(pass)) {
+    length += 2 + strlen(pass);
+    flags |= 0x40;
+  }
+
+  n += putMqttPacket(at(), 0x10, length);
+  n += putMqttString(at(), "MQTT", 4);
+  if (buf) {
+    buf[n] = 0x04;  // Protocol level 3.1.1
+    buf[n + 1] = flags;
+    buf[n + 2] = PUSH_MQTT_KEEPALIVE >> 8;
+    buf[n + 3] = PUSH_MQTT_KEEPALIVE & 0xff;
+  }
+  n += 4;
+  n += putMqttString(at(), clientId, strlen(clientId));
+  if (flags & 0x80) n += putMqttString(at(), user, strlen(user));
+  if (flags & 0x40) n += putMqttString(at(), pass, strlen(pass));
+
+  // PUBLISH, one per "topic:value|" with QoS 0
+  const char* p = doc.c_str();
+  const char* end = p + doc.length();
+
+  while (p < end) {
+    const char* next = static_cast<const char*>(memchr(p, '|', end - p));
+    if (!next) next = end;
+
+    const char* colon = static_cast<const char*>(memchr(p, ':', next - p));
+
+    if (colon) {
+      const char* topic = p;
+      const char* topicEnd = colon;
+      const char* value = colon + 1;
+      const char* valueEnd = next;
+
+      trimSpan(topic, topicEnd);
+      trimSpan(value, valueEnd);
+
+      if (topicEnd > topic) {
+        size_t topicLength = topicEnd - topic, valueLength = valueEnd - value;
+
+        n += putMqttPacket(at(), retain ? 0x31 : 0x30,
+                           2 + topicLength + valueLength);
+        n += putMqttString(at(), topic, topicLength);
+        if (buf) memcpy(buf + n, value, valueLength);
+        n += valueLength;
+      }
+    }
+
+    p = next + 1;
+  }
+
+  // DISCONNECT
+  n += putMqttPacket(at(), 0xe0, 0);
+  return n;
+}
+
+bool AsyncMqttRequest::begin(const char* host, uint16_t port,
+                             const char* clientId, const char* user,
+                             const char* pass, const String& doc, bool retain,
+                             uint32_t timeout) {
+  size_t length = encode(nullptr, clientId, user, pass, doc, retain);
+
+  _packets.reset(new (std::nothrow) uint8_t[length]);
+  if (!_packets) return false;
+
+  encode(_packets.get(), clientId, user, pass, doc, retain);
+  _host = host;
+  _port = port;
+  _body = _packets.get();
+  _bodyLength = length;
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("PUSH: Mqtt packets %d bytes." CR), length);
+#endif
+  connect(timeout);
+  return true;
+}
+
+void AsyncMqttRequest::handleData(const char* data, size_t len) {
+  if (_done) return;
+
+  // CONNACK, 0x20 0x02 <flags> <return code>
+  for (size_t i = 0; i < len && _responseLength < 4; i++)
+    _response[_responseLength++] = data[i];
+
+  if (_responseLength < 4) return;
+
+  if (_response[0] != 0x20 || _response[3] != 0) {
+    Log.warning(F("PUSH: Mqtt broker refused connection, code %d." CR),
+                _response[3]);
+    finish(PUSH_ERROR_MQTT_DENIED);
+    _client->close();
+    return;
+  }
+
+  _accepted = true;
+  handleAck();
+}
+
+// The publish packets are sent together with the connect, the push is only
+// complete when the broker has accepted the connection and acked all of them
+void AsyncMqttRequest::handleAck() {
+  if (_done || !_accepted || _acked < _request.length() + _bodyLength) return;
+
+  finish(0);
+  _client->close();
+}
+
+void AsyncPushRequest::finish(int code) {
+  if (_done) return;
+
+  _code = code;
+  _done = true;
+}
+
+bool AsyncPushRequest::isDone() {
+  if (!_done && (millis() - _start) > _timeout) {
+    finish(PUSH_ERROR_READ_TIMEOUT);
+    _client->close(true);
+  }
+
+  return _done;
+}
+
+void PushDispatcher::begin(uint32_t deadline) {
+  reset();
+  memset(&_status[0], 0, sizeof(_status));
+  _start = millis();
+  _deadline = deadline;
+}
+
+void PushDispatcher::reset() {
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    delete _request[i];
+    _request[i] = nullptr;
+  }
+}
+
+bool PushDispatcher::startHttp(PushTarget t, const char* method,
+                               const char* url, const char* header1,
+                               const char* header2, const String& body,
+                               uint32_t timeout, bool gzip) {
+  AsyncHttpRequest* request = new AsyncHttpRequest();
+
+  if (!request->begin(method, url, header1, header2, body, timeout, gzip)) {
+    delete request;
+    return false;  // Not a plain http target, caller sends it
+  }
+
+  started(t, request, url);
+  return true;
+}
+
+bool PushDispatcher::startHttp(PushTarget t, const char* method,
+                               const char* url, const char* header1,
+                               const char* header2, const char* contentType,
+                               const uint8_t* body, size_t length,
+                               uint32_t timeout) {
+  AsyncHttpRequest* request = new AsyncHttpRequest();
+
+  if (!request->begin(method, url, header1, header2, contentType, body, length,
+                      timeout)) {
+    delete request;
+    return false;
+  }
+
+  started(t, request, url);
+  return true;
+}
+
+bool PushDispatcher::startMqtt(PushTarget t, const char* host, uint16_t port,
+                               const char* clientId, const char* user,
+                               const char* pass, const String& doc,
+                               bool retain, uint32_t timeout) {
+  AsyncMqttRequest* request = new AsyncMqttRequest();
+
+  if (!request->begin(host, port, clientId, user, pass, doc, retain,
+                      timeout)) {
+    delete request;
+    return false;
+  }
+
+  started(t, request, host);
+  return true;
+}
+
+void PushDispatcher::started(PushTarget t, AsyncPushRequest* request,
+                             const char* url) {
+  PERF_BEGIN(pushPerfNames[t]);
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("PUSH: Started %s to %s." CR), pushTargetNames[t], url);
+#endif
+  _request[t] = request;
+  _status[t].used = true;
+  _status[t].async = true;
+}
+
+void PushDispatcher::setResult(PushTarget t, bool success, int code,
+                               uint32_t latency) {
+  _status[t].used = true;
+  _status[t].async = false;
+  complete(t, success, code, latency);
+}
+
+void PushDispatcher::complete(PushTarget t, bool success, int code,
+                              uint32_t latency) {
+  _status[t].done = true;
+  _status[t].success = success;
+  _status[t].code = code;
+  _status[t].latency = latency;
+
+  Log.notice(F("PUSH: Target %s done, success=%s, code=%d, %dms." CR),
+             pushTargetNames[t], success ? "true" : "false", code, latency);
+}
+
+// Returns true when all started requests are completed
+bool PushDispatcher::poll() {
+  bool expired = (millis() - _start) > _deadline;
+  bool active = false;
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    AsyncPushRequest* r = _request[i];
+    if (!r) continue;
+
+    if (!r->isDone() && !expired) {
+      active = true;
+      continue;
+    }
+
+    PushTarget t = static_cast<PushTarget>(i);
+    PERF_END(pushPerfNames[i]);
+
+    if (r->isDone())
+      complete(t, r->isSuccess(), r->getCode(), millis() - r->getStart());
+    else
+      complete(t, false, PUSH_ERROR_READ_TIMEOUT, millis() - r->getStart());
+
+    delete r;
+    _request[i] = nullptr;
+  }
+
+  return !active;
+}
+
+bool PushDispatcher::wait() {
+  if (isActive()) {
+    PERF_BEGIN("push-wait");
+    while (!poll()) delay(1);
+    PERF_END("push-wait");
+
+    Log.notice(F("PUSH: All targets completed in %dms." CR),
+               millis() - _start);
+  }
+
+  bool success = true;
+  for (int i = 0; i < PUSH_TARGETS; i++)
+    if (_status[i].used && !_status[i].success) success = false;
+
+  return success;
+}
+
+bool PushDispatcher::isActive() const {
+  for (int i = 0; i < PUSH_TARGETS; i++)
+    if (_request[i]) return true;
+
+  return false;
+}
+
+const char* PushDispatcher::getTargetName(PushTarget t) {
+  return pushTargetNames[t];
+}
+
+const char* PushDispatcher::getPerfName(PushTarget t) {
+  return pushPerfNames[t];
+}
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
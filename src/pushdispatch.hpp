@@ -0,0 +1,202 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_PUSHDISPATCH_HPP_
+#define SRC_PUSHDISPATCH_HPP_
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <Arduino.h>
+
+#include <memory>
+
+#if defined(ESP8266)
+#include <ESPAsyncTCP.h>
+#else
+#include <AsyncTCP.h>
+#endif
+
+constexpr auto PUSH_TARGETS = 5;
+constexpr auto PUSH_DISPATCH_DEADLINE = 20000;  // ms, for all targets
+
+// Same values as the HTTPClient error codes
+constexpr auto PUSH_ERROR_CONNECTION_FAILED = -1;
+constexpr auto PUSH_ERROR_CONNECTION_LOST = -5;
+constexpr auto PUSH_ERROR_READ_TIMEOUT = -11;
+constexpr auto PUSH_ERROR_MQTT_DENIED = -10;  // Same as the mqtt client
+constexpr auto PUSH_MQTT_KEEPALIVE = 60;     // s
+
+enum PushTarget {
+  PUSH_TARGET_HTTP1 = 0,
+  PUSH_TARGET_HTTP2 = 1,
+  PUSH_TARGET_HTTP3 = 2,
+  PUSH_TARGET_INFLUX = 3,
+  PUSH_TARGET_MQTT = 4,
+};
+
+struct PushTargetStatus {
+  bool used;
+  bool async;
+  bool done;
+  bool success;
+  int code;
+  uint32_t latency;  // ms
+};
+
+// Base for the requests sent over AsyncTCP. The request is written as soon
+// as the connection is up and the connection is closed when the first part
+// of the response has been received, the rest is not needed.
+class AsyncPushRequest {
+ protected:
+  AsyncClient* _client = nullptr;
+  String _host;
+  uint16_t _port = 0;
+  String _request;
+  const uint8_t* _body = nullptr;  // Sent after _request, not copied
+  size_t _bodyLength = 0;
+  size_t _sent = 0;
+  size_t _acked = 0;
+  char _response[16];
+  size_t _responseLength = 0;
+  volatile int _code = 0;
+  volatile bool _done = false;
+  uint32_t _start = 0;
+  uint32_t _timeout = 0;
+
+  void connect(uint32_t timeout);
+  void sendPending();
+  void finish(int code);
+  virtual void handleData(const char* data, size_t len) = 0;
+  virtual void handleAck() {}
+
+ public:
+  AsyncPushRequest() {}
+  virtual ~AsyncPushRequest();
+
+  bool isDone();
+  int getCode() const { return _code; }
+  virtual bool isSuccess() const = 0;
+  uint32_t getStart() const { return _start; }
+};
+
+class AsyncHttpRequest : public AsyncPushRequest {
+ private:
+  std::unique_ptr<uint8_t[]> _compressed;
+
+  bool buildRequest(const char* method, const char* url, const char* header1,
+                    const char* header2, const char* contentType,
+                    size_t length, bool gzip = false);
+  void handleData(const char* data, size_t len) override;
+
+ public:
+  AsyncHttpRequest() {}
+
+  static bool parseUrl(const char* url, String& host, uint16_t& port,
+                       String& path);
+
+  // With gzip the body is sent compressed if that makes it smaller
+  bool begin(const char* method, const char* url, const char* header1,
+             const char* header2, const String& body, uint32_t timeout,
+             bool gzip = false);
+  // The body must stay valid until the request is done. The content type
+  // replaces a Content-Type in the configured headers.
+  bool begin(const char* method, const char* url, const char* header1,
+             const char* header2, const char* contentType,
+             const uint8_t* body, size_t length, uint32_t timeout);
+  bool isSuccess() const override { return _code >= 200 && _code < 300; }
+};
+
+// MQTT 3.1.1 with all topics in one write. CONNECT, the PUBLISH packets and
+// DISCONNECT are sent without waiting for the broker, which is allowed with
+// QoS 0, and the CONNACK tells if they were accepted.
+class AsyncMqttRequest : public AsyncPushRequest {
+ private:
+  std::unique_ptr<uint8_t[]> _packets;
+  bool _accepted = false;  // CONNACK received, waiting for the publish acks
+
+  void handleData(const char* data, size_t len) override;
+  void handleAck() override;
+
+ public:
+  AsyncMqttRequest() {}
+
+  // Topics are in the template format, "topic:value|topic:value|". Writes
+  // the packets to buf and returns the size, with buf = nullptr only the
+  // size is returned. The connection is always a clean session since
+  // nothing is subscribed.
+  static size_t encode(uint8_t* buf, const char* clientId, const char* user,
+                       const char* pass, const String& doc, bool retain);
+
+  bool begin(const char* host, uint16_t port, const char* clientId,
+             const char* user, const char* pass, const String& doc,
+             bool retain, uint32_t timeout);
+  bool isSuccess() const override { return _code == 0; }
+};
+
+// Runs the push targets in parallel. Plain http and mqtt targets are sent
+// over AsyncTCP while the SSL targets are run in sequence by the caller and
+// only reported here. wait() is the completion barrier for all of them.
+class PushDispatcher {
+ private:
+  AsyncPushRequest* _request[PUSH_TARGETS] = {nullptr};
+  PushTargetStatus _status[PUSH_TARGETS];
+  uint32_t _start = 0;
+  uint32_t _deadline = 0;
+
+  void started(PushTarget t, AsyncPushRequest* request, const char* url);
+  void complete(PushTarget t, bool success, int code, uint32_t latency);
+
+ public:
+  PushDispatcher() { memset(&_status[0], 0, sizeof(_status)); }
+  ~PushDispatcher() { reset(); }
+
+  void begin(uint32_t deadline = PUSH_DISPATCH_DEADLINE);
+  void reset();
+  bool startHttp(PushTarget t, const char* method, const char* url,
+                 const char* header1, const char* header2, const String& body,
+                 uint32_t timeout, bool gzip = false);
+  bool startHttp(PushTarget t, const char* method, const char* url,
+                 const char* header1, const char* header2,
+                 const char* contentType, const uint8_t* body, size_t length,
+                 uint32_t timeout);
+  bool startMqtt(PushTarget t, const char* host, uint16_t port,
+                 const char* clientId, const char* user, const char* pass,
+                 const String& doc, bool retain, uint32_t timeout);
+  void setResult(PushTarget t, bool success, int code, uint32_t latency);
+
+  bool poll();
+  bool wait();
+  bool isActive() const;
+
+  const PushTargetStatus& getStatus(PushTarget t) const { return _status[t]; }
+  static const char* getTargetName(PushTarget t);
+  static const char* getPerfName(PushTarget t);
+};
+
+extern PushDispatcher myPushDispatcher;
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+#endif  // SRC_PUSHDISPATCH_HPP_
+
+// EOF
@@ -0,0 +1,173 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <LittleFS.h>
+
+#include <log.hpp>
+#include <pushscheduler.hpp>
+
+#if defined(ESP8266)
+PushScheduleData myPushScheduleData = {0};
+#else
+RTC_DATA_ATTR PushScheduleData myPushScheduleData = {0};
+#endif
+
+PushScheduler myPushScheduler(&myPushScheduleData);
+
+constexpr auto PUSHINT_FILENAME = "/push.dat";  // Counters used before 2.3
+
+uint16_t PushScheduler::getChecksum() const {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&_data->Clock);
+  uint16_t sum = _data->IsDataAvailable << 8 | _data->Pushed;
+
+  for (size_t i = 0; i < sizeof(PushScheduleData) -
+                             offsetof(PushScheduleData, Clock);
+       i++)
+    sum = (sum << 1 | sum >> 15) ^ p[i];
+
+  return sum;
+}
+
+bool PushScheduler::isValid() const {
+  return _data->IsDataAvailable == PUSH_SCHEDULE_DATA_AVAILABLE &&
+         _data->Checksum == getChecksum();
+}
+
+void PushScheduler::reset() {
+  memset(_data, 0, sizeof(PushScheduleData));
+  _data->IsDataAvailable = PUSH_SCHEDULE_DATA_AVAILABLE;
+}
+
+void PushScheduler::load() {
+  if (_loaded) return;
+
+  _loaded = true;
+#if defined(ESP8266)
+  ESP.rtcUserMemoryRead(PUSH_SCHEDULE_RTC_OFFSET,
+                        reinterpret_cast<uint32_t*>(_data),
+                        sizeof(PushScheduleData));
+#endif
+
+  if (isValid()) return;
+
+  // Cold start, continue from the copy saved with the configuration
+  File file = LittleFS.open(PUSH_SCHEDULE_FILENAME, "r");
+
+  if (file) {
+    file.read(reinterpret_cast<uint8_t*>(_data), sizeof(PushScheduleData));
+    file.close();
+  }
+
+  if (!isValid()) {
+    Log.notice(F("PUSH: No push schedule found, starting a new one." CR));
+    reset();
+
+    if (LittleFS.exists(PUSHINT_FILENAME)) LittleFS.remove(PUSHINT_FILENAME);
+  }
+}
+
+uint32_t PushScheduler::getDeviceClock() {
+  load();
+  return _data->Clock + millis() / 1000;
+}
+
+void PushScheduler::advanceDeviceClock(uint32_t seconds) {
+  load();
+  _data->Clock += seconds;
+  save();
+}
+
+bool PushScheduler::isDue(int target, int skipCount, int sleepInterval) {
+  if (skipCount <= 0) return true;
+
+  load();
+  if (!(_data->Pushed & (1 << target))) return true;
+
+  // Half a sleep interval of slack since the wakes drift a bit
+  uint32_t elapsed = getDeviceClock() - _data->LastPush[target];
+  uint32_t interval = (skipCount + 1) * sleepInterval;
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("PUSH: Target %d pushed %us ago, interval %us." CR), target,
+              elapsed, interval);
+#endif
+  return elapsed + sleepInterval / 2 >= interval;
+}
+
+void PushScheduler::setDone(int target) {
+  uint32_t now = getDeviceClock();
+
+  _data->LastPush[target] = now;
+  _data->Pushed |= 1 << target;
+}
+
+void PushScheduler::commit() {
+  if (!_pending) return;
+
+  myPushDispatcher.wait();
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    const PushTargetStatus& status =
+        myPushDispatcher.getStatus(static_cast<PushTarget>(i));
+
+    if ((_pending & (1 << i)) && status.used && status.success) setDone(i);
+  }
+
+  _pending = 0;
+  save();
+}
+
+void PushScheduler::save() {
+  load();
+  _data->Checksum = getChecksum();
+#if defined(ESP8266)
+  ESP.rtcUserMemoryWrite(PUSH_SCHEDULE_RTC_OFFSET,
+                         reinterpret_cast<uint32_t*>(_data),
+                         sizeof(PushScheduleData));
+#endif
+}
+
+void PushScheduler::saveMirror() {
+  save();
+
+  File file = LittleFS.open(PUSH_SCHEDULE_FILENAME, "w");
+
+  if (file) {
+    file.write(reinterpret_cast<const uint8_t*>(_data),
+               sizeof(PushScheduleData));
+    file.close();
+  }
+}
+
+void PushScheduler::clear() {
+  reset();
+  _loaded = true;
+  save();
+  LittleFS.remove(PUSH_SCHEDULE_FILENAME);
+}
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
@@ -0,0 +1,95 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_PUSHSCHEDULER_HPP_
+#define SRC_PUSHSCHEDULER_HPP_
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <Arduino.h>
+
+#include <pushdispatch.hpp>
+
+constexpr auto PUSH_SCHEDULE_RTC_OFFSET = 110;  // Blocks of 4 bytes, ESP8266
+constexpr auto PUSH_SCHEDULE_FILENAME = "/push.bin";
+
+#define PUSH_SCHEDULE_DATA_AVAILABLE \
+  static_cast<uint8_t>(110)  // Unique number to flag resume data is available
+
+struct PushScheduleData {
+  uint8_t IsDataAvailable;
+  uint8_t Pushed;  // Bit per target, set when LastPush is valid
+  uint16_t Checksum;
+  uint32_t Clock;  // s, run time plus sleep time since first start
+  uint32_t LastPush[PUSH_TARGETS];  // Device clock of the last push
+};
+
+static_assert(sizeof(PushScheduleData) <=
+                  512 - PUSH_SCHEDULE_RTC_OFFSET * 4,
+              "Push schedule does not fit in RTC user memory");
+
+extern PushScheduleData myPushScheduleData;
+
+// Keeps the device clock and the time of the last push per target across
+// deep sleep. The data lives in RTC memory (RTC user memory on ESP8266) with
+// a checksum, a copy is only written to flash when the configuration is saved
+// so the schedule survives a power cycle.
+class PushScheduler {
+ private:
+  PushScheduleData* _data;
+  bool _loaded = false;
+  uint8_t _pending = 0;  // Bit per target sent on this wake, result unknown
+
+  uint16_t getChecksum() const;
+  bool isValid() const;
+  void reset();
+  void load();
+
+ public:
+  explicit PushScheduler(PushScheduleData* data) : _data(data) {}
+
+  uint32_t getDeviceClock();
+  void advanceDeviceClock(uint32_t seconds);
+
+  // Skip count is the number of sleep cycles to skip, it's converted to a time
+  // so the schedule is kept when the sleep interval is stretched.
+  bool isDue(int target, int skipCount, int sleepInterval);
+  void setDone(int target);
+
+  // Async pushes are only known to have succeeded after the dispatcher has
+  // completed, pending targets are marked as done by commit() on success.
+  void setPending(int target) { _pending |= 1 << target; }
+  void commit();
+
+  void save();
+  void saveMirror();
+  void clear();
+};
+
+extern PushScheduler myPushScheduler;
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+#endif  // SRC_PUSHSCHEDULER_HPP_
+
+// EOF
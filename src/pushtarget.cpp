@@ -33,193 +33,553 @@
 #include <config_brewing.hpp>
 #include <cstdio>
 #include <helper.hpp>
+#include <lineprotocol.hpp>
 #include <main.hpp>
+#include <payloadencoder.hpp>
 #include <perf.hpp>
+#include <pushscheduler.hpp>
 #include <pushtarget.hpp>
 #include <templating.hpp>
+#include <tlssession.hpp>
 
-constexpr auto PUSHINT_FILENAME = "/push.dat";
+// Compact payloads are written here and sent without a copy, one buffer per
+// http post target since the requests run in parallel until wait().
+static uint8_t payloadBuffer[2][PAYLOAD_BUFFER_SIZE + 1];
 
-void PushIntervalTracker::update(const int index, const int defaultValue) {
-  if (_counters[index] <= 0)
-    _counters[index] = defaultValue;
-  else
-    _counters[index]--;
+BrewingPush::BrewingPush(BrewingConfig* brewingConfig)
+    : BasePush(brewingConfig) {
+  _brewingConfig = brewingConfig;
 }
 
-void PushIntervalTracker::load() {
-  File intFile = LittleFS.open(PUSHINT_FILENAME, "r");
+void BrewingPush::sendAll(const TemplateValues& values, MeasurementType type,
+                          bool enableHttpPost, bool enableHttpPost2,
+                          bool enableHttpGet, bool enableInfluxdb2,
+                          bool enableMqtt) {
+  printHeap("PUSH");
+  _http->setReuse(true);
 
-  if (intFile) {
-    String line = intFile.readStringUntil('\n');
-    Log.notice(F("PUSH: Read interval tracker %s." CR), line.c_str());
+  int base = type == MeasurementType::GRAVITY ? GRAVITY_TEMPLATE_HTTP1
+                                              : PRESSURE_TEMPLATE_HTTP1;
+  int skip[PUSH_TARGETS] = {_brewingConfig->getPushIntervalPost(),
+                            _brewingConfig->getPushIntervalPost2(),
+                            _brewingConfig->getPushIntervalGet(),
+                            _brewingConfig->getPushIntervalInflux(),
+                            _brewingConfig->getPushIntervalMqtt()};
+  bool active[PUSH_TARGETS] = {
+      _brewingConfig->hasTargetHttpPost() && enableHttpPost,
+      _brewingConfig->hasTargetHttpPost2() && enableHttpPost2,
+      _brewingConfig->hasTargetHttpGet() && enableHttpGet,
+      _brewingConfig->hasTargetInfluxDb2() && enableInfluxdb2,
+      _brewingConfig->hasTargetMqtt() && enableMqtt};
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    if (active[i] && !myPushScheduler.isDue(
+                         i, skip[i], _brewingConfig->getSleepInterval())) {
+      Log.notice(F("PUSH: Skipping %s, not scheduled for this wake." CR),
+                 PushDispatcher::getTargetName(static_cast<PushTarget>(i)));
+      active[i] = false;
+    }
+  }
+
+  myPushDispatcher.begin();
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    if (!active[i]) continue;
 
-    char temp[80];
-    char *s, *p = &temp[0];
-    int i = 0;
+    PushTarget t = static_cast<PushTarget>(i);
 
-    snprintf(&temp[0], sizeof(temp), "%s", line.c_str());
-    while ((s = strtok_r(p, ":", &p)) != NULL) {
-      _counters[i++] = atoi(s);
+    if (isTargetSSL(t) && _brewingConfig->isSkipSslOnTest() &&
+        runMode != RunMode::measurementMode) {
+      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
+    } else {
+      PushEncoding encoding = getEncoding(t, type);
+
+      if (encoding == PUSH_ENCODING_TEMPLATE ||
+          !sendEncoded(t, encoding, values, type)) {
+        String doc = renderTemplate(static_cast<Templates>(base + i), values);
+        sendTarget(t, doc);
+      }
+      myPushScheduler.setPending(i);
     }
+    yield();
+  }
+
+  clearTemplate();
+}
 
-    intFile.close();
+// Targets that are configured and due for a push on this wake, bit per
+// target
+uint8_t BrewingPush::getBatchTargets() {
+  int skip[PUSH_TARGETS] = {_brewingConfig->getPushIntervalPost(),
+                            _brewingConfig->getPushIntervalPost2(),
+                            _brewingConfig->getPushIntervalGet(),
+                            _brewingConfig->getPushIntervalInflux(),
+                            _brewingConfig->getPushIntervalMqtt()};
+  bool active[PUSH_TARGETS] = {
+      _brewingConfig->hasTargetHttpPost(), _brewingConfig->hasTargetHttpPost2(),
+      _brewingConfig->hasTargetHttpGet(), _brewingConfig->hasTargetInfluxDb2(),
+      _brewingConfig->hasTargetMqtt()};
+  uint8_t targets = 0;
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    if (!active[i]) continue;
+
+    if (myPushScheduler.isDue(i, skip[i], _brewingConfig->getSleepInterval()))
+      targets |= 1 << i;
+    else
+      Log.notice(F("PUSH: Skipping %s, not scheduled for this wake." CR),
+                 PushDispatcher::getTargetName(static_cast<PushTarget>(i)));
   }
 
-#if LOG_LEVEL == 6
-  Log.verbose(F("PUSH: Parsed trackers: %d:%d:%d:%d:%d." CR), _counters[0],
-              _counters[1], _counters[2], _counters[3], _counters[4]);
-#endif
+  return targets;
 }
 
-void PushIntervalTracker::save() {
-  update(0, _brewingConfig->getPushIntervalPost());
-  update(1, _brewingConfig->getPushIntervalPost2());
-  update(2, _brewingConfig->getPushIntervalGet());
-  update(3, _brewingConfig->getPushIntervalInflux());
-  update(4, _brewingConfig->getPushIntervalMqtt());
+// Pushes several measurements with one request per target, one line per
+// measurement for influxdb and all topics in one connection for mqtt. The
+// http post targets get a json array when batching is configured, otherwise
+// each measurement is posted as a single object like a normal push. Http get
+// has no batch format so each measurement is sent in sequence. Returns the
+// targets, bit per target, that accepted all measurements.
+uint8_t BrewingPush::sendBatch(
+    MeasurementType type, int count, uint8_t targets,
+    std::function<void(int, TemplateValues&)> setup) {
+  int base = type == MeasurementType::GRAVITY ? GRAVITY_TEMPLATE_HTTP1
+                                              : PRESSURE_TEMPLATE_HTTP1;
+  int timestampId = getTemplateVariableId(TPL_TIMESTAMP);
+  bool pressure = type == MeasurementType::PRESSURE;
+  bool array = count > 1 && _brewingConfig->getPushBatch() > 1;
+  uint8_t success = targets;
 
-  // If this feature is disabled we skip saving the file
-  if (!_brewingConfig->isPushIntervalActive()) {
-#if LOG_LEVEL == 6
-    Log.notice(F("PUSH: Variabled push interval disabled." CR));
-#endif
-    LittleFS.remove(PUSHINT_FILENAME);
-  } else {
-    Log.notice(
-        F("PUSH: Variabled push interval enabled, updating counters." CR));
-    File intFile = LittleFS.open(PUSHINT_FILENAME, "w");
-
-    if (intFile) {
-      // Format=http1:http2:http3:influx:mqtt
-      intFile.printf("%d:%d:%d:%d:%d\n", _counters[0], _counters[1],
-                     _counters[2], _counters[3], _counters[4]);
-      intFile.close();
+  printHeap("PUSH");
+  _http->setReuse(true);
+  myPushDispatcher.begin();
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    if (!((targets >> i) & 1)) continue;
+
+    PushTarget t = static_cast<PushTarget>(i);
+    const CompiledTemplate& tpl =
+        getCompiledTemplate(static_cast<Templates>(base + i));
+    bool post = t == PUSH_TARGET_HTTP1 || t == PUSH_TARGET_HTTP2;
+
+    // The compact http post payloads hold one measurement, only the line
+    // protocol encoding is used for batches
+    bool lineProtocol = getEncoding(t, type) == PUSH_ENCODING_LINE_PROTOCOL;
+    String body;
+    LineProtocolWriter lines(body);
+
+    for (int j = 0; j < count; j++) {
+      TemplateValues values;
+      values.setNeeded(tpl.getVariables() |
+                       (lineProtocol ? getLineProtocolVariables(pressure) : 0) |
+                       (static_cast<uint64_t>(1) << timestampId));
+      setup(j, values);
+
+      if (lineProtocol && writeLineProtocol(lines, values, pressure)) continue;
+
+      String doc = tpl.render(values);
+
+      if (post && array) {
+        doc.trim();
+        body += j ? "," : "[";
+        body += doc;
+        if (j == count - 1) body += "]";
+      } else if (t == PUSH_TARGET_INFLUX) {
+        // Line protocol, timestamp in ns after the fields
+        doc.trim();
+        if (values.hasVal(timestampId)) {
+          doc.replace("\n", String(" ") + values.getVal(timestampId) +
+                                "000000000\n");
+          doc += String(" ") + values.getVal(timestampId) + "000000000";
+        }
+        if (body.length()) body += "\n";
+        body += doc;
+      } else if (t == PUSH_TARGET_MQTT) {
+        // All topics for all measurements in one connection
+        body += doc;
+        if (!doc.endsWith("|")) body += "|";
+      } else if (count == 1) {
+        body = doc;
+      } else {
+        // One request per measurement, the background request of a target
+        // can only be used once per dispatch
+        sendTarget(t, doc, false);
+        if (!_lastSuccess) success &= ~(1 << i);
+        yield();
+      }
+    }
+
+    if (body.length()) {
+      sendTarget(t, body);
+      yield();
     }
   }
+
+  clearTemplate();
+  myPushDispatcher.wait();
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    const PushTargetStatus& status =
+        myPushDispatcher.getStatus(static_cast<PushTarget>(i));
+    if (status.used && !status.success) success &= ~(1 << i);
+  }
+
+  return success;
 }
 
-BrewingPush::BrewingPush(BrewingConfig* brewingConfig)
-    : BasePush(brewingConfig) {
-  _brewingConfig = brewingConfig;
+// Starts a plain http or mqtt target in the background, returns false if the
+// target must be sent directly
+bool BrewingPush::startTarget(PushTarget t, String& doc, uint32_t timeout) {
+  switch (t) {
+    case PUSH_TARGET_HTTP1:
+      return myPushDispatcher.startHttp(t, "POST",
+                                        _brewingConfig->getTargetHttpPost(),
+                                        _brewingConfig->getHeader1HttpPost(),
+                                        _brewingConfig->getHeader2HttpPost(),
+                                        doc, timeout);
+    case PUSH_TARGET_HTTP2:
+      return myPushDispatcher.startHttp(t, "POST",
+                                        _brewingConfig->getTargetHttpPost2(),
+                                        _brewingConfig->getHeader1HttpPost2(),
+                                        _brewingConfig->getHeader2HttpPost2(),
+                                        doc, timeout);
+    case PUSH_TARGET_HTTP3: {
+      String url = String(_brewingConfig->getTargetHttpGet()) + doc;
+      return myPushDispatcher.startHttp(t, "GET", url.c_str(),
+                                        _brewingConfig->getHeader1HttpGet(),
+                                        _brewingConfig->getHeader2HttpGet(),
+                                        String(), timeout);
+    }
+    case PUSH_TARGET_INFLUX: {
+      String url = String(_brewingConfig->getTargetInfluxDB2()) +
+                   "/api/v2/write?org=" + _brewingConfig->getOrgInfluxDB2() +
+                   "&bucket=" + _brewingConfig->getBucketInfluxDB2();
+      String auth = String("Authorization: Token ") +
+                    _brewingConfig->getTokenInfluxDB2();
+      return myPushDispatcher.startHttp(t, "POST", url.c_str(), auth.c_str(),
+                                        "Content-Type: text/plain", doc,
+                                        timeout,
+                                        _brewingConfig->isInfluxDb2Gzip());
+    }
+    case PUSH_TARGET_MQTT:
+      return !isTargetSSL(t) &&
+             myPushDispatcher.startMqtt(
+                 t, _brewingConfig->getTargetMqtt(),
+                 _brewingConfig->getPortMqtt(), _brewingConfig->getMDNS(),
+                 _brewingConfig->getUserMqtt(), _brewingConfig->getPassMqtt(),
+                 doc, _brewingConfig->isMqttRetain(), timeout);
+  }
+
+  return false;
 }
 
-void BrewingPush::sendAll(TemplatingEngine& engine, MeasurementType type,
-                          bool enableHttpPost, bool enableHttpPost2,
-                          bool enableHttpGet, bool enableInfluxdb2,
-                          bool enableMqtt) {
-  printHeap("PUSH");
-  _http->setReuse(true);
+// Plain http and mqtt targets are started in the background and completed by
+// myPushDispatcher.wait(), the others are sent directly while the background
+// requests are running.
+void BrewingPush::sendTarget(PushTarget t, String& doc, bool allowAsync) {
+  uint32_t timeout = _brewingConfig->getPushTimeout() * 1000;
+
+  if (allowAsync && startTarget(t, doc, timeout)) return;
+
+  PERF_BEGIN(PushDispatcher::getPerfName(t));
+  uint32_t start = millis();
+
+  // Resume the TLS session from the last wake when the client supports it
+  const char* url = getTargetUrl(t);
+  bool ssl = isTargetSSL(t), offered = false;
+#if defined(ESP8266)
+  if (ssl) {
+    _tlsSession = BearSSL::Session();
+    offered = myTlsSessionCache.restore(url, &_tlsSession);
+    _wifiSecure.setSession(&_tlsSession);
+  }
+#endif
 
-  PushIntervalTracker intDelay(_brewingConfig);
-  intDelay.load();
+  if (ssl) timeHandshake(t, offered);
 
-  if (_brewingConfig->hasTargetHttpPost() && intDelay.useHttp1() &&
-      enableHttpPost) {
-    PERF_BEGIN("push-http");
-    String tpl;
+  switch (t) {
+    case PUSH_TARGET_HTTP1:
+      sendHttpPost(doc);
+      break;
+    case PUSH_TARGET_HTTP2:
+      sendHttpPost2(doc);
+      break;
+    case PUSH_TARGET_HTTP3:
+      sendHttpGet(doc);
+      break;
+    case PUSH_TARGET_INFLUX:
+      sendInfluxDb2(doc);
+      break;
+    case PUSH_TARGET_MQTT:
+      sendMqtt(doc);
+      break;
+  }
 
-    if (type == MeasurementType::GRAVITY)
-      tpl = getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1);
-    else
-      tpl = getTemplate(BrewingPush::PRESSURE_TEMPLATE_HTTP1);
+#if defined(ESP8266)
+  if (ssl) {
+    if (_lastSuccess) myTlsSessionCache.store(url, &_tlsSession);
+    _wifiSecure.setSession(nullptr);
+  }
+#endif
 
-    String doc = engine.create(tpl.c_str());
+  myPushDispatcher.setResult(t, _lastSuccess, _lastResponseCode,
+                             millis() - start);
+  PERF_END(PushDispatcher::getPerfName(t));
+}
 
-    if (_brewingConfig->isHttpPostSSL() && _brewingConfig->isSkipSslOnTest() &&
-        runMode != RunMode::measurementMode)
-      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
-    else
-      sendHttpPost(doc);
-    PERF_END("push-http");
-    yield();
+const char* BrewingPush::getTargetUrl(PushTarget t) const {
+  switch (t) {
+    case PUSH_TARGET_HTTP1:
+      return _brewingConfig->getTargetHttpPost();
+    case PUSH_TARGET_HTTP2:
+      return _brewingConfig->getTargetHttpPost2();
+    case PUSH_TARGET_HTTP3:
+      return _brewingConfig->getTargetHttpGet();
+    case PUSH_TARGET_INFLUX:
+      return _brewingConfig->getTargetInfluxDB2();
+    case PUSH_TARGET_MQTT:
+      return _brewingConfig->getTargetMqtt();
   }
 
-  if (_brewingConfig->hasTargetHttpPost2() && intDelay.useHttp2() &&
-      enableHttpPost2) {
-    PERF_BEGIN("push-http2");
-    String tpl;
+  return "";
+}
 
-    if (type == MeasurementType::GRAVITY)
-      tpl = getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP2);
-    else
-      tpl = getTemplate(BrewingPush::PRESSURE_TEMPLATE_HTTP2);
+bool BrewingPush::isTargetSSL(PushTarget t) const {
+  switch (t) {
+    case PUSH_TARGET_HTTP1:
+      return _brewingConfig->isHttpPostSSL();
+    case PUSH_TARGET_HTTP2:
+      return _brewingConfig->isHttpPost2SSL();
+    case PUSH_TARGET_HTTP3:
+      return _brewingConfig->isHttpGetSSL();
+    case PUSH_TARGET_INFLUX:
+      return _brewingConfig->isHttpInfluxDb2SSL();
+    case PUSH_TARGET_MQTT:
+      return _brewingConfig->isMqttSSL();
+  }
 
-    String doc = engine.create(tpl.c_str());
+  return false;
+}
 
-    if (_brewingConfig->isHttpPost2SSL() && _brewingConfig->isSkipSslOnTest() &&
-        runMode != RunMode::measurementMode)
-      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
-    else
-      sendHttpPost2(doc);
-    PERF_END("push-http2");
-    yield();
+void BrewingPush::getTargetHost(PushTarget t, String& host,
+                                uint16_t& port) const {
+  const char* url = getTargetUrl(t);
+
+  if (t == PUSH_TARGET_MQTT) {
+    host = url;
+    port = _brewingConfig->getPortMqtt();
+    return;
   }
 
-  if (_brewingConfig->hasTargetHttpGet() && intDelay.useHttp3() &&
-      enableHttpGet) {
-    PERF_BEGIN("push-http3");
-    String tpl;
+  const char* p = strstr(url, "://");
+  p = p ? p + 3 : url;
+  const char* e = p;
+  while (*e && *e != ':' && *e != '/' && *e != '?') e++;
 
-    if (type == MeasurementType::GRAVITY)
-      tpl = getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP3);
-    else
-      tpl = getTemplate(BrewingPush::PRESSURE_TEMPLATE_HTTP3);
+  host = String(p).substring(0, e - p);
+  port = *e == ':' ? atoi(e + 1) : 443;
+}
 
-    String doc = engine.create(tpl.c_str());
+#if defined(COLLECT_PERFDATA)
+// The push requests do not expose the handshake, so the secure client is
+// connected on its own to time it, this is why it's only done when perf data
+// is collected. An offered session is tried first since the server keeps the
+// session id only when it resumes it, the timed handshake is then done the
+// same way so the resumed and full times can be compared.
+void BrewingPush::timeHandshake(PushTarget t, bool offered) {
+  String host;
+  uint16_t port;
+  bool resumed = false;
+
+  getTargetHost(t, host, port);
+
+#if defined(ESP8266)
+  if (offered) {
+    br_ssl_session_parameters last = *_tlsSession.getSession();
+    const br_ssl_session_parameters* now = _tlsSession.getSession();
+
+    resumed = _wifiSecure.connect(host.c_str(), port) &&
+              now->session_id_len == last.session_id_len &&
+              !memcmp(now->session_id, last.session_id, last.session_id_len);
+    _wifiSecure.stop();
+  }
 
-    if (_brewingConfig->isHttpGetSSL() && _brewingConfig->isSkipSslOnTest() &&
-        runMode != RunMode::measurementMode)
-      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
-    else
-      sendHttpGet(doc);
-    PERF_END("push-http3");
-    yield();
+  BearSSL::Session empty;
+  if (!resumed) _wifiSecure.setSession(&empty);  // Full handshake
+#endif
+
+  const char* perf = resumed ? "push-tls-resumed" : "push-tls-full";
+  uint32_t start = millis();
+
+  PERF_BEGIN(perf);
+  bool connected = _wifiSecure.connect(host.c_str(), port);
+  PERF_END(perf);
+  uint32_t time = millis() - start;
+  _wifiSecure.stop();
+
+#if defined(ESP8266)
+  _wifiSecure.setSession(&_tlsSession);
+#endif
+
+  if (connected)
+    Log.notice(F("PUSH: TLS handshake for %s took %dms, session %s." CR),
+               PushDispatcher::getTargetName(t), time,
+               resumed ? "resumed" : offered ? "not resumed" : "not cached");
+  else
+    Log.warning(F("PUSH: TLS handshake with %s failed." CR), host.c_str());
+}
+#else
+void BrewingPush::timeHandshake(PushTarget, bool) {}
+#endif
+
+// Cache slot per template, the gravity templates first
+int BrewingPush::getTemplateSlot(Templates t) {
+  switch (t) {
+    case GRAVITY_TEMPLATE_HTTP1:
+      return PUSH_TARGET_HTTP1;
+    case GRAVITY_TEMPLATE_HTTP2:
+      return PUSH_TARGET_HTTP2;
+    case GRAVITY_TEMPLATE_HTTP3:
+      return PUSH_TARGET_HTTP3;
+    case GRAVITY_TEMPLATE_INFLUX:
+      return PUSH_TARGET_INFLUX;
+    case GRAVITY_TEMPLATE_MQTT:
+      return PUSH_TARGET_MQTT;
+    case PRESSURE_TEMPLATE_HTTP1:
+      return PUSH_TARGETS + PUSH_TARGET_HTTP1;
+    case PRESSURE_TEMPLATE_HTTP2:
+      return PUSH_TARGETS + PUSH_TARGET_HTTP2;
+    case PRESSURE_TEMPLATE_HTTP3:
+      return PUSH_TARGETS + PUSH_TARGET_HTTP3;
+    case PRESSURE_TEMPLATE_INFLUX:
+      return PUSH_TARGETS + PUSH_TARGET_INFLUX;
+    case PRESSURE_TEMPLATE_MQTT:
+      return PUSH_TARGETS + PUSH_TARGET_MQTT;
   }
 
-  if (_brewingConfig->hasTargetInfluxDb2() && intDelay.useInflux() &&
-      enableInfluxdb2) {
-    PERF_BEGIN("push-influxdb2");
-    String tpl;
+  return 0;
+}
 
-    if (type == MeasurementType::GRAVITY)
-      tpl = getTemplate(BrewingPush::GRAVITY_TEMPLATE_INFLUX);
-    else
-      tpl = getTemplate(BrewingPush::PRESSURE_TEMPLATE_INFLUX);
+const CompiledTemplate& BrewingPush::getCompiledTemplate(Templates t) {
+  int slot = getTemplateSlot(t);
+  uint16_t generation = myTemplateCache.getGeneration();
+  const CompiledTemplate* compiled = myTemplateCache.get(slot);
 
-    String doc = engine.create(tpl.c_str());
+  if (!compiled) {
+    compiled = &myTemplateCache.put(slot, getTemplate(t), generation);
+    _baseTemplate.clear();
+  }
 
-    if (_brewingConfig->isHttpInfluxDb2SSL() &&
-        _brewingConfig->isSkipSslOnTest() &&
-        runMode != RunMode::measurementMode)
-      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
-    else
-      sendInfluxDb2(doc);
-    PERF_END("push-influxdb2");
-    yield();
+  return *compiled;
+}
+
+PushEncoding BrewingPush::getEncoding(PushTarget t,
+                                      MeasurementType type) const {
+  PushEncoding encoding = PUSH_ENCODING_TEMPLATE;
+
+  if (t == PUSH_TARGET_HTTP1)
+    encoding = _brewingConfig->getHttpPostEncoding();
+  else if (t == PUSH_TARGET_HTTP2)
+    encoding = _brewingConfig->getHttpPost2Encoding();
+  else if (t == PUSH_TARGET_INFLUX)
+    encoding = _brewingConfig->getInfluxDb2Encoding();
+
+  // The binary layout only has room for gravity
+  if (encoding == PUSH_ENCODING_BINARY && type != MeasurementType::GRAVITY)
+    encoding = PUSH_ENCODING_TEMPLATE;
+
+  return encoding;
+}
+
+// Encodes the values straight into the static buffer for the http post
+// targets or as line protocol for influxdb, returns false if the payload
+// could not be created or sent in the background so the template is used
+// instead.
+bool BrewingPush::sendEncoded(PushTarget t, PushEncoding encoding,
+                              const TemplateValues& values,
+                              MeasurementType type) {
+  if (encoding == PUSH_ENCODING_LINE_PROTOCOL) {
+    String doc;
+    LineProtocolWriter lines(doc);
+
+    if (!writeLineProtocol(lines, values, type == MeasurementType::PRESSURE))
+      return false;
+
+    sendTarget(t, doc);
+    return true;
   }
 
-  if (_brewingConfig->hasTargetMqtt() && intDelay.useMqtt() && enableMqtt) {
-    PERF_BEGIN("push-mqtt");
-    String tpl;
+  uint8_t* buf = &payloadBuffer[t][0];
+  size_t length =
+      encoding == PUSH_ENCODING_BINARY
+          ? encodeBinary(values, buf, PAYLOAD_BUFFER_SIZE)
+          : encodeMsgPack(values, type == MeasurementType::PRESSURE, buf,
+                          PAYLOAD_BUFFER_SIZE);
+
+  if (!length) {
+    Log.warning(F("PUSH: Payload for %s is too large, using the template." CR),
+                PushDispatcher::getTargetName(t));
+    return false;
+  }
 
-    if (type == MeasurementType::GRAVITY)
-      tpl = getTemplate(BrewingPush::GRAVITY_TEMPLATE_MQTT);
-    else
-      tpl = getTemplate(BrewingPush::PRESSURE_TEMPLATE_MQTT);
+  const char* contentType = getEncodingContentType(encoding);
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("PUSH: Encoded %d bytes as %s." CR), length, contentType);
+#endif
 
-    String doc = engine.create(tpl.c_str());
+  const char* url = t == PUSH_TARGET_HTTP1
+                        ? _brewingConfig->getTargetHttpPost()
+                        : _brewingConfig->getTargetHttpPost2();
+  const char* header1 = t == PUSH_TARGET_HTTP1
+                            ? _brewingConfig->getHeader1HttpPost()
+                            : _brewingConfig->getHeader1HttpPost2();
+  const char* header2 = t == PUSH_TARGET_HTTP1
+                            ? _brewingConfig->getHeader2HttpPost()
+                            : _brewingConfig->getHeader2HttpPost2();
+
+  if (myPushDispatcher.startHttp(t, "POST", url, header1, header2, contentType,
+                                 buf, length,
+                                 _brewingConfig->getPushTimeout() * 1000))
+    return true;
+
+  // SSL goes through the http client which sends the configured headers, so
+  // the encoded body would go out with the wrong content type.
+  Log.warning(F("PUSH: Encoding not supported for %s, using the template." CR),
+              PushDispatcher::getTargetName(t));
+  return false;
+}
 
-    if (_brewingConfig->isMqttSSL() && _brewingConfig->isSkipSslOnTest() &&
-        runMode != RunMode::measurementMode)
-      Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
-    else
-      sendMqtt(doc);
-    PERF_END("push-mqtt");
-    yield();
+// Compiles the templates for all defined targets and returns the variables
+// they reference, so only those values need to be calculated before sendAll.
+uint64_t BrewingPush::getTemplateVariables(MeasurementType type) {
+  int base = type == MeasurementType::GRAVITY ? GRAVITY_TEMPLATE_HTTP1
+                                              : PRESSURE_TEMPLATE_HTTP1;
+  bool active[PUSH_TARGETS] = {
+      _brewingConfig->hasTargetHttpPost(), _brewingConfig->hasTargetHttpPost2(),
+      _brewingConfig->hasTargetHttpGet(), _brewingConfig->hasTargetInfluxDb2(),
+      _brewingConfig->hasTargetMqtt()};
+  uint64_t variables = 0;
+
+  for (int i = 0; i < PUSH_TARGETS; i++) {
+    if (!active[i]) continue;
+
+    PushEncoding encoding = getEncoding(static_cast<PushTarget>(i), type);
+
+    // The template is still needed if the compact payload does not fit
+    variables |=
+        getCompiledTemplate(static_cast<Templates>(base + i)).getVariables();
+    if (encoding != PUSH_ENCODING_TEMPLATE)
+      variables |=
+          getEncodingVariables(encoding, type == MeasurementType::PRESSURE);
   }
 
-  intDelay.save();
+#if LOG_LEVEL == 6
+  Log.verbose(F("PUSH: Templates use variables %X:%X." CR),
+              static_cast<uint32_t>(variables >> 32),
+              static_cast<uint32_t>(variables));
+#endif
+  return variables;
 }
 
 const char* BrewingPush::getTemplate(Templates t, bool useDefaultTemplate) {
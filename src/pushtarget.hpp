@@ -28,6 +28,9 @@
 
 #include <basepush.hpp>
 #include <config_brewing.hpp>
+#include <functional>
+#include <pushdispatch.hpp>
+#include <templatecompiler.hpp>
 #include <templating.hpp>
 
 extern const char iPressureHttpPostFormat[] PROGMEM;
@@ -48,8 +51,13 @@ constexpr auto TPL_TEMP = "${temp}";
 constexpr auto TPL_TEMP_C = "${temp-c}";
 constexpr auto TPL_TEMP_F = "${temp-f}";
 constexpr auto TPL_TEMP_UNITS = "${temp-unit}";  // C or F
+constexpr auto TPL_TEMP1 = "${temp1}";  // Individual probes, same unit as temp
+constexpr auto TPL_TEMP2 = "${temp2}";
+constexpr auto TPL_TEMP3 = "${temp3}";
+constexpr auto TPL_TEMP4 = "${temp4}";
 constexpr auto TPL_BATTERY = "${battery}";
 constexpr auto TPL_BATTERY_PERCENT = "${battery-percent}";
+constexpr auto TPL_BATTERY_DAYS = "${battery-days}";
 constexpr auto TPL_RSSI = "${rssi}";
 constexpr auto TPL_RUN_TIME = "${run-time}";
 constexpr auto TPL_APP_VER = "${app-ver}";
@@ -73,6 +81,7 @@ constexpr auto TPL_PRESSURE_KPA = "${pressure-kpa}";
 constexpr auto TPL_PRESSURE1_KPA = "${pressure1-kpa}";
 constexpr auto TPL_PRESSURE_UNIT = "${pressure-unit}";  // PSI, BAR, KPA
 constexpr auto TPL_APP_BUILD = "${app-build}";
+constexpr auto TPL_TIMESTAMP = "${timestamp}";  // Epoch, queued measurements
 
 constexpr auto TPL_GRAVITY_FNAME_POST = "/http-1.tpl";
 constexpr auto TPL_GRAVITY_FNAME_POST2 = "/http-2.tpl";
@@ -96,10 +105,23 @@ extern const char iPressureHttpGetFormat[] PROGMEM;
 extern const char iPressureInfluxDbFormat[] PROGMEM;
 extern const char iPressureMqttFormat[] PROGMEM;
 
+static_assert(TEMPLATE_CACHE_SLOTS >= PUSH_TARGETS * 2,
+              "Template cache needs a slot per target and measurement type");
+
 class BrewingPush : public BasePush {
  private:
   BrewingConfig* _brewingConfig;
   String _baseTemplate;
+#if defined(ESP8266)
+  BearSSL::Session _tlsSession;  // Updated by the client after a handshake
+#endif
+
+  bool startTarget(PushTarget t, String& doc, uint32_t timeout);
+  void sendTarget(PushTarget t, String& doc, bool allowAsync = true);
+  const char* getTargetUrl(PushTarget t) const;
+  bool isTargetSSL(PushTarget t) const;
+  void getTargetHost(PushTarget t, String& host, uint16_t& port) const;
+  void timeHandshake(PushTarget t, bool offered);
 
  public:
   explicit BrewingPush(BrewingConfig* brewingConfig);
@@ -123,34 +145,28 @@ class BrewingPush : public BasePush {
     PRESSURE = 1,
   };
 
-  void sendAll(TemplatingEngine& engine, MeasurementType type,
+  void sendAll(const TemplateValues& values, MeasurementType type,
                bool enableHttpPost = true, bool enableHttpPost2 = true,
                bool enableHttpGet = true, bool enableInfluxdb2 = true,
                bool enableMqtt = true);
+  uint8_t getBatchTargets();
+  uint8_t sendBatch(MeasurementType type, int count, uint8_t targets,
+                    std::function<void(int, TemplateValues&)> setup);
   const char* getTemplate(Templates t, bool useDefaultTemplate = false);
+  static int getTemplateSlot(Templates t);
+  const CompiledTemplate& getCompiledTemplate(Templates t);
+  uint64_t getTemplateVariables(MeasurementType type);
+  String renderTemplate(Templates t, const TemplateValues& values) {
+    return getCompiledTemplate(t).render(values);
+  }
   void clearTemplate() { _baseTemplate.clear(); }
+  PushEncoding getEncoding(PushTarget t, MeasurementType type) const;
   int getLastCode() { return _lastResponseCode; }
   bool getLastSuccess() { return _lastSuccess; }
-};
 
-class PushIntervalTracker {
  private:
-  BrewingConfig* _brewingConfig;
-
-  int _counters[5] = {0, 0, 0, 0, 0};
-  void update(const int index, const int defaultValue);
-
- public:
-  explicit PushIntervalTracker(BrewingConfig* brewingConfig)
-      : _brewingConfig(brewingConfig) {}
-
-  bool useHttp1() { return _counters[0] == 0 ? true : false; }
-  bool useHttp2() { return _counters[1] == 0 ? true : false; }
-  bool useHttp3() { return _counters[2] == 0 ? true : false; }
-  bool useInflux() { return _counters[3] == 0 ? true : false; }
-  bool useMqtt() { return _counters[4] == 0 ? true : false; }
-  void load();
-  void save();
+  bool sendEncoded(PushTarget t, PushEncoding encoding,
+                   const TemplateValues& values, MeasurementType type);
 };
 
 #endif  // ESPFWK_DISABLE_WIFI
@@ -0,0 +1,154 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <log.hpp>
+#include <memory>
+#include <telemetryws.hpp>
+#include <vector>
+
+TelemetryWebSocket myTelemetryWebSocket;
+
+void TelemetryWebSocket::begin(AsyncWebServer* server) {
+  if (_ws) return;
+
+#if defined(ESP32)
+  _lock = xSemaphoreCreateRecursiveMutex();
+#endif
+  _ws = new AsyncWebSocket(TELEMETRY_PATH);
+  _ws->onEvent([this](AsyncWebSocket*, AsyncWebSocketClient* client,
+                      AwsEventType type, void* arg, uint8_t* data,
+                      size_t len) { onEvent(client, type, arg, data, len); });
+  server->addHandler(_ws);
+  Log.notice(F("WEB : Telemetry available on %s." CR), TELEMETRY_PATH);
+}
+
+// Held by send() while it uses the clients, so a client that disconnects is
+// not deleted until the frame has been queued. Recursive since closing a
+// client runs the disconnect event.
+void TelemetryWebSocket::lock() {
+#if defined(ESP32)
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+#endif
+}
+
+void TelemetryWebSocket::unlock() {
+#if defined(ESP32)
+  xSemaphoreGiveRecursive(_lock);
+#endif
+}
+
+TelemetryWebSocket::Client* TelemetryWebSocket::find(uint32_t id) {
+  for (Client& c : _clients)
+    if (c.id == id) return &c;
+
+  return nullptr;
+}
+
+void TelemetryWebSocket::onEvent(AsyncWebSocketClient* client,
+                                 AwsEventType type, void* arg, uint8_t* data,
+                                 size_t len) {
+  lock();
+
+  switch (type) {
+    case WS_EVT_CONNECT: {
+      Client* c = find(0);
+
+      if (!c) {
+        Log.warning(F("WEB : Too many telemetry clients, closing %u." CR),
+                    client->id());
+        client->close();
+        break;
+      }
+
+      c->decimation = 1;
+      c->id = client->id();
+    } break;
+
+    case WS_EVT_DISCONNECT: {
+      Client* c = find(client->id());
+      if (c) c->id = 0;
+    } break;
+
+    case WS_EVT_DATA: {
+      AwsFrameInfo* info = reinterpret_cast<AwsFrameInfo*>(arg);
+      Client* c = find(client->id());
+
+      if (c && info->final && info->index == 0 && info->len == len &&
+          info->opcode == WS_TEXT && len < 4) {
+        char buf[4];
+        memcpy(buf, data, len);
+        buf[len] = 0;
+
+        int n = atoi(buf);
+        if (n >= 1 && n <= TELEMETRY_MAX_DECIMATION) c->decimation = n;
+      }
+    } break;
+
+    default:
+      break;
+  }
+
+  unlock();
+}
+
+void TelemetryWebSocket::send(bool valid, bool moving, float angle,
+                              float tempC, float gravity, float battery) {
+  if (!_ws || !_ws->count()) return;
+
+  TelemetryFrame f;
+  f.set(_sequence, valid, moving, angle, tempC, gravity, battery);
+
+  // One buffer shared by all the clients
+  AsyncWebSocketSharedBuffer buf = std::make_shared<std::vector<uint8_t>>(
+      reinterpret_cast<uint8_t*>(&f),
+      reinterpret_cast<uint8_t*>(&f) + sizeof(f));
+
+  lock();
+
+  for (Client& c : _clients) {
+    if (!c.id || _sequence % c.decimation) continue;
+
+    AsyncWebSocketClient* client = _ws->client(c.id);
+    if (!client || client->status() != WS_CONNECTED) continue;
+
+    if (client->queueLen() >= TELEMETRY_MAX_QUEUED) {
+      _dropped++;
+      continue;
+    }
+
+    client->binary(buf);
+  }
+
+  unlock();
+  _sequence++;
+}
+
+void TelemetryWebSocket::loop() {
+  if (_ws) _ws->cleanupClients(TELEMETRY_MAX_CLIENTS);
+}
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+// EOF
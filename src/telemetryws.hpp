@@ -0,0 +1,111 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_TELEMETRYWS_HPP_
+#define SRC_TELEMETRYWS_HPP_
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+constexpr auto TELEMETRY_PATH = "/ws/telemetry";
+constexpr auto TELEMETRY_VERSION = 1;
+constexpr auto TELEMETRY_MAX_CLIENTS = 4;
+constexpr auto TELEMETRY_MAX_QUEUED = 2;  // Frames per client before dropping
+constexpr auto TELEMETRY_MAX_DECIMATION = 50;
+
+enum TelemetryFlags {
+  TELEMETRY_ANGLE_VALID = 0x01,
+  TELEMETRY_MOVING = 0x02,
+};
+
+// Frame sent to the clients, 12 bytes little endian
+struct __attribute__((packed)) TelemetryFrame {
+  uint8_t version;
+  uint8_t flags;
+  uint16_t sequence;
+  int16_t angle;     // degrees * 100
+  int16_t tempC;     // C * 100
+  uint16_t gravity;  // SG * 10000, as configured with temperature correction
+  uint16_t battery;  // mV
+
+  void set(uint16_t seq, bool valid, bool moving, float a, float c, float g,
+           float b) {
+    version = TELEMETRY_VERSION;
+    flags = (valid ? TELEMETRY_ANGLE_VALID : 0) |
+            (moving ? TELEMETRY_MOVING : 0);
+    sequence = seq;
+    angle = valid ? static_cast<int16_t>(roundf(a * 100)) : 0;
+    tempC = isnan(c) ? 0 : static_cast<int16_t>(roundf(c * 100));
+    gravity = valid && !isnan(g) ? static_cast<uint16_t>(roundf(g * 10000)) : 0;
+    battery = static_cast<uint16_t>(roundf(b * 1000));
+  }
+};
+
+static_assert(sizeof(TelemetryFrame) == 12, "Telemetry frame size");
+
+// Pushes the sensor values to the connected clients each time the sensors are
+// read, instead of the ui polling the api. A client can send a text message
+// with a number n to only get every n:th frame. Frames are dropped for a
+// client that has not received the earlier ones, so a slow client only gets
+// the newest values and does not hold heap.
+class TelemetryWebSocket {
+ private:
+  struct Client {
+    volatile uint32_t id;
+    volatile uint8_t decimation;
+  };
+
+  AsyncWebSocket* _ws = nullptr;
+  Client _clients[TELEMETRY_MAX_CLIENTS] = {};
+#if defined(ESP32)
+  SemaphoreHandle_t _lock = nullptr;  // Events are run by the async_tcp task
+#endif
+  uint16_t _sequence = 0;
+  uint32_t _dropped = 0;
+
+  void lock();
+  void unlock();
+  Client* find(uint32_t id);
+  void onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg,
+               uint8_t* data, size_t len);
+
+ public:
+  TelemetryWebSocket() {}
+
+  void begin(AsyncWebServer* server);
+  void send(bool valid, bool moving, float angle, float tempC, float gravity,
+            float battery);
+  void loop();
+
+  uint32_t getDropped() const { return _dropped; }
+};
+
+extern TelemetryWebSocket myTelemetryWebSocket;
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+#endif  // SRC_TELEMETRYWS_HPP_
+
+// EOF
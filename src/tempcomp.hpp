@@ -0,0 +1,213 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_TEMPCOMP_HPP_
+#define SRC_TEMPCOMP_HPP_
+
+#include <Arduino.h>
+
+constexpr auto TEMPCOMP_BUCKETS = 40;
+constexpr auto TEMPCOMP_BUCKET_SIZE = 0.5;  // C per bucket
+constexpr auto TEMPCOMP_MIN_BUCKETS = 3;
+constexpr auto TEMPCOMP_MIN_SPAN = 3.0;  // C
+// Samples averaged per bucket, the later ones are ignored so the count does
+// not wrap and the float sums keep their precision on long runs
+constexpr auto TEMPCOMP_BUCKET_MAX_SAMPLES = 4096;
+
+// Angle offset as a polynomial of the gyro die temperature,
+// offset = c1 * (t - ref) + c2 * (t - ref)^2
+struct GyroTempCompensation {
+  float refTempC;
+  float c1;
+  float c2;
+  float residualDrift;  // Degrees tilt per C left after compensation
+
+  bool isActive() const { return c1 != 0 || c2 != 0; }
+  float getOffset(float tempC) const {
+    float d = tempC - refTempC;
+    return c1 * d + c2 * d * d;
+  }
+};
+
+// Collects angle readings from a device in a fixed position while the die
+// temperature changes. The readings are averaged into 0.5C buckets so a long
+// run at the same temperature does not dominate the fit.
+class GyroTempCompCalibration {
+ private:
+  float _sumAngle[TEMPCOMP_BUCKETS];
+  float _sumTemp[TEMPCOMP_BUCKETS];
+  uint16_t _count[TEMPCOMP_BUCKETS];
+  float _baseTempC = NAN;
+  float _rawDrift = NAN;
+  float _residualDrift = NAN;
+
+  int getBucket(float tempC) const {
+    int i = static_cast<int>(
+                floor((tempC - _baseTempC) / TEMPCOMP_BUCKET_SIZE + 0.5)) +
+            TEMPCOMP_BUCKETS / 2;
+    return (i < 0 || i >= TEMPCOMP_BUCKETS) ? -1 : i;
+  }
+
+  static float peakToPeak(const float* v, int n) {
+    float lo = v[0], hi = v[0];
+
+    for (int i = 1; i < n; i++) {
+      if (v[i] < lo) lo = v[i];
+      if (v[i] > hi) hi = v[i];
+    }
+
+    return hi - lo;
+  }
+
+ public:
+  GyroTempCompCalibration() { clear(); }
+
+  void clear() {
+    memset(&_sumAngle[0], 0, sizeof(_sumAngle));
+    memset(&_sumTemp[0], 0, sizeof(_sumTemp));
+    memset(&_count[0], 0, sizeof(_count));
+    _baseTempC = NAN;
+    _rawDrift = NAN;
+    _residualDrift = NAN;
+  }
+
+  bool addSample(float tempC, float angle) {
+    if (isnan(tempC) || isnan(angle)) return false;
+    if (isnan(_baseTempC)) _baseTempC = tempC;
+
+    int i = getBucket(tempC);
+    if (i < 0 || _count[i] >= TEMPCOMP_BUCKET_MAX_SAMPLES) return false;
+
+    _sumAngle[i] += angle;
+    _sumTemp[i] += tempC;
+    _count[i]++;
+    return true;
+  }
+
+  int getNoSamples() const {
+    int n = 0;
+    for (int i = 0; i < TEMPCOMP_BUCKETS; i++) n += _count[i];
+    return n;
+  }
+
+  int getNoBuckets() const {
+    int n = 0;
+    for (int i = 0; i < TEMPCOMP_BUCKETS; i++)
+      if (_count[i]) n++;
+    return n;
+  }
+
+  float getMinTempC() const {
+    for (int i = 0; i < TEMPCOMP_BUCKETS; i++)
+      if (_count[i]) return _sumTemp[i] / _count[i];
+    return NAN;
+  }
+
+  float getMaxTempC() const {
+    for (int i = TEMPCOMP_BUCKETS - 1; i >= 0; i--)
+      if (_count[i]) return _sumTemp[i] / _count[i];
+    return NAN;
+  }
+
+  // Drift per C in the collected data, before and after compensation. Defined
+  // as the peak to peak angle variation divided by the temperature span.
+  float getRawDriftPerC() const { return _rawDrift; }
+  float getResidualDriftPerC() const { return _residualDrift; }
+
+  // Least squares fit of a second order polynomial to the bucket averages.
+  bool fit(GyroTempCompensation* result) {
+    float x[TEMPCOMP_BUCKETS], y[TEMPCOMP_BUCKETS];
+    int n = 0;
+
+    for (int i = 0; i < TEMPCOMP_BUCKETS; i++) {
+      if (!_count[i]) continue;
+      x[n] = _sumTemp[i] / _count[i];
+      y[n] = _sumAngle[i] / _count[i];
+      n++;
+    }
+
+    if (n < TEMPCOMP_MIN_BUCKETS) return false;
+
+    float span = x[n - 1] - x[0];
+    if (span < TEMPCOMP_MIN_SPAN) return false;
+
+    double ref = 0;
+    for (int i = 0; i < n; i++) ref += x[i];
+    ref /= n;
+
+    // Normal equations for y = a0 + a1 * d + a2 * d^2, with d = x - ref
+    double s[5] = {0, 0, 0, 0, 0}, t[3] = {0, 0, 0};
+
+    for (int i = 0; i < n; i++) {
+      double d = x[i] - ref, p = 1;
+
+      for (int j = 0; j < 5; j++) {
+        s[j] += p;
+        if (j < 3) t[j] += p * y[i];
+        p *= d;
+      }
+    }
+
+    double m[3][4] = {{s[0], s[1], s[2], t[0]},
+                      {s[1], s[2], s[3], t[1]},
+                      {s[2], s[3], s[4], t[2]}};
+
+    // Gaussian elimination with partial pivoting
+    for (int c = 0; c < 3; c++) {
+      int p = c;
+      for (int r = c + 1; r < 3; r++)
+        if (fabs(m[r][c]) > fabs(m[p][c])) p = r;
+      if (fabs(m[p][c]) < 1e-12) return false;
+
+      for (int k = 0; k < 4; k++) {
+        double tmp = m[c][k];
+        m[c][k] = m[p][k];
+        m[p][k] = tmp;
+      }
+
+      for (int r = 0; r < 3; r++) {
+        if (r == c) continue;
+        double f = m[r][c] / m[c][c];
+        for (int k = c; k < 4; k++) m[r][k] -= f * m[c][k];
+      }
+    }
+
+    double a0 = m[0][3] / m[0][0];
+    result->refTempC = ref;
+    result->c1 = m[1][3] / m[1][1];
+    result->c2 = m[2][3] / m[2][2];
+
+    float residual[TEMPCOMP_BUCKETS];
+    for (int i = 0; i < n; i++)
+      residual[i] = y[i] - a0 - result->getOffset(x[i]);
+
+    _rawDrift = peakToPeak(y, n) / span;
+    _residualDrift = peakToPeak(residual, n) / span;
+    result->residualDrift = _residualDrift;
+    return true;
+  }
+};
+
+#endif  // SRC_TEMPCOMP_HPP_
+
+// EOF
@@ -0,0 +1,322 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <log.hpp>
+#include <new>
+#include <pushtarget.hpp>
+#include <templatecompiler.hpp>
+
+// The position in this list is the variable id
+const char* const templateVariables[] = {
+    TPL_MDNS,
+    TPL_ID,
+    TPL_TOKEN,
+    TPL_TOKEN2,
+    TPL_SLEEP_INTERVAL,
+    TPL_TEMP,
+    TPL_TEMP_C,
+    TPL_TEMP_F,
+    TPL_TEMP_UNITS,
+    TPL_TEMP1,
+    TPL_TEMP2,
+    TPL_TEMP3,
+    TPL_TEMP4,
+    TPL_BATTERY,
+    TPL_BATTERY_PERCENT,
+    TPL_BATTERY_DAYS,
+    TPL_RSSI,
+    TPL_RUN_TIME,
+    TPL_APP_VER,
+    TPL_APP_BUILD,
+    TPL_ANGLE,
+    TPL_TILT,
+    TPL_VELOCITY,
+    TPL_GRAVITY,
+    TPL_GRAVITY_G,
+    TPL_GRAVITY_P,
+    TPL_GRAVITY_CORR,
+    TPL_GRAVITY_CORR_G,
+    TPL_GRAVITY_CORR_P,
+    TPL_GRAVITY_UNIT,
+    TPL_PRESSURE,
+    TPL_PRESSURE1,
+    TPL_PRESSURE_PSI,
+    TPL_PRESSURE1_PSI,
+    TPL_PRESSURE_BAR,
+    TPL_PRESSURE1_BAR,
+    TPL_PRESSURE_KPA,
+    TPL_PRESSURE1_KPA,
+    TPL_PRESSURE_UNIT,
+    TPL_TIMESTAMP,
+};
+
+constexpr int templateVariableCount =
+    sizeof(templateVariables) / sizeof(templateVariables[0]);
+
+static_assert(templateVariableCount <= TEMPLATE_MAX_VARIABLES,
+              "Too many template variables");
+
+int getTemplateVariableId(const char* key, size_t length) {
+  for (int i = 0; i < templateVariableCount; i++) {
+    if (!strncmp(templateVariables[i], key, length) &&
+        templateVariables[i][length] == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+int getTemplateVariableId(const char* key) {
+  // The keys are normally the TPL_ constants so check the pointer first
+  for (int i = 0; i < templateVariableCount; i++) {
+    if (templateVariables[i] == key) return i;
+  }
+
+  return getTemplateVariableId(key, strlen(key));
+}
+
+const char* getTemplateVariableName(int id) {
+  return id >= 0 && id < templateVariableCount ? templateVariables[id] : "";
+}
+
+int TemplateValues::getId(const char* key) const {
+  int id = getTemplateVariableId(key);
+
+  if (id < 0) Log.warning(F("TPL : Unknown template variable %s." CR), key);
+
+  return id;
+}
+
+void TemplateValues::store(int id, const char* val, size_t length) const {
+  // The last byte of the buffer is always an empty value
+  size_t space = TEMPLATE_VALUES_SIZE - _used;
+  size_t max = space ? space - 1 : 0;
+  if (max > 255) max = 255;
+
+  if (length > max) {
+    Log.warning(F("TPL : Template variable %s truncated from %d to %d "
+                  "chars." CR),
+                getTemplateVariableName(id), length, max);
+    length = max;
+  }
+
+  _offset[id] = space ? _used : TEMPLATE_VALUES_SIZE;
+  _length[id] = length;
+  _formatted |= static_cast<uint64_t>(1) << id;
+
+  if (!space) return;
+
+  memcpy(&_buf[_used], val, length);
+  _buf[_used + length] = 0;
+  _used += length + 1;
+}
+
+void TemplateValues::format(int id) const {
+  if ((_formatted >> id) & 1) return;
+
+  char buf[33];
+  const Value& v = _value[id];
+
+  switch (v.type) {
+    case TEMPLATE_VALUE_INT:
+      snprintf(&buf[0], sizeof(buf), "%d", v.i);
+      break;
+    case TEMPLATE_VALUE_FLOAT:
+      // Same formatting as String(float, decimals)
+      dtostrf(v.f, 0, v.decimals, &buf[0]);
+      break;
+    case TEMPLATE_VALUE_CHAR:
+      buf[0] = v.c;
+      buf[1] = 0;
+      break;
+    default:
+      buf[0] = 0;
+      break;
+  }
+
+  store(id, &buf[0], strlen(&buf[0]));
+}
+
+void TemplateValues::setVal(const char* key, const char* val) {
+  int id = getId(key);
+  if (!isNeeded(id)) return;
+
+  // Strings are copied directly since there is nothing to format
+  store(id, val, strlen(val));
+  _value[id].type = TEMPLATE_VALUE_STRING;
+  _hasValue |= static_cast<uint64_t>(1) << id;
+}
+
+void TemplateValues::setVal(const char* key, int val) {
+  int id = getId(key);
+  if (!isNeeded(id)) return;
+
+  _value[id].type = TEMPLATE_VALUE_INT;
+  _value[id].i = val;
+  _hasValue |= static_cast<uint64_t>(1) << id;
+}
+
+void TemplateValues::setVal(const char* key, float val, int dec) {
+  int id = getId(key);
+  if (!isNeeded(id)) return;
+
+  _value[id].type = TEMPLATE_VALUE_FLOAT;
+  _value[id].decimals = dec;
+  _value[id].f = val;
+  _hasValue |= static_cast<uint64_t>(1) << id;
+}
+
+void TemplateValues::setVal(const char* key, char val) {
+  int id = getId(key);
+  if (!isNeeded(id)) return;
+
+  _value[id].type = TEMPLATE_VALUE_CHAR;
+  _value[id].c = val;
+  _hasValue |= static_cast<uint64_t>(1) << id;
+}
+
+bool CompiledTemplate::compile(const char* tpl) {
+  clear();
+
+  size_t length = strlen(tpl);
+  int maxTokens = 1;
+
+  // Each variable can add a variable and a literal token
+  for (const char* p = strstr(tpl, "${"); p; p = strstr(p + 2, "${"))
+    maxTokens += 2;
+
+  _source.reset(new (std::nothrow) char[length + 1]);
+  _tokens.reset(new (std::nothrow) Token[maxTokens]);
+
+  if (!_source || !_tokens) {
+    Log.error(F("TPL : Failed to allocate memory for template." CR));
+    clear();
+    return false;
+  }
+
+  memcpy(_source.get(), tpl, length + 1);
+
+  const char* src = _source.get();
+  size_t literal = 0, pos = 0;
+
+  while (pos < length) {
+    const char* start = strstr(src + pos, "${");
+    if (!start) break;
+
+    const char* end = strchr(start, '}');
+    if (!end) break;
+
+    size_t keyPos = start - src;
+    size_t keyLength = end - start + 1;
+    int id = getTemplateVariableId(start, keyLength);
+
+    if (id >= 0) {
+      if (keyPos > literal) {
+        _tokens[_tokenCount++] = {static_cast<uint16_t>(literal),
+                                  static_cast<uint16_t>(keyPos - literal), -1};
+      }
+
+      _tokens[_tokenCount++] = {static_cast<uint16_t>(keyPos),
+                                static_cast<uint16_t>(keyLength),
+                                static_cast<int8_t>(id)};
+      _variables |= static_cast<uint64_t>(1) << id;
+      literal = keyPos + keyLength;
+    }
+
+    // Unknown keys are kept as literal text
+    pos = keyPos + keyLength;
+  }
+
+  if (length > literal) {
+    _tokens[_tokenCount++] = {static_cast<uint16_t>(literal),
+                              static_cast<uint16_t>(length - literal), -1};
+  }
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("TPL : Compiled template into %d tokens." CR), _tokenCount);
+#endif
+  return true;
+}
+
+size_t CompiledTemplate::getRenderLength(const TemplateValues& values) const {
+  size_t length = 0;
+
+  for (int i = 0; i < _tokenCount; i++) {
+    const Token& t = _tokens[i];
+    length += values.hasVal(t.variable) ? values.getLength(t.variable)
+                                        : t.length;
+  }
+
+  return length;
+}
+
+String CompiledTemplate::render(const TemplateValues& values) const {
+  String out;
+
+  if (!_source) return out;
+
+  out.reserve(getRenderLength(values));
+
+  for (int i = 0; i < _tokenCount; i++) {
+    const Token& t = _tokens[i];
+
+    // Variables without a value are kept as is in the output
+    if (values.hasVal(t.variable))
+      out.concat(values.getVal(t.variable), values.getLength(t.variable));
+    else
+      out.concat(_source.get() + t.offset, t.length);
+  }
+
+  return out;
+}
+
+TemplateCache myTemplateCache;
+
+const CompiledTemplate* TemplateCache::get(int slot) {
+  if (!_slot[slot].isCompiled() || _slotGeneration[slot] != _generation) {
+    _misses++;
+    return nullptr;
+  }
+
+  _hits++;
+  return &_slot[slot];
+}
+
+const CompiledTemplate& TemplateCache::put(int slot, const char* tpl,
+                                           uint16_t generation) {
+  _slot[slot].compile(tpl);
+  _slotGeneration[slot] = generation;
+  return _slot[slot];
+}
+
+void TemplateCache::invalidate() {
+  _generation++;
+  Log.notice(F("TPL : Template cache cleared, generation %d." CR),
+             _generation);
+}
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
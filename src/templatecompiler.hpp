@@ -0,0 +1,194 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_TEMPLATECOMPILER_HPP_
+#define SRC_TEMPLATECOMPILER_HPP_
+
+#include <Arduino.h>
+
+#include <memory>
+
+constexpr auto TEMPLATE_MAX_VARIABLES = 64;
+constexpr auto TEMPLATE_VALUES_SIZE = 768;  // Bytes for all formatted values
+constexpr auto TEMPLATE_CACHE_SLOTS = 10;   // Gravity and pressure per target
+
+// Returns the variable id for a key such as ${gravity}, -1 if not known
+int getTemplateVariableId(const char* key, size_t length);
+int getTemplateVariableId(const char* key);
+const char* getTemplateVariableName(int id);
+
+enum TemplateValueType : uint8_t {
+  TEMPLATE_VALUE_NONE = 0,
+  TEMPLATE_VALUE_STRING = 1,
+  TEMPLATE_VALUE_INT = 2,
+  TEMPLATE_VALUE_FLOAT = 3,
+  TEMPLATE_VALUE_CHAR = 4,
+};
+
+// Typed values for the template variables. Numbers are kept as is and only
+// formatted the first time a template renders them, into a fixed buffer so
+// setting and formatting the values does not allocate memory. Variables that
+// are not in the needed mask are ignored.
+class TemplateValues {
+ private:
+  struct Value {
+    TemplateValueType type;
+    uint8_t decimals;
+    union {
+      float f;
+      int32_t i;
+      char c;
+    };
+  };
+
+  Value _value[TEMPLATE_MAX_VARIABLES];
+  uint64_t _hasValue = 0;
+  uint64_t _needed = ~static_cast<uint64_t>(0);
+
+  // Formatted values, filled in on first use. Values that do not fit are
+  // truncated, the extra byte is the empty value when the buffer is full.
+  mutable char _buf[TEMPLATE_VALUES_SIZE + 1] = {0};
+  mutable uint16_t _offset[TEMPLATE_MAX_VARIABLES];
+  mutable uint8_t _length[TEMPLATE_MAX_VARIABLES];
+  mutable uint64_t _formatted = 0;
+  mutable uint16_t _used = 0;
+
+  int getId(const char* key) const;
+  void store(int id, const char* val, size_t length) const;
+  void format(int id) const;
+
+ public:
+  TemplateValues() {}
+
+  // Mask of variable ids, see CompiledTemplate::getVariables()
+  void setNeeded(uint64_t mask) { _needed = mask; }
+  uint64_t getNeeded() const { return _needed; }
+  bool isNeeded(int id) const {
+    return id >= 0 && id < TEMPLATE_MAX_VARIABLES && (_needed >> id) & 1;
+  }
+  bool isNeeded(const char* key) const {
+    return isNeeded(getTemplateVariableId(key));
+  }
+
+  void setVal(const char* key, const char* val);
+  void setVal(const char* key, int val);
+  void setVal(const char* key, float val, int dec);
+  void setVal(const char* key, char val);
+
+  bool hasVal(int id) const {
+    return id >= 0 && id < TEMPLATE_MAX_VARIABLES && (_hasValue >> id) & 1;
+  }
+  TemplateValueType getType(int id) const {
+    return hasVal(id) ? _value[id].type : TEMPLATE_VALUE_NONE;
+  }
+  // Numbers as set, without formatting. Strings and missing values are 0
+  float getFloat(int id) const {
+    TemplateValueType t = getType(id);
+    return t == TEMPLATE_VALUE_FLOAT ? _value[id].f
+           : t == TEMPLATE_VALUE_INT ? _value[id].i
+                                     : 0;
+  }
+  int32_t getInt(int id) const {
+    TemplateValueType t = getType(id);
+    return t == TEMPLATE_VALUE_INT     ? _value[id].i
+           : t == TEMPLATE_VALUE_FLOAT ? static_cast<int32_t>(_value[id].f)
+                                       : 0;
+  }
+  uint8_t getDecimals(int id) const { return _value[id].decimals; }
+  const char* getVal(int id) const {
+    format(id);
+    return &_buf[_offset[id]];
+  }
+  size_t getLength(int id) const {
+    format(id);
+    return _length[id];
+  }
+};
+
+// A template split into literal text and variables when it is loaded, so
+// rendering is a single pass without searching for keys.
+class CompiledTemplate {
+ private:
+  struct Token {
+    uint16_t offset;
+    uint16_t length;
+    int8_t variable;  // -1 for literal text
+  };
+
+  std::unique_ptr<char[]> _source;
+  std::unique_ptr<Token[]> _tokens;
+  int _tokenCount = 0;
+  uint64_t _variables = 0;
+
+ public:
+  CompiledTemplate() {}
+
+  bool compile(const char* tpl);
+  bool isCompiled() const { return _source != nullptr; }
+  void clear() {
+    _source.reset();
+    _tokens.reset();
+    _tokenCount = 0;
+    _variables = 0;
+  }
+
+  // Mask with one bit per variable id referenced by the template
+  uint64_t getVariables() const { return _variables; }
+  int getTokenCount() const { return _tokenCount; }
+  size_t getRenderLength(const TemplateValues& values) const;
+  String render(const TemplateValues& values) const;
+};
+
+// Compiled templates kept in RAM so the template files are only read once
+// after each change. The generation is increased when the templates or the
+// configuration is written, which drops all cached templates. The web
+// handlers only increase the generation, a slot is recompiled by the task
+// that renders it so a template is never freed while it's being used.
+class TemplateCache {
+ private:
+  CompiledTemplate _slot[TEMPLATE_CACHE_SLOTS];
+  uint16_t _slotGeneration[TEMPLATE_CACHE_SLOTS] = {0};
+  volatile uint16_t _generation = 1;
+  uint32_t _hits = 0;
+  uint32_t _misses = 0;
+
+ public:
+  TemplateCache() {}
+
+  // Slot is 0 to TEMPLATE_CACHE_SLOTS-1, returns nullptr if the slot needs to
+  // be compiled. The generation passed to put() is the one read before the
+  // template, so a change made while compiling is not missed.
+  const CompiledTemplate* get(int slot);
+  const CompiledTemplate& put(int slot, const char* tpl, uint16_t generation);
+  void invalidate();
+
+  uint16_t getGeneration() const { return _generation; }
+  uint32_t getHits() const { return _hits; }
+  uint32_t getMisses() const { return _misses; }
+};
+
+extern TemplateCache myTemplateCache;
+
+#endif  // SRC_TEMPLATECOMPILER_HPP_
+
+// EOF
@@ -29,18 +29,26 @@
 #include <log.hpp>
 #include <tempsensor.hpp>
 
+// DS18x20 function commands
+constexpr uint8_t DS_CONVERT_T = 0x44;
+constexpr uint8_t DS_READ_SCRATCHPAD = 0xBE;
+constexpr uint8_t DS_WRITE_SCRATCHPAD = 0x4E;
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+RTC_DATA_ATTR RtcTempSensorData myRtcTempSensorData = {0};
+#endif
+
 void TempSensor::setup(int pin, int pin2) {
-  _pin = pin;
-  
-  if (!setupSensor(pin)) {
-    if (pin2 >= 0) {
-      setupSensor(pin2);
-      _pin = pin2;
-    }
+  _pinPrimary = pin;
+  _pinSecondary = pin2;
+
+  if (!restoreSensor()) {
+    discoverSensors();
   }
 
   // Set the temp sensor adjustment values
   _tempSensorAdjC = _tempSensorConfig->getTempSensorAdjC();
+  applyProbeConfig();
 
 #if LOG_LEVEL == 6
   Log.verbose(F("TSEN: Adjustment values for temp sensor %F C." CR),
@@ -50,6 +58,22 @@ void TempSensor::setup(int pin, int pin2) {
   _initialized = true;
 }
 
+bool TempSensor::discoverSensors() {
+  _pin = _pinPrimary;
+
+  if (!setupSensor(_pinPrimary)) {
+    if (_pinSecondary >= 0) {
+      _pin = _pinSecondary;
+      if (!setupSensor(_pinSecondary)) return false;
+    } else {
+      return false;
+    }
+  }
+
+  saveSensor();
+  return true;
+}
+
 bool TempSensor::setupSensor(int pin) {
 #if defined(ESP32)
   gpio_reset_pin((gpio_num_t)pin);
@@ -61,18 +85,39 @@ bool TempSensor::setupSensor(int pin) {
   delayMicroseconds(500);
 #endif
   _onewire.reset(new OneWire(pin));
-  _sensors.reset(new DallasTemperature(_onewire.get()));
+  _sensorCount = 0;
+  _resolution = 0;
 
 #if LOG_LEVEL == 6
   Log.verbose(F("TSEN: Looking for temp sensors." CR));
 #endif
-  _sensors->begin();
 
-  if (_sensors->getDS18Count()) {
+  uint8_t addr[8];
+  _onewire->reset_search();
+
+  while (_sensorCount < TEMP_MAX_SENSORS && _onewire->search(addr)) {
+    if (OneWire::crc8(addr, 7) != addr[7]) {
+      Log.warning(F("TSEN: Ignoring device with invalid ROM CRC on pin=%d" CR),
+                  pin);
+      continue;
+    }
+
+    switch (addr[0]) {
+      case DS18S20MODEL:
+      case DS18B20MODEL:
+      case DS1822MODEL:
+      case DS1825MODEL:
+      case DS28EA00MODEL:
+        memcpy(&_addresses[_sensorCount][0], addr, sizeof(addr));
+        _sensorCount++;
+        break;
+    }
+  }
+
+  if (_sensorCount) {
     Log.notice(
         F("TSEN: Found %d temperature sensor(s). Using %d bit on pin=%d" CR),
-        _sensors->getDS18Count(), _tempSensorConfig->getTempSensorResolution(),
-        pin);
+        _sensorCount, _tempSensorConfig->getTempSensorResolution(), pin);
   } else {
     Log.warning(F("TSEN: No temp sensors found on pin=%d" CR), pin);
     return false;
@@ -81,6 +126,184 @@ bool TempSensor::setupSensor(int pin) {
   return true;
 }
 
+bool TempSensor::restoreSensor() {
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  if (myRtcTempSensorData.IsDataAvailable != TEMP_RTC_DATA_AVAILABLE ||
+      myRtcTempSensorData.Count == 0 ||
+      myRtcTempSensorData.Count > TEMP_MAX_SENSORS ||
+      (myRtcTempSensorData.Pin != _pinPrimary &&
+       myRtcTempSensorData.Pin != _pinSecondary)) {
+    return false;
+  }
+
+  _pin = myRtcTempSensorData.Pin;
+  _onewire.reset(new OneWire(_pin));
+  _sensorCount = myRtcTempSensorData.Count;
+  _resolution = myRtcTempSensorData.Resolution;
+  memcpy(&_addresses[0][0], &myRtcTempSensorData.Address[0][0],
+         sizeof(_addresses));
+
+  Log.notice(F("TSEN: Using %d cached temperature sensor(s) on pin=%d" CR),
+             _sensorCount, _pin);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TempSensor::saveSensor() {
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  myRtcTempSensorData.IsDataAvailable = TEMP_RTC_DATA_AVAILABLE;
+  myRtcTempSensorData.Pin = static_cast<int8_t>(_pin);
+  myRtcTempSensorData.Count = static_cast<uint8_t>(_sensorCount);
+  myRtcTempSensorData.Resolution = static_cast<uint8_t>(_resolution);
+  memcpy(&myRtcTempSensorData.Address[0][0], &_addresses[0][0],
+         sizeof(_addresses));
+#endif
+}
+
+void TempSensor::applyProbeConfig() {
+  for (int i = 0; i < TEMP_MAX_SENSORS; i++) {
+    _probeTempC[i] = NAN;
+    _probeAdjC[i] = 0;
+    _probeWeight[i] = 1;
+  }
+
+  for (int i = 0; i < _sensorCount; i++) {
+    const TempProbeConfig *probe =
+        _tempSensorConfig->getTempProbeConfig(&_addresses[i][0]);
+
+    if (probe) {
+      _probeAdjC[i] = probe->adjC;
+      _probeWeight[i] = probe->weight;
+    }
+
+#if LOG_LEVEL == 6
+    char buf[17];
+    convertTempAddressToString(&_addresses[i][0], &buf[0], sizeof(buf));
+    Log.verbose(F("TSEN: Probe %d address %s, adj %F C, weight %F." CR), i,
+                &buf[0], _probeAdjC[i], _probeWeight[i]);
+#endif
+  }
+}
+
+void TempSensor::invalidateSensor() {
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+  myRtcTempSensorData.IsDataAvailable = 0;
+#endif
+  _sensorCount = 0;
+}
+
+bool TempSensor::readScratchpad(const uint8_t *addr, uint8_t *data) {
+  if (!_onewire->reset()) return false;  // No presence pulse
+
+  _onewire->select(addr);
+  _onewire->write(DS_READ_SCRATCHPAD);
+
+  bool allZero = true;
+
+  for (int i = 0; i < 9; i++) {
+    data[i] = _onewire->read();
+    if (data[i]) allZero = false;
+  }
+
+  // A bus without any device will return all zero which also has a valid CRC
+  return !allZero && OneWire::crc8(data, 8) == data[8];
+}
+
+void TempSensor::writeResolution(const uint8_t *addr, const uint8_t *data,
+                                 int resolution) {
+  if (addr[0] == DS18S20MODEL) return;  // Fixed 9 bit resolution
+
+  if (!_onewire->reset()) return;
+
+  _onewire->select(addr);
+  _onewire->write(DS_WRITE_SCRATCHPAD);
+  _onewire->write(data[2]);  // TH, keep alarm settings
+  _onewire->write(data[3]);  // TL
+  _onewire->write(static_cast<uint8_t>(((resolution - 9) << 5) | 0x1F));
+
+#if LOG_LEVEL == 6
+  Log.verbose(F("TSEN: Changed sensor resolution to %d bits." CR), resolution);
+#endif
+}
+
+bool TempSensor::startConversion(const uint8_t *addr) {
+  if (!_onewire->reset()) return false;
+
+  // With several probes all of them are started at once (SKIP ROM) so the bus
+  // only waits for one conversion.
+  if (addr)
+    _onewire->select(addr);
+  else
+    _onewire->skip();
+
+  _onewire->write(DS_CONVERT_T);
+
+  // The sensor will hold the bus low until the conversion is done, max
+  // conversion time is 750ms at 12 bit and is halved for each bit less.
+  uint32_t start = millis();
+
+  while (!_onewire->read_bit()) {
+    if (millis() - start > 770) return false;
+    delay(1);
+  }
+
+  return true;
+}
+
+bool TempSensor::readProbe(const uint8_t *addr, int resolution, float *tempC) {
+  uint8_t data[9];
+
+  if (!readScratchpad(addr, &data[0])) return false;
+
+  int16_t raw = (static_cast<int16_t>(data[1]) << 8) | data[0];
+
+  if (addr[0] == DS18S20MODEL) {
+    raw = raw << 3;  // 9 bit resolution default
+    if (data[7] == 0x10) {
+      raw = (raw & 0xFFF0) + 12 - data[6];  // Use count remain for 12 bits
+    }
+  } else {
+    int current = 9 + ((data[4] >> 5) & 0x03);
+
+    // Low bits are undefined at lower resolutions
+    raw &= ~((1 << (12 - current)) - 1);
+
+    if (current != resolution) {
+      writeResolution(addr, &data[0], resolution);
+    }
+
+    _resolution = resolution;
+  }
+
+  *tempC = static_cast<float>(raw) / 16.0;
+  return true;
+}
+
+bool TempSensor::readProbes(int resolution) {
+  if (!startConversion(_sensorCount > 1 ? nullptr : &_addresses[0][0]))
+    return false;
+
+  bool success = true;
+
+  for (int i = 0; i < _sensorCount; i++) {
+    float tempC;
+
+    if (readProbe(&_addresses[i][0], resolution, &tempC)) {
+      _probeTempC[i] = tempC + _probeAdjC[i];
+    } else {
+      _probeTempC[i] = NAN;
+      success = false;
+    }
+  }
+
+  _temperatureC =
+      aggregateTemperatures(&_probeTempC[0], &_probeWeight[0], _sensorCount,
+                            _tempSensorConfig->getTempSensorAggregation());
+  return success;
+}
+
 void TempSensor::readSensor(bool useGyro) {
   if (!_initialized) {
     _temperatureC = NAN;
@@ -106,7 +329,7 @@ void TempSensor::readSensor(bool useGyro) {
   }
 
   // If we dont have sensors just return 0
-  if (!_sensors->getDS18Count()) {
+  if (!_sensorCount) {
 #if LOG_LEVEL == 6
     Log.notice(F("TSEN: No temperature sensors found. Skipping read." CR));
 #endif
@@ -115,22 +338,129 @@ void TempSensor::readSensor(bool useGyro) {
   }
 
   // Read the sensors
-  _sensors->setResolution(_tempSensorConfig->getTempSensorResolution());
-  _sensors->requestTemperatures();
+  int resolution = _tempSensorConfig->getTempSensorResolution();
+  bool success = readProbes(resolution);
+
+  if (!success) {
+    // No presence or CRC failure, the cached sensor might have been replaced so
+    // do a new search of the bus.
+    Log.warning(F("TSEN: Failed to read sensor, searching bus again." CR));
+    invalidateSensor();
+
+    if (discoverSensors()) {
+      applyProbeConfig();
+      success = readProbes(resolution);
+    }
+  }
+
+  // A single failing probe is acceptable as long as the others give a value
+  if (!success && !isnan(_temperatureC)) success = true;
 
-  if (_sensors->getDS18Count() >= 1) {
-    _temperatureC = _sensors->getTempCByIndex(0);
+  if (success) {
     _hasSensor = true;
 
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+    myRtcTempSensorData.Resolution = static_cast<uint8_t>(_resolution);
+#endif
+
 #if LOG_LEVEL == 6
     Log.verbose(F("TSEN: Reciving temp value for DS18B20 sensor %F C." CR),
                 _temperatureC);
 #endif
+  } else {
+    _temperatureC = NAN;
+    _hasSensor = false;
   }
 }
 
+float aggregateTemperatures(const float *tempC, const float *weight, int count,
+                            TempSensorAggregation aggregation) {
+  float result = NAN;
+  float sum = 0, weightSum = 0;
+  int valid = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (isnan(tempC[i])) continue;
+
+    if (aggregation == TempSensorAggregation::TEMP_AGGREGATION_FIRST)
+      return tempC[i];
+
+    switch (aggregation) {
+      case TempSensorAggregation::TEMP_AGGREGATION_MIN:
+        if (!valid || tempC[i] < result) result = tempC[i];
+        break;
+      case TempSensorAggregation::TEMP_AGGREGATION_MAX:
+        if (!valid || tempC[i] > result) result = tempC[i];
+        break;
+      case TempSensorAggregation::TEMP_AGGREGATION_WEIGHTED:
+        sum += tempC[i] * weight[i];
+        weightSum += weight[i];
+        break;
+      default:
+        sum += tempC[i];
+        weightSum += 1;
+        break;
+    }
+
+    valid++;
+  }
+
+  if (!valid) return NAN;
+
+  if (aggregation == TempSensorAggregation::TEMP_AGGREGATION_MEAN ||
+      aggregation == TempSensorAggregation::TEMP_AGGREGATION_WEIGHTED) {
+    // All weights zero, fall back to a plain average
+    if (weightSum <= 0) {
+      sum = 0;
+      for (int i = 0; i < count; i++)
+        if (!isnan(tempC[i])) sum += tempC[i];
+      return sum / valid;
+    }
+    return sum / weightSum;
+  }
+
+  return result;
+}
+
+void convertTempAddressToString(const uint8_t *address, char *buf,
+                                size_t size) {
+  snprintf(buf, size, "%02x%02x%02x%02x%02x%02x%02x%02x", address[0],
+           address[1], address[2], address[3], address[4], address[5],
+           address[6], address[7]);
+}
+
+bool convertTempAddressFromString(const char *s, uint8_t *address) {
+  if (!s || strlen(s) != 16) return false;
+
+  for (int i = 0; i < 8; i++) {
+    uint8_t b = 0;
+
+    for (int j = 0; j < 2; j++) {
+      char c = s[i * 2 + j];
+      b <<= 4;
+
+      if (c >= '0' && c <= '9')
+        b |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        b |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        b |= c - 'A' + 10;
+      else
+        return false;
+    }
+
+    address[i] = b;
+  }
+
+  return true;
+}
+
 bool TempSensor::searchForSensors() {
   byte addr[8];
+  if (!_onewire) {
+    Log.error(F("TSEN: No OneWire bus configured" CR));
+    return false;
+  }
   _onewire->reset_search();
   if (!_onewire->search(addr)) {
     Log.error(F("TSEN: No OneWire device found on bus" CR));
@@ -31,20 +31,68 @@
 
 #include <memory>
 
+constexpr auto TEMP_MAX_SENSORS = 4;
+
+#if defined(ESP32) && defined(ENABLE_RTCMEM)
+
+#include <esp_attr.h>
+
+#define TEMP_RTC_DATA_AVAILABLE \
+  static_cast<uint8_t>(106)  // Unique number to flag resume data is available
+
+// Used for the data stored in RTC memory, this allows us to skip the onewire
+// search when waking up from deep sleep.
+struct RtcTempSensorData {
+  uint8_t IsDataAvailable;
+  int8_t Pin;
+  uint8_t Count;
+  uint8_t Resolution;
+  uint8_t Address[TEMP_MAX_SENSORS][8];
+};
+
+extern RTC_DATA_ATTR RtcTempSensorData myRtcTempSensorData;
+
+#endif  // ESP32 && ENABLE_RTCMEM
+
 class SecondayTempSensorInterface {
  public:
   virtual float getInitialSensorTempC() const = 0;
 };
 
+// How the value from several probes are combined into one temperature
+enum TempSensorAggregation {
+  TEMP_AGGREGATION_FIRST = 0,
+  TEMP_AGGREGATION_MEAN = 1,
+  TEMP_AGGREGATION_MIN = 2,
+  TEMP_AGGREGATION_MAX = 3,
+  TEMP_AGGREGATION_WEIGHTED = 4,
+};
+
+// Settings for an individual probe, identified by the ROM address
+struct TempProbeConfig {
+  uint8_t address[8];
+  float adjC;
+  float weight;
+};
+
 class TempSensorConfigInterface {
  public:
   virtual int getTempSensorResolution() const = 0;
   virtual float getTempSensorAdjC() const = 0;
+  virtual TempSensorAggregation getTempSensorAggregation() const = 0;
+  virtual const TempProbeConfig *getTempProbeConfig(
+      const uint8_t *address) const = 0;
 };
 
+// Combine the readings from several probes, NAN values are ignored
+float aggregateTemperatures(const float *tempC, const float *weight, int count,
+                            TempSensorAggregation aggregation);
+void convertTempAddressToString(const uint8_t *address, char *buf,
+                                size_t size);
+bool convertTempAddressFromString(const char *s, uint8_t *address);
+
 class TempSensor {
  private:
-  std::unique_ptr<DallasTemperature> _sensors;
   std::unique_ptr<OneWire> _onewire;
   TempSensorConfigInterface *_tempSensorConfig = nullptr;
   SecondayTempSensorInterface *_secondary = nullptr;
@@ -54,8 +102,29 @@ class TempSensor {
   float _temperatureC = 0;
   bool _initialized = false;
   int _pin = -1;
+  int _pinPrimary = -1;
+  int _pinSecondary = -1;
+
+  uint8_t _addresses[TEMP_MAX_SENSORS][8];
+  float _probeTempC[TEMP_MAX_SENSORS];
+  float _probeAdjC[TEMP_MAX_SENSORS];
+  float _probeWeight[TEMP_MAX_SENSORS];
+  int _sensorCount = 0;
+  int _resolution = 0;
 
+  bool discoverSensors();
   bool setupSensor(int pin);
+  bool restoreSensor();
+  void saveSensor();
+  void invalidateSensor();
+  void applyProbeConfig();
+
+  bool readScratchpad(const uint8_t *addr, uint8_t *data);
+  void writeResolution(const uint8_t *addr, const uint8_t *data,
+                       int resolution);
+  bool startConversion(const uint8_t *addr);
+  bool readProbe(const uint8_t *addr, int resolution, float *tempC);
+  bool readProbes(int resolution);
 
  public:
   explicit TempSensor(TempSensorConfigInterface *tempSensorConfig,
@@ -68,34 +137,34 @@ class TempSensor {
   void readSensor(bool useGyro = false);
   bool isSensorAttached() { return _hasSensor; }
   float getTempC() const { return _temperatureC + _tempSensorAdjC; }
+  float getProbeTempC(int index) const {
+    if (index < 0 || index >= _sensorCount) return NAN;
+    return _probeTempC[index] + _tempSensorAdjC;
+  }
 
-  int getSensorCount() { return _sensors ? _sensors->getDS18Count() : 0; }
+  int getSensorCount() { return _sensorCount; }
   void getSensorAddress(uint8_t *deviceAddress, int index) {
-    if (_sensors) {
-      _sensors->getAddress(deviceAddress, index);
+    if (index >= 0 && index < _sensorCount) {
+      memcpy(deviceAddress, &_addresses[index][0], 8);
     }
   }
-  int getSensorResolution() { return _sensors ? _sensors->getResolution() : 0; }
+  int getSensorResolution() { return _resolution; }
 
   // Returns number of deviations from genuine DS18B20 spec (0 = likely genuine).
   // Uses only documented commands — safe to run on any sensor.
   int checkForCounterfeit(int sensorIndex = 0) {
-    if (!_onewire || !_sensors || _sensors->getDS18Count() == 0) return -1;
-    uint8_t addr[8];
-    if (!_sensors->getAddress(addr, sensorIndex)) return -1;
+    if (!_onewire || sensorIndex >= _sensorCount) return -1;
     DS18B20Checker checker(_onewire.get());
-    return checker.discover(addr);
+    return checker.discover(&_addresses[sensorIndex][0]);
   }
 
   // Classify clone family using undocumented commands.
   // WARNING: may affect calibration of clone sensors.
   const char* classifySensor(int sensorIndex = 0) {
-    if (!_onewire || !_sensors || _sensors->getDS18Count() == 0)
+    if (!_onewire || sensorIndex >= _sensorCount)
       return ds18b20TypeName(DS18B20Type::UNKNOWN);
-    uint8_t addr[8];
-    if (!_sensors->getAddress(addr, sensorIndex)) return ds18b20TypeName(DS18B20Type::UNKNOWN);
     DS18B20Checker checker(_onewire.get());
-    return ds18b20TypeName(checker.classify(addr));
+    return ds18b20TypeName(checker.classify(&_addresses[sensorIndex][0]));
   }
 };
 
@@ -0,0 +1,127 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <log.hpp>
+#include <tlssession.hpp>
+
+TlsSessionCache myTlsSessionCache;
+
+// FNV-1a hash of host and port, ie. the part between :// and the path
+uint32_t getTlsHostHash(const char* url) {
+  const char* p = strstr(url, "://");
+  p = p ? p + 3 : url;
+
+  uint32_t hash = 2166136261u;
+  for (; *p && *p != '/' && *p != '?'; p++) {
+    hash ^= static_cast<uint8_t>(*p);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+#if defined(ESP8266)
+
+uint16_t TlsSessionCache::getChecksum() const {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&_data.Slots[0]);
+  uint16_t sum = 0;
+
+  for (size_t i = 0; i < sizeof(_data.Slots); i++)
+    sum = (sum << 1 | sum >> 15) ^ p[i];
+
+  return sum;
+}
+
+void TlsSessionCache::load() {
+  if (_loaded) return;
+
+  _loaded = true;
+  ESP.rtcUserMemoryRead(TLS_SESSION_RTC_OFFSET,
+                        reinterpret_cast<uint32_t*>(&_data), sizeof(_data));
+
+  if (_data.IsDataAvailable != TLS_SESSION_DATA_AVAILABLE ||
+      _data.Checksum != getChecksum()) {
+    memset(&_data, 0, sizeof(_data));
+    _data.IsDataAvailable = TLS_SESSION_DATA_AVAILABLE;
+  }
+}
+
+void TlsSessionCache::save() {
+  _data.Checksum = getChecksum();
+  ESP.rtcUserMemoryWrite(TLS_SESSION_RTC_OFFSET,
+                         reinterpret_cast<uint32_t*>(&_data), sizeof(_data));
+}
+
+int TlsSessionCache::find(uint32_t host) const {
+  for (int i = 0; i < TLS_SESSION_SLOTS; i++)
+    if (_data.Slots[i].host == host) return i;
+
+  return -1;
+}
+
+bool TlsSessionCache::restore(const char* url, BearSSL::Session* session) {
+  load();
+
+  int i = find(getTlsHostHash(url));
+  if (i < 0 || !_data.Slots[i].params.session_id_len) return false;
+
+  memcpy(session->getSession(), &_data.Slots[i].params,
+         sizeof(br_ssl_session_parameters));
+  return true;
+}
+
+void TlsSessionCache::store(const char* url, BearSSL::Session* session) {
+  load();
+
+  uint32_t host = getTlsHostHash(url);
+  int i = find(host);
+
+  if (i < 0) {
+    i = _data.Next;
+    _data.Next = (_data.Next + 1) % TLS_SESSION_SLOTS;
+  }
+
+  _data.Slots[i].host = host;
+  memcpy(&_data.Slots[i].params, session->getSession(),
+         sizeof(br_ssl_session_parameters));
+  save();
+}
+
+void TlsSessionCache::clear() {
+  memset(&_data, 0, sizeof(_data));
+  _data.IsDataAvailable = TLS_SESSION_DATA_AVAILABLE;
+  _loaded = true;
+  save();
+}
+
+#else
+
+void TlsSessionCache::clear() {}
+
+#endif  // ESP8266
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+// EOF
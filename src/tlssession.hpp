@@ -0,0 +1,92 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_TLSSESSION_HPP_
+#define SRC_TLSSESSION_HPP_
+
+#ifndef ESPFWK_DISABLE_WIFI
+
+#include <Arduino.h>
+
+#if defined(ESP8266)
+#include <WiFiClientSecureBearSSL.h>
+#endif
+
+constexpr auto TLS_SESSION_SLOTS = 3;
+constexpr auto TLS_SESSION_RTC_OFFSET = 32;  // Blocks of 4 bytes
+
+#define TLS_SESSION_DATA_AVAILABLE \
+  static_cast<uint8_t>(109)  // Unique number to flag resume data is available
+
+uint32_t getTlsHostHash(const char* url);
+
+// TLS session parameters per host kept in RTC memory so the next wake can do
+// an abbreviated handshake. Only the BearSSL client on ESP8266 allows the
+// session to be set, the ESP32 client has no api for this so there the
+// cache is always empty.
+class TlsSessionCache {
+ private:
+#if defined(ESP8266)
+  struct Slot {
+    uint32_t host;
+    br_ssl_session_parameters params;
+  };
+
+  struct Data {
+    uint8_t IsDataAvailable;
+    uint8_t Next;
+    uint16_t Checksum;
+    Slot Slots[TLS_SESSION_SLOTS];
+  };
+
+  static_assert(sizeof(Data) <= 512 - TLS_SESSION_RTC_OFFSET * 4,
+                "TLS session cache does not fit in RTC user memory");
+
+  Data _data;
+  bool _loaded = false;
+
+  uint16_t getChecksum() const;
+  void load();
+  void save();
+  int find(uint32_t host) const;
+#endif
+
+ public:
+  TlsSessionCache() {}
+
+#if defined(ESP8266)
+  // Sets the session for the host on the session object, returns true if one
+  // was found so the handshake can be resumed.
+  bool restore(const char* url, BearSSL::Session* session);
+  void store(const char* url, BearSSL::Session* session);
+#endif
+  void clear();
+};
+
+extern TlsSessionCache myTlsSessionCache;
+
+#endif  // ESPFWK_DISABLE_WIFI
+
+#endif  // SRC_TLSSESSION_HPP_
+
+// EOF
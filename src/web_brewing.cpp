@@ -26,9 +26,11 @@
 #include <Wire.h>
 
 #include <config_brewing.hpp>
+#include <gzip.hpp>
 #include <helper.hpp>
 #include <main.hpp>
 #include <perf.hpp>
+#include <pushscheduler.hpp>
 #include <pushtarget.hpp>
 #include <web_brewing.hpp>
 
@@ -54,8 +56,174 @@ extern bool sleepModeAlwaysSkip;
 BrewingWebServer::BrewingWebServer(BrewingConfig *config)
     : BaseWebServer(config) {
   _brewingConfig = config;
+  _tasks.setHandler([this](WebTask t) { runTask(t); });
+#if defined(ESP32)
+  _statusLock = xSemaphoreCreateMutex();
+#endif
 }
 
+// Heap used by a request, sampled while the response is built and sent
+class HeapProbe {
+ private:
+  uint32_t _start;
+  uint32_t _min;
+
+ public:
+  HeapProbe() : _start(ESP.getFreeHeap()), _min(_start) {}
+
+  void sample() {
+    uint32_t free = ESP.getFreeHeap();
+    if (free < _min) _min = free;
+  }
+  uint32_t getPeak() const { return _start - _min; }
+};
+
+// Writes the templates as a json object of url encoded strings directly into
+// the send buffer, the files are read in small blocks so the memory used does
+// not depend on the template size.
+class TemplateJsonStream {
+ private:
+  struct Entry {
+    const char *key;
+    const char *file;
+    const char *tpl;  // Default template in PROGMEM
+  };
+
+  static constexpr int MAX_ENTRIES = 10;
+
+  Entry _entries[MAX_ENTRIES];
+  int _count = 0;
+  int _index = 0;
+  bool _body = false;
+  bool _closed = false;
+  String _text;  // Json around the values
+  size_t _textPos = 0;
+  File _file;
+  const char *_tpl = nullptr;
+  uint8_t _buf[32];
+  size_t _bufLen = 0;
+  size_t _bufPos = 0;
+  size_t _total = 0;
+  HeapProbe _heap;
+
+  void setText(const String &text) {
+    _text = text;
+    _textPos = 0;
+  }
+
+  int next() {
+    if (_tpl) {
+      uint8_t c = pgm_read_byte(_tpl);
+      if (!c) return -1;
+      _tpl++;
+      return c;
+    }
+
+    if (_bufPos == _bufLen) {
+      _bufLen = _file ? _file.read(_buf, sizeof(_buf)) : 0;
+      _bufPos = 0;
+      if (!_bufLen) return -1;
+    }
+
+    return _buf[_bufPos++];
+  }
+
+  void open(const Entry &e) {
+    _file = LittleFS.open(e.file, "r");
+    _tpl = nullptr;
+    _bufLen = _bufPos = 0;
+
+    if (!_file || !_file.size()) {  // Not customized, send the default
+      if (_file) _file.close();
+      _tpl = e.tpl;
+    }
+  }
+
+ public:
+  ~TemplateJsonStream() {
+    if (_file) _file.close();
+  }
+
+  void add(const char *key, const char *file, const char *tpl) {
+    if (_count < MAX_ENTRIES) _entries[_count++] = {key, file, tpl};
+  }
+
+  size_t fill(uint8_t *out, size_t maxLen) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+
+    _heap.sample();
+
+    while (n < maxLen) {
+      if (_textPos < _text.length()) {
+        out[n++] = _text[_textPos++];
+      } else if (_body) {
+        // Room for one encoded character, a small buffer still gets one
+        if (maxLen - n < 3 && n) break;
+
+        int c = next();
+
+        if (c < 0) {
+          if (_file) _file.close();
+          _body = false;
+          setText("\"");
+        } else if (isalnum(c) || c == '-' || c == '_' || c == '.' ||
+                   c == '~') {
+          out[n++] = c;
+        } else if (maxLen - n < 3) {  // Split over the calls
+          const char e[] = {'%', hex[c >> 4], hex[c & 0x0f], 0};
+          setText(e);
+        } else {
+          out[n++] = '%';
+          out[n++] = hex[c >> 4];
+          out[n++] = hex[c & 0x0f];
+        }
+      } else if (_index < _count) {
+        const Entry &e = _entries[_index];
+        setText(String(_index ? "," : "{") + "\"" + e.key + "\":\"");
+        open(e);
+        _index++;
+        _body = true;
+      } else if (!_closed) {
+        setText(_count ? "}" : "{}");
+        _closed = true;
+      } else {
+        break;
+      }
+    }
+
+    _total += n;
+
+    if (!n)
+      Log.notice(F("WEB : Sent %d bytes of templates, heap peak %d bytes." CR),
+                 _total, _heap.getPeak());
+
+    return n;
+  }
+};
+
+// Json response that samples the heap while the document is serialized into
+// the send buffer and logs the peak when the response is done.
+class HeapProbeJsonResponse : public AsyncJsonResponse {
+ private:
+  HeapProbe _heap;
+  const char *_name;
+
+ public:
+  HeapProbeJsonResponse(const HeapProbe &heap, const char *name)
+      : AsyncJsonResponse(false), _heap(heap), _name(name) {}
+
+  ~HeapProbeJsonResponse() {
+    Log.notice(F("WEB : Sent %d bytes of %s, heap peak %d bytes." CR),
+               _contentLength, _name, _heap.getPeak());
+  }
+
+  size_t _fillBuffer(uint8_t *data, size_t len) override {
+    _heap.sample();
+    return AsyncJsonResponse::_fillBuffer(data, len);
+  }
+};
+
 void BrewingWebServer::webHandleConfigRead(AsyncWebServerRequest *request) {
   if (!isAuthenticated(request)) {
     return;
@@ -63,7 +231,11 @@ void BrewingWebServer::webHandleConfigRead(AsyncWebServerRequest *request) {
 
   PERF_BEGIN("webserver-api-config-read");
   Log.notice(F("WEB : webServer callback for /api/config(read)." CR));
-  AsyncJsonResponse *response = new AsyncJsonResponse(false);
+  // The document is serialized straight into the send buffer, the probe is
+  // started first so the document itself is part of the peak
+  HeapProbe heap;
+  HeapProbeJsonResponse *response =
+      new HeapProbeJsonResponse(heap, "configuration");
   JsonObject obj = response->getRoot().as<JsonObject>();
   _webConfig->createJson(obj);
   response->setLength();
@@ -83,6 +255,9 @@ void BrewingWebServer::webHandleConfigWrite(AsyncWebServerRequest *request,
   _webConfig->parseJson(obj);
   obj.clear();
   _webConfig->saveFile();
+  myPushScheduler.saveMirror();  // Flash is written anyway
+  myTemplateCache.invalidate();
+  myBatteryVoltage.reset();
   myBatteryVoltage.read();
 
   doWebConfigWrite();
@@ -103,11 +278,12 @@ void BrewingWebServer::webHandleCalibrate(AsyncWebServerRequest *request) {
 
   PERF_BEGIN("webserver-api-calibrate");
   Log.notice(F("WEB : webServer callback for /api/calibrate." CR));
-  _sensorCalibrationTask = true;
+  bool queued = _tasks.enqueue(WEB_TASK_CALIBRATION);
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   JsonObject obj = response->getRoot().as<JsonObject>();
-  obj[PARAM_SUCCESS] = true;
-  obj[PARAM_MESSAGE] = "Scheduled device calibration";
+  obj[PARAM_SUCCESS] = queued;
+  obj[PARAM_MESSAGE] = queued ? "Scheduled device calibration"
+                              : "Device calibration is already scheduled";
   response->setLength();
   request->send(response);
   PERF_END("webserver-api-calibrate");
@@ -122,6 +298,8 @@ void BrewingWebServer::webHandleFactoryDefaults(
   Log.notice(F("WEB : webServer callback for /api/factory." CR));
   _brewingConfig->saveFileWifiOnly();
   LittleFS.remove(ERR_FILENAME);
+  myPushScheduler.clear();
+  myTemplateCache.invalidate();
 
   LittleFS.remove(TPL_GRAVITY_FNAME_POST);
   LittleFS.remove(TPL_GRAVITY_FNAME_POST2);
@@ -234,6 +412,8 @@ void BrewingWebServer::webHandleConfigFormatWrite(
                                                                             : 0;
   }
 
+  myTemplateCache.invalidate();
+
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   obj = response->getRoot().as<JsonObject>();
   obj[PARAM_SUCCESS] = success > 0 ? true : false;
@@ -253,15 +433,23 @@ void BrewingWebServer::webHandleTestPush(AsyncWebServerRequest *request,
   PERF_BEGIN("webserver-api-test-push");
   Log.notice(F("WEB : webServer callback for /api/test/push." CR));
   JsonObject obj = json.as<JsonObject>();
-  _pushTestTarget = obj[PARAM_PUSH_FORMAT].as<String>();
-  _pushTestTask = true;
-  _pushTestEnabled = false;
-  _pushTestLastSuccess = false;
-  _pushTestLastCode = 0;
+  bool queued = false;
+
+  // The target is read by the running test, only change it when idle
+  if (!_tasks.isQueued(WEB_TASK_PUSH_TEST)) {
+    _pushTestTarget = obj[PARAM_PUSH_FORMAT].as<String>();
+    _pushTestEnabled = false;
+    _pushTestLastSuccess = false;
+    _pushTestLastCode = 0;
+    queued = _tasks.enqueue(WEB_TASK_PUSH_TEST);
+  }
+
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   obj = response->getRoot().as<JsonObject>();
-  obj[PARAM_SUCCESS] = true;
-  obj[PARAM_MESSAGE] = "Scheduled test for " + _pushTestTarget;
+  obj[PARAM_SUCCESS] = queued;
+  obj[PARAM_MESSAGE] = queued ? "Scheduled test for " + _pushTestTarget
+                              : "Push test for " + _pushTestTarget +
+                                    " is already scheduled";
   response->setLength();
   request->send(response);
   PERF_END("webserver-api-test-push");
@@ -273,21 +461,46 @@ void BrewingWebServer::webHandleTestPushStatus(AsyncWebServerRequest *request) {
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   JsonObject obj = response->getRoot().as<JsonObject>();
   String s;
+  bool running = _tasks.isQueued(WEB_TASK_PUSH_TEST);
 
-  if (_pushTestTask)
+  if (running)
     s = "Running push tests for " + _pushTestTarget;
-  else if (!_pushTestTask && _pushTestLastCode == 0)
+  else if (_pushTestLastCode == 0)
     s = "No push test has been started";
-  else if (!_pushTestTask && _pushTestLastCode < 0)
+  else if (_pushTestLastCode < 0)
     s = "Push test has failed";
   else
     s = "Push test for " + _pushTestTarget + " is complete";
 
-  obj[PARAM_STATUS] = static_cast<bool>(_pushTestTask);
+  obj[PARAM_STATUS] = running;
+  addTaskStatus(obj, WEB_TASK_PUSH_TEST);
   obj[PARAM_SUCCESS] = _pushTestLastSuccess;
   obj[PARAM_MESSAGE] = s;
   obj[PARAM_PUSH_ENABLED] = _pushTestEnabled;
   obj[PARAM_PUSH_RETURN_CODE] = _pushTestLastCode;
+  obj[PARAM_TEMPLATE_CACHE_GENERATION] = myTemplateCache.getGeneration();
+  obj[PARAM_TEMPLATE_CACHE_HITS] = myTemplateCache.getHits();
+  obj[PARAM_TEMPLATE_CACHE_MISSES] = myTemplateCache.getMisses();
+
+  // Result of the last push to all targets
+  JsonArray targets = obj[PARAM_PUSH_TARGETS].to<JsonArray>();
+
+  for (int i = 0, j = 0; i < PUSH_TARGETS; i++) {
+    const PushTargetStatus &status =
+        myPushDispatcher.getStatus(static_cast<PushTarget>(i));
+
+    if (!status.used) continue;
+
+    targets[j][PARAM_PUSH_TARGET] =
+        PushDispatcher::getTargetName(static_cast<PushTarget>(i));
+    targets[j][PARAM_STATUS] = status.done;
+    targets[j][PARAM_SUCCESS] = status.success;
+    targets[j][PARAM_PUSH_RETURN_CODE] = status.code;
+    targets[j][PARAM_PUSH_LATENCY] = status.latency;
+    targets[j][PARAM_PUSH_ASYNC] = status.async;
+    j++;
+  }
+
   response->setLength();
   request->send(response);
   PERF_END("webserver-api-test-push-status");
@@ -324,12 +537,21 @@ void BrewingWebServer::webHandleHardwareScan(AsyncWebServerRequest *request) {
   }
 
   Log.notice(F("WEB : webServer callback for /api/hardware." CR));
-  _hardwareScanTask = true;
-  _hardwareScanData = "";
+  bool queued = false;
+
+  // The result is written by the running scan, only clear it when idle
+  if (!_tasks.isQueued(WEB_TASK_HARDWARE_SCAN)) {
+    _tasks.lock();
+    _hardwareScanData = "";
+    _tasks.unlock();
+    queued = _tasks.enqueue(WEB_TASK_HARDWARE_SCAN);
+  }
+
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   JsonObject obj = response->getRoot().as<JsonObject>();
-  obj[PARAM_SUCCESS] = true;
-  obj[PARAM_MESSAGE] = "Scheduled hardware scanning";
+  obj[PARAM_SUCCESS] = queued;
+  obj[PARAM_MESSAGE] = queued ? "Scheduled hardware scanning"
+                              : "Hardware scanning is already scheduled";
   response->setLength();
   request->send(response);
 }
@@ -342,48 +564,51 @@ void BrewingWebServer::webHandleHardwareScanStatus(
 
   Log.notice(F("WEB : webServer callback for /api/hardware/status." CR));
 
-  if (_hardwareScanTask || !_hardwareScanData.length()) {
+  bool running = _tasks.isQueued(WEB_TASK_HARDWARE_SCAN);
+
+  // Written by the scan when it completes, copied under the runner lock
+  _tasks.lock();
+  String data = running ? "" : _hardwareScanData;
+  _tasks.unlock();
+
+  if (!data.length()) {
     AsyncJsonResponse *response = new AsyncJsonResponse(false);
     JsonObject obj = response->getRoot().as<JsonObject>();
-    obj[PARAM_STATUS] = static_cast<bool>(_hardwareScanTask);
+    obj[PARAM_STATUS] = running;
     obj[PARAM_SUCCESS] = false;
     obj[PARAM_MESSAGE] =
-        _hardwareScanTask ? "Hardware scanning running" : "No scanning running";
+        running ? "Hardware scanning running" : "No scanning running";
+    addTaskStatus(obj, WEB_TASK_HARDWARE_SCAN);
     response->setLength();
     request->send(response);
   } else {
-    request->send(200, "application/json", _hardwareScanData);
+    request->send(200, "application/json", data);
   }
 }
 
-String BrewingWebServer::readFile(String fname) {
-  File file = LittleFS.open(fname, "r");
-  if (file) {
-    size_t fileSize = file.size();
-
-    char *buf = reinterpret_cast<char *>(malloc(fileSize + 1));
-    if (buf == nullptr) {
-      Log.error(F("WEB : Failed to allocate %d bytes for file %s." CR),
-                fileSize, fname.c_str());
-      file.close();
-      return "";
-    }
+void BrewingWebServer::webHandleTaskCancel(AsyncWebServerRequest *request) {
+  if (!isAuthenticated(request)) {
+    return;
+  }
 
-    memset(buf, 0, fileSize + 1);
-    size_t bytesRead = file.readBytes(buf, fileSize);
-    file.close();
+  Log.notice(F("WEB : webServer callback for /api/task/cancel." CR));
+  bool busy = _tasks.isBusy();
+  _tasks.cancel();
 
-    if (bytesRead != fileSize) {
-      Log.warning(F("WEB : Only read %d of %d bytes from %s." CR), bytesRead,
-                  fileSize, fname.c_str());
-    }
+  AsyncJsonResponse *response = new AsyncJsonResponse(false);
+  JsonObject obj = response->getRoot().as<JsonObject>();
+  obj[PARAM_SUCCESS] = busy;
+  obj[PARAM_MESSAGE] = busy ? "Cancelled scheduled tasks" : "No task running";
+  response->setLength();
+  request->send(response);
+}
 
-    Log.notice(F("WEB : Read %d bytes from %s." CR), bytesRead, fname.c_str());
-    String result(buf);
-    free(buf);
-    return result;
-  }
-  return "";
+// Progress of the operation and how many are waiting to run, the progress
+// is 0 while it is still queued
+void BrewingWebServer::addTaskStatus(JsonObject &obj, WebTask t) {
+  obj[PARAM_TASK_PROGRESS] =
+      _tasks.getRunning() == t ? _tasks.getProgress() : 0;
+  obj[PARAM_TASK_QUEUED] = _tasks.getQueued();
 }
 
 void BrewingWebServer::webHandleConfigFormatRead(
@@ -395,50 +620,41 @@ void BrewingWebServer::webHandleConfigFormatRead(
   PERF_BEGIN("webserver-api-config-format-read");
   Log.notice(F("WEB : webServer callback for /api/config/format(read)." CR));
 
-  AsyncJsonResponse *response = new AsyncJsonResponse(false);
-  JsonObject obj = response->getRoot().as<JsonObject>();
-  String s;
+  std::shared_ptr<TemplateJsonStream> stream =
+      std::make_shared<TemplateJsonStream>();
 
 #if defined(GRAVITYMON) || defined(GATEWAY)
-  s = readFile(TPL_GRAVITY_FNAME_POST);
-  obj[PARAM_FORMAT_POST_GRAVITY] =
-      s.length() ? urlencode(s) : urlencode(String(&iGravityHttpPostFormat[0]));
-  s = readFile(TPL_GRAVITY_FNAME_POST2);
-  obj[PARAM_FORMAT_POST2_GRAVITY] =
-      s.length() ? urlencode(s) : urlencode(String(&iGravityHttpPostFormat[0]));
-  s = readFile(TPL_GRAVITY_FNAME_GET);
-  obj[PARAM_FORMAT_GET_GRAVITY] =
-      s.length() ? urlencode(s) : urlencode(String(&iGravityHttpGetFormat[0]));
-  s = readFile(TPL_GRAVITY_FNAME_INFLUXDB);
-  obj[PARAM_FORMAT_INFLUXDB_GRAVITY] =
-      s.length() ? urlencode(s) : urlencode(String(&iGravityInfluxDbFormat[0]));
-  s = readFile(TPL_GRAVITY_FNAME_MQTT);
-  obj[PARAM_FORMAT_MQTT_GRAVITY] =
-      s.length() ? urlencode(s) : urlencode(String(&iGravityMqttFormat[0]));
+  stream->add(PARAM_FORMAT_POST_GRAVITY, TPL_GRAVITY_FNAME_POST,
+              &iGravityHttpPostFormat[0]);
+  stream->add(PARAM_FORMAT_POST2_GRAVITY, TPL_GRAVITY_FNAME_POST2,
+              &iGravityHttpPostFormat[0]);
+  stream->add(PARAM_FORMAT_GET_GRAVITY, TPL_GRAVITY_FNAME_GET,
+              &iGravityHttpGetFormat[0]);
+  stream->add(PARAM_FORMAT_INFLUXDB_GRAVITY, TPL_GRAVITY_FNAME_INFLUXDB,
+              &iGravityInfluxDbFormat[0]);
+  stream->add(PARAM_FORMAT_MQTT_GRAVITY, TPL_GRAVITY_FNAME_MQTT,
+              &iGravityMqttFormat[0]);
 #endif
 
 #if defined(PRESSUREMON) || defined(GATEWAY)
-  s = readFile(TPL_PRESSURE_FNAME_POST);
-  obj[PARAM_FORMAT_POST_PRESSURE] =
-      s.length() ? urlencode(s)
-                 : urlencode(String(&iPressureHttpPostFormat[0]));
-  s = readFile(TPL_PRESSURE_FNAME_POST2);
-  obj[PARAM_FORMAT_POST2_PRESSURE] =
-      s.length() ? urlencode(s)
-                 : urlencode(String(&iPressureHttpPostFormat[0]));
-  s = readFile(TPL_PRESSURE_FNAME_GET);
-  obj[PARAM_FORMAT_GET_PRESSURE] =
-      s.length() ? urlencode(s) : urlencode(String(&iPressureHttpGetFormat[0]));
-  s = readFile(TPL_PRESSURE_FNAME_INFLUXDB);
-  obj[PARAM_FORMAT_INFLUXDB_PRESSURE] =
-      s.length() ? urlencode(s)
-                 : urlencode(String(&iPressureInfluxDbFormat[0]));
-  s = readFile(TPL_PRESSURE_FNAME_MQTT);
-  obj[PARAM_FORMAT_MQTT_PRESSURE] =
-      s.length() ? urlencode(s) : urlencode(String(&iPressureMqttFormat[0]));
+  stream->add(PARAM_FORMAT_POST_PRESSURE, TPL_PRESSURE_FNAME_POST,
+              &iPressureHttpPostFormat[0]);
+  stream->add(PARAM_FORMAT_POST2_PRESSURE, TPL_PRESSURE_FNAME_POST2,
+              &iPressureHttpPostFormat[0]);
+  stream->add(PARAM_FORMAT_GET_PRESSURE, TPL_PRESSURE_FNAME_GET,
+              &iPressureHttpGetFormat[0]);
+  stream->add(PARAM_FORMAT_INFLUXDB_PRESSURE, TPL_PRESSURE_FNAME_INFLUXDB,
+              &iPressureInfluxDbFormat[0]);
+  stream->add(PARAM_FORMAT_MQTT_PRESSURE, TPL_PRESSURE_FNAME_MQTT,
+              &iPressureMqttFormat[0]);
 #endif
 
-  response->setLength();
+  // The stream is owned by the response and closes the file when it is done
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/json",
+      [stream](uint8_t *buf, size_t maxLen, size_t) -> size_t {
+        return stream->fill(buf, maxLen);
+      });
   request->send(response);
   PERF_END("webserver-api-config-format-read");
 }
@@ -485,8 +701,52 @@ void BrewingWebServer::webHandleStatus(AsyncWebServerRequest *request) {
     ESP_RESET();
   }
 
-  AsyncJsonResponse *response = new AsyncJsonResponse(false);
-  JsonObject obj = response->getRoot().as<JsonObject>();
+  std::shared_ptr<const StatusSnapshot> status = std::atomic_load(&_status);
+
+  // While polled the snapshot is rebuilt in loop(), after a pause it is
+  // rebuilt here so the first poll does not get old values
+  if (!status || millis() - _statusBuildMillis >= STATUS_ACTIVE_TIME ||
+      (_statusStale && millis() - _statusPollMillis >= STATUS_ACTIVE_TIME)) {
+    buildStatus();
+    status = std::atomic_load(&_status);
+  }
+
+  _statusPollMillis = millis();
+
+  if (request->hasHeader("If-None-Match") &&
+      request->header("If-None-Match") == status->etag) {
+    request->send(304);
+    PERF_END("webserver-api-status");
+    return;
+  }
+
+  // The snapshot is kept by the response until it has been sent, so a rebuild
+  // in the meantime does not change the body
+  AsyncWebServerResponse *response = request->beginResponse(
+      "application/json", status->body.length(),
+      [status](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        size_t len = status->body.length() - index;
+        if (len > maxLen) len = maxLen;
+        memcpy(buf, status->body.c_str() + index, len);
+        return len;
+      });
+
+  response->addHeader("ETag", status->etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+  PERF_END("webserver-api-status");
+}
+
+// Builds the status document and replaces the snapshot, the etag only changes
+// when the content apart from free heap and rssi does so unchanged polls get a
+// 304
+void BrewingWebServer::buildStatus() {
+#if defined(ESP32)
+  xSemaphoreTake(_statusLock, portMAX_DELAY);
+#endif
+  PERF_BEGIN("webserver-build-status");
+  JsonDocument doc;
+  JsonObject obj = doc.to<JsonObject>();
 
   obj[PARAM_ID] = _webConfig->getID();
   obj[PARAM_TEMP_UNIT] = String(_brewingConfig->getTempUnit());
@@ -495,16 +755,13 @@ void BrewingWebServer::webHandleStatus(AsyncWebServerRequest *request) {
   obj[PARAM_SLEEP_MODE] = sleepModeAlwaysSkip;
   obj[PARAM_BATTERY] =
       serialized(String(myBatteryVoltage.getVoltage(), DECIMALS_BATTERY));
-  obj[PARAM_RSSI] = WiFi.RSSI();
   obj[PARAM_SSID] = WiFi.SSID();
 
 #if defined(ESP8266)
   obj[PARAM_TOTAL_HEAP] = 81920;
-  obj[PARAM_FREE_HEAP] = ESP.getFreeHeap();
   obj[PARAM_IP] = WiFi.localIP().toString();
 #else
   obj[PARAM_TOTAL_HEAP] = ESP.getHeapSize();
-  obj[PARAM_FREE_HEAP] = ESP.getFreeHeap();
   obj[PARAM_IP] = WiFi.localIP().toString();
 #endif
   obj[PARAM_WIFI_SETUP] = (runMode == RunMode::wifiSetupMode) ? true : false;
@@ -513,11 +770,54 @@ void BrewingWebServer::webHandleStatus(AsyncWebServerRequest *request) {
 
   obj[PARAM_SELF][PARAM_SELF_BATTERY_LEVEL] = v < 3.2 || v > 5.1 ? false : true;
 
+  float percent = getBatteryPercentage(v, _brewingConfig->getBatteryType());
+  BatteryEstimator estimator(_brewingConfig, &myBatteryEstimatorData);
+  obj[PARAM_BATTERY_PERCENT] = percent;
+  obj[PARAM_BATTERY_DAYS] = serialized(String(
+      estimator.getRemainingDays(percent, _brewingConfig->getSleepInterval()),
+      1));
+
   doWebStatus(obj);
 
-  response->setLength();
-  request->send(response);
-  PERF_END("webserver-api-status");
+  std::shared_ptr<StatusSnapshot> status = std::make_shared<StatusSnapshot>();
+
+  // Free heap and rssi differ on almost every build so they are added after
+  // the checksum, a 304 keeps the values from the last full response
+  serializeJson(doc, status->body);
+  status->crc =
+      getCrc32(reinterpret_cast<const uint8_t *>(status->body.c_str()),
+               status->body.length());
+
+  obj[PARAM_RSSI] = WiFi.RSSI();
+  obj[PARAM_FREE_HEAP] = ESP.getFreeHeap();
+  status->body = String();
+  serializeJson(doc, status->body);
+
+  std::shared_ptr<const StatusSnapshot> last = std::atomic_load(&_status);
+
+  if (last && last->crc == status->crc) {
+    status->etag = last->etag;
+  } else {
+    // Random start so etags from before a reboot do not match
+    if (!_statusGeneration) {
+#if defined(ESP8266)
+      _statusGeneration = RANDOM_REG32;
+#else
+      _statusGeneration = esp_random();
+#endif
+    }
+
+    status->etag = "\"" + String(++_statusGeneration, HEX) + "\"";
+  }
+
+  std::atomic_store(&_status,
+                    std::shared_ptr<const StatusSnapshot>(std::move(status)));
+  _statusBuildMillis = millis();
+  _statusStale = false;
+  PERF_END("webserver-build-status");
+#if defined(ESP32)
+  xSemaphoreGive(_statusLock);
+#endif
 }
 
 void BrewingWebServer::webHandleCalibrateStatus(
@@ -530,11 +830,13 @@ void BrewingWebServer::webHandleCalibrateStatus(
   Log.notice(F("WEB : webServer callback for /api/calibrate/status." CR));
   AsyncJsonResponse *response = new AsyncJsonResponse(false);
   JsonObject obj = response->getRoot().as<JsonObject>();
-  obj[PARAM_STATUS] = static_cast<bool>(_sensorCalibrationTask);
+  bool running = _tasks.isQueued(WEB_TASK_CALIBRATION);
+  obj[PARAM_STATUS] = running;
   obj[PARAM_SUCCESS] = false;
   obj[PARAM_MESSAGE] = "Calibration running";
+  addTaskStatus(obj, WEB_TASK_CALIBRATION);
 
-  if (!_sensorCalibrationTask) {
+  if (!running) {
     doWebCalibrateStatus(obj);
   }
 
@@ -547,6 +849,7 @@ bool BrewingWebServer::setupWebServer(const char *serviceName) {
   Log.notice(F("WEB : Configuring web server." CR));
 
   BaseWebServer::setupWebServer();
+  _assets.begin(_server);
   MDNS.addService(serviceName, "tcp", 80);
   MDNS.addServiceTxt(serviceName, "tcp", "ver", CFG_APPVER);
   MDNS.addServiceTxt(serviceName, "tcp", "app", CFG_APPNAME);
@@ -591,6 +894,10 @@ bool BrewingWebServer::setupWebServer(const char *serviceName) {
               [this](AsyncWebServerRequest *request) {
                 webHandleHardwareScan(request);
               });
+  _server->on("/api/task/cancel", (WebRequestMethodComposite)HTTP_GET,
+              [this](AsyncWebServerRequest *request) {
+                webHandleTaskCancel(request);
+              });
   _server->on("/api/factory", (WebRequestMethodComposite)HTTP_GET,
               [this](AsyncWebServerRequest *request) {
                 webHandleFactoryDefaults(request);
@@ -619,123 +926,151 @@ void BrewingWebServer::loop() {
 #endif
   BaseWebServer::loop();
 
-  if (_sensorCalibrationTask) {
-    doTaskSensorCalibration();
-    _sensorCalibrationTask = false;
-  }
-
-  if (_pushTestTask) {
-    TemplatingEngine engine;
-    BrewingPush push(_brewingConfig);
-
-    doTaskPushTestSetup(engine, push);
-
-    _pushTestLastSuccess = push.getLastSuccess();
-    _pushTestLastCode = push.getLastCode();
-    if (_pushTestEnabled)
-      Log.notice(
-          F("WEB : Scheduled push test %s completed, success=%d, code=%d" CR),
-          _pushTestTarget.c_str(), _pushTestLastSuccess, _pushTestLastCode);
-    else
-      Log.notice(F("WEB : Scheduled push test %s failed, not enabled" CR),
-                 _pushTestTarget.c_str());
-    _pushTestTask = false;
-  }
-
-  if (_hardwareScanTask) {
-    JsonDocument doc;
-    JsonObject obj = doc.to<JsonObject>();
-
-    obj[PARAM_STATUS] = false;
-    obj[PARAM_SUCCESS] = true;
-    obj[PARAM_MESSAGE] = "";
-    Log.notice(F("WEB : Scanning hardware." CR));
-
-    // Scan the i2c bus for devices, initialized in gyro.cpp
-    JsonArray i2c = obj[PARAM_I2C].to<JsonArray>();
-
-    for (int i = 1, j = 0; i < 128 && j < 32; i++) {  // Limit to max 32 devices
-      // Abort if we get a timeout error (5)
-      // The i2c_scanner uses the return value of
-      // the Write.endTransmisstion to see if
-      // a device did acknowledge to the address.
-      Wire.beginTransmission(i);
-      int err = Wire.endTransmission();
-
-      // Log.notice(F("WEB : Scanning 0x%x, response %d." CR), i, err);
-      char addr_str[8];
-      snprintf(addr_str, sizeof(addr_str), "0x%x", i);
-
-      if (err == 0) {
-        Log.notice(F("WEB : Found device at %s." CR), addr_str);
-        i2c[j][PARAM_ADRESS] = addr_str;
-        i2c[j][PARAM_BUS] = "Wire";
-        j++;
-      } else if (err == 5) {
-        Log.notice(F("WEB : Timeout error at %s." CR), addr_str);
-        i2c[j][PARAM_ADRESS] = addr_str;
-        i2c[j][PARAM_BUS] = "Timeout error, aborting scan";
-        j++;
-        break;
-      } else {
-        // Ignore the other errors, we are just scanning for devices
-      }
+  // Rebuilt here instead of in the request so polls from several clients
+  // share one document and the async task is not blocked by the formulas
+  if (_statusStale && std::atomic_load(&_status) &&
+      millis() - _statusPollMillis < STATUS_ACTIVE_TIME &&
+      millis() - _statusBuildMillis >= STATUS_MIN_AGE)
+    buildStatus();
+
+  _tasks.loop();
+}
+
+void BrewingWebServer::runTask(WebTask t) {
+  switch (t) {
+    case WEB_TASK_CALIBRATION:
+      doTaskSensorCalibration();
+      break;
+    case WEB_TASK_PUSH_TEST:
+      runPushTest();
+      break;
+    case WEB_TASK_HARDWARE_SCAN:
+      runHardwareScan();
+      break;
+    default:
+      break;
+  }
+}
+
+void BrewingWebServer::runPushTest() {
+  TemplateValues values;
+  BrewingPush push(_brewingConfig);
+
+  doTaskPushTestSetup(values, push);
+
+  _pushTestLastSuccess = push.getLastSuccess();
+  _pushTestLastCode = push.getLastCode();
+  if (_pushTestEnabled)
+    Log.notice(
+        F("WEB : Scheduled push test %s completed, success=%d, code=%d" CR),
+        _pushTestTarget.c_str(), _pushTestLastSuccess, _pushTestLastCode);
+  else
+    Log.notice(F("WEB : Scheduled push test %s failed, not enabled" CR),
+               _pushTestTarget.c_str());
+}
+
+void BrewingWebServer::runHardwareScan() {
+  JsonDocument doc;
+  JsonObject obj = doc.to<JsonObject>();
+
+  obj[PARAM_STATUS] = false;
+  obj[PARAM_SUCCESS] = true;
+  obj[PARAM_MESSAGE] = "";
+  Log.notice(F("WEB : Scanning hardware." CR));
+
+  // Scan the i2c bus for devices, initialized in gyro.cpp
+  JsonArray i2c = obj[PARAM_I2C].to<JsonArray>();
+
+  for (int i = 1, j = 0; i < 128 && j < 32; i++) {  // Limit to max 32 devices
+    if (_tasks.isCancelled()) return;
+    _tasks.setProgress(i * 50 / 128);
+
+    // Abort if we get a timeout error (5)
+    // The i2c_scanner uses the return value of
+    // the Write.endTransmisstion to see if
+    // a device did acknowledge to the address.
+    Wire.beginTransmission(i);
+    int err = Wire.endTransmission();
+
+    // Log.notice(F("WEB : Scanning 0x%x, response %d." CR), i, err);
+    char addr_str[8];
+    snprintf(addr_str, sizeof(addr_str), "0x%x", i);
+
+    if (err == 0) {
+      Log.notice(F("WEB : Found device at %s." CR), addr_str);
+      i2c[j][PARAM_ADRESS] = addr_str;
+      i2c[j][PARAM_BUS] = "Wire";
+      j++;
+    } else if (err == 5) {
+      Log.notice(F("WEB : Timeout error at %s." CR), addr_str);
+      i2c[j][PARAM_ADRESS] = addr_str;
+      i2c[j][PARAM_BUS] = "Timeout error, aborting scan";
+      j++;
+      break;
+    } else {
+      // Ignore the other errors, we are just scanning for devices
     }
+  }
 
-    JsonObject cpu = obj[PARAM_CHIP].to<JsonObject>();
+  JsonObject cpu = obj[PARAM_CHIP].to<JsonObject>();
 
 #if defined(ESP8266)
-    cpu[PARAM_FAMILY] = "ESP8266";
+  cpu[PARAM_FAMILY] = "ESP8266";
 #else
-    esp_chip_info_t chip_info;
-    esp_chip_info(&chip_info);
-
-    cpu[PARAM_REVISION] = chip_info.revision;
-    cpu[PARAM_CORES] = chip_info.cores;
-
-    JsonArray feature = cpu[PARAM_FEATURES].to<JsonArray>();
-
-    if (chip_info.features & CHIP_FEATURE_EMB_FLASH)
-      feature.add("Embedded flash");
-    if (chip_info.features & CHIP_FEATURE_WIFI_BGN) feature.add("2.4Ghz WIFI");
-    if (chip_info.features & CHIP_FEATURE_BLE) feature.add("Bluetooth LE");
-    if (chip_info.features & CHIP_FEATURE_BT) feature.add("Bluetooth Classic");
-    if (chip_info.features & CHIP_FEATURE_IEEE802154)
-      feature.add("IEEE 802.15.4/LR-WPAN");
-    if (chip_info.features & CHIP_FEATURE_EMB_PSRAM)
-      feature.add("Embedded PSRAM");
-    if (heap_caps_get_free_size(MALLOC_CAP_RTCRAM) > 0) {
-      feature.add("Embedded RTC RAM");
-    }
+  esp_chip_info_t chip_info;
+  esp_chip_info(&chip_info);
+
+  cpu[PARAM_REVISION] = chip_info.revision;
+  cpu[PARAM_CORES] = chip_info.cores;
+
+  JsonArray feature = cpu[PARAM_FEATURES].to<JsonArray>();
+
+  if (chip_info.features & CHIP_FEATURE_EMB_FLASH)
+    feature.add("Embedded flash");
+  if (chip_info.features & CHIP_FEATURE_WIFI_BGN) feature.add("2.4Ghz WIFI");
+  if (chip_info.features & CHIP_FEATURE_BLE) feature.add("Bluetooth LE");
+  if (chip_info.features & CHIP_FEATURE_BT) feature.add("Bluetooth Classic");
+  if (chip_info.features & CHIP_FEATURE_IEEE802154)
+    feature.add("IEEE 802.15.4/LR-WPAN");
+  if (chip_info.features & CHIP_FEATURE_EMB_PSRAM)
+    feature.add("Embedded PSRAM");
+  if (heap_caps_get_free_size(MALLOC_CAP_RTCRAM) > 0) {
+    feature.add("Embedded RTC RAM");
+  }
 
-    switch (chip_info.model) {
-      case CHIP_ESP32:
-        cpu[PARAM_FAMILY] = "ESP32";
-        break;
-      case CHIP_ESP32S2:
-        cpu[PARAM_FAMILY] = "ESP32S2";
-        break;
-      case CHIP_ESP32S3:
-        cpu[PARAM_FAMILY] = "ESP32S3";
-        break;
-      case CHIP_ESP32C3:
-        cpu[PARAM_FAMILY] = "ESP32C3";
-        break;
-      case CHIP_ESP32H2:
-        cpu[PARAM_FAMILY] = "ESP32H2";
-        break;
-      default:
-        cpu[PARAM_FAMILY] = String(chip_info.model);
-        break;
-    }
+  switch (chip_info.model) {
+    case CHIP_ESP32:
+      cpu[PARAM_FAMILY] = "ESP32";
+      break;
+    case CHIP_ESP32S2:
+      cpu[PARAM_FAMILY] = "ESP32S2";
+      break;
+    case CHIP_ESP32S3:
+      cpu[PARAM_FAMILY] = "ESP32S3";
+      break;
+    case CHIP_ESP32C3:
+      cpu[PARAM_FAMILY] = "ESP32C3";
+      break;
+    case CHIP_ESP32H2:
+      cpu[PARAM_FAMILY] = "ESP32H2";
+      break;
+    default:
+      cpu[PARAM_FAMILY] = String(chip_info.model);
+      break;
+  }
 #endif
 
-    doTaskHardwareScanning(obj);
+  if (_tasks.isCancelled()) return;
+  _tasks.setProgress(50);  // The onewire and sensor scan is the slow part
 
-    serializeJson(obj, _hardwareScanData);
-    Log.notice(F("WEB : Scan complete %s." CR), _hardwareScanData.c_str());
-    _hardwareScanTask = false;
-  }
+  doTaskHardwareScanning(obj);
+
+  String data;
+  serializeJson(obj, data);
+  Log.notice(F("WEB : Scan complete %s." CR), data.c_str());
+  _tasks.lock();
+  _hardwareScanData = data;
+  _tasks.unlock();
 }
 
 #endif  // ESPFWK_DISABLE_WEBSERVER
@@ -28,12 +28,17 @@
 
 #include <basewebserver.hpp>
 #include <battery.hpp>
+#include <memory>
 #include <pushtarget.hpp>
 #include <templating.hpp>
+#include <webassets.hpp>
+#include <webtask.hpp>
 
 constexpr auto PARAM_HARDWARE = "hardware";
 constexpr auto PARAM_SLEEP_MODE = "sleep_mode";
 constexpr auto PARAM_BATTERY = "battery";
+constexpr auto PARAM_BATTERY_PERCENT = "battery_percent";
+constexpr auto PARAM_BATTERY_DAYS = "battery_days";
 constexpr auto PARAM_APP_VER = "app_ver";
 constexpr auto PARAM_APP_BUILD = "app_build";
 constexpr auto PARAM_PLATFORM = "platform";
@@ -71,17 +76,44 @@ constexpr auto PARAM_FORMAT_MQTT_PRESSURE = "mqtt_format_pressure";
 constexpr auto PARAM_PUSH_FORMAT = "push_format";
 constexpr auto PARAM_PUSH_RETURN_CODE = "push_return_code";
 constexpr auto PARAM_PUSH_ENABLED = "push_enabled";
+constexpr auto PARAM_PUSH_TARGETS = "push_targets_status";
+constexpr auto PARAM_PUSH_TARGET = "target";
+constexpr auto PARAM_PUSH_LATENCY = "latency";
+constexpr auto PARAM_PUSH_ASYNC = "async";
+constexpr auto PARAM_TEMPLATE_CACHE_GENERATION = "template_cache_generation";
+constexpr auto PARAM_TEMPLATE_CACHE_HITS = "template_cache_hits";
+constexpr auto PARAM_TEMPLATE_CACHE_MISSES = "template_cache_misses";
+constexpr auto PARAM_TASK_PROGRESS = "task_progress";
+constexpr auto PARAM_TASK_QUEUED = "task_queued";
+
+constexpr auto STATUS_ACTIVE_TIME = 5000;  // ms since the last poll
+constexpr auto STATUS_MIN_AGE = 1000;      // ms between rebuilds
+
+// Serialized /api/status document, shared with the responses that send it
+struct StatusSnapshot {
+  String body;
+  String etag;
+  uint32_t crc;  // Of the body without free heap and rssi
+};
 
 class BrewingWebServer : public BaseWebServer {
  protected:
   BrewingConfig *_brewingConfig = nullptr;
 
-  volatile bool _sensorCalibrationTask = false;
-  volatile bool _pushTestTask = false;
-  volatile bool _hardwareScanTask = false;
-
   String _hardwareScanData;
 
+  WebTaskRunner _tasks;
+  WebAssets _assets;
+
+  std::shared_ptr<const StatusSnapshot> _status;
+  uint32_t _statusGeneration = 0;
+  volatile uint32_t _statusPollMillis = 0;
+  uint32_t _statusBuildMillis = 0;
+  volatile bool _statusStale = true;
+#if defined(ESP32)
+  SemaphoreHandle_t _statusLock = nullptr;  // Built from async_tcp and loop()
+#endif
+
   String _pushTestTarget;
   int _pushTestLastCode;
   bool _pushTestLastSuccess, _pushTestEnabled;
@@ -101,12 +133,19 @@ class BrewingWebServer : public BaseWebServer {
   void webHandleFactoryDefaults(AsyncWebServerRequest *request);
   void webHandleHardwareScan(AsyncWebServerRequest *request);
   void webHandleHardwareScanStatus(AsyncWebServerRequest *request);
+  void webHandleTaskCancel(AsyncWebServerRequest *request);
+
+  void addTaskStatus(JsonObject &obj, WebTask t);
+  void runTask(WebTask t);
+  void runPushTest();
+  void runHardwareScan();
+
+  void buildStatus();
 
-  String readFile(String fname);
   bool writeFile(String fname, String data);
 
   virtual void doTaskSensorCalibration() = 0;
-  virtual void doTaskPushTestSetup(TemplatingEngine &engine,
+  virtual void doTaskPushTestSetup(TemplateValues &values,
                                    BrewingPush &push) = 0;
   virtual void doTaskHardwareScanning(JsonObject &obj) = 0;
 
@@ -120,6 +159,14 @@ class BrewingWebServer : public BaseWebServer {
 
   virtual bool setupWebServer(const char *serviceName);
   virtual void loop();
+
+  // Called when the sensors have been read, the status document is rebuilt in
+  // loop() while clients are polling
+  void setStatusStale() { _statusStale = true; }
+
+  // True while an operation started from the web ui is queued or running,
+  // the sensors and push targets are then owned by that operation
+  bool isTaskBusy() const { return _tasks.isBusy(); }
 };
 
 #endif  // ESPFWK_DISABLE_WEBSERVER
@@ -44,9 +44,20 @@ constexpr auto PARAM_GYRO = "gyro";
 constexpr auto PARAM_GYRO_FAMILY = "gyro_family";
 constexpr auto PARAM_ONEWIRE = "onewire";
 constexpr auto PARAM_TEMP_SENSOR = "temp_sensor";
+constexpr auto PARAM_TEMP_PROBES = "temp_probes";
 constexpr auto PARAM_DS18B20_DETECTED = "ds18b20_detected";
 constexpr auto PARAM_DS18B20_COUNTERFEIT = "ds18b20_counterfeit";
 constexpr auto PARAM_DS18B20_TYPE = "ds18b20_type";
+constexpr auto PARAM_ACTION = "action";
+constexpr auto PARAM_RUNNING = "running";
+constexpr auto PARAM_SAMPLES = "samples";
+constexpr auto PARAM_BUCKETS = "buckets";
+constexpr auto PARAM_TEMP_MIN = "temp_min";
+constexpr auto PARAM_TEMP_MAX = "temp_max";
+constexpr auto PARAM_GYRO_TEMP = "gyro_temp";
+constexpr auto PARAM_RAW_DRIFT = "raw_drift";
+constexpr auto PARAM_RESIDUAL_DRIFT = "residual_drift";
+constexpr auto PARAM_COMPENSATION = "compensation";
 
 constexpr auto PARAM_FEATURE_BLE_SUPPORTED = "ble";
 constexpr auto PARAM_FEATURE_FILTER_SUPPORTED = "filter";
@@ -139,6 +150,24 @@ void GravitymonWebServer::doWebStatus(JsonObject &obj) {
     }
   }
 
+  JsonArray probes = obj[PARAM_TEMP_PROBES].to<JsonArray>();
+
+  for (int i = 0; i < myTempSensor.getSensorCount(); i++) {
+    uint8_t adr[8];
+    char buf[17];
+    float probeC = myTempSensor.getProbeTempC(i);
+
+    myTempSensor.getSensorAddress(&adr[0], i);
+    convertTempAddressToString(&adr[0], &buf[0], sizeof(buf));
+    probes[i][PARAM_ADRESS] = buf;
+
+    if (!isnan(probeC)) {
+      probes[i][PARAM_TEMP] = serialized(
+          String(_gravConfig->isTempFormatC() ? probeC : convertCtoF(probeC),
+                 DECIMALS_TEMP));
+    }
+  }
+
   obj[PARAM_GRAVITYMON1_CONFIG] = LittleFS.exists("/gravitymon.json");
   obj[PARAM_GYRO_FAMILY] = myGyro.getGyroFamily();
 
@@ -169,7 +198,7 @@ void GravitymonWebServer::doTaskSensorCalibration() {
   }
 }
 
-void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
+void GravitymonWebServer::doTaskPushTestSetup(TemplateValues &values,
                                               BrewingPush &push) {
   // When runnning in configuration mode we dont apply the filter on the angle
   float angle = myGyro.getAngle();
@@ -183,7 +212,7 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     gravitySG = corrGravitySG;
   }
 
-  setupTemplateEngineGravity(_gravConfig, engine, angle, 0, gravitySG,
+  setupTemplateEngineGravity(_gravConfig, values, angle, 0, gravitySG,
                              corrGravitySG, tempC, 1.0,
                              myBatteryVoltage.getVoltage());
 
@@ -192,8 +221,8 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
 
   if (!_pushTestTarget.compareTo(PARAM_FORMAT_POST_GRAVITY) &&
       _gravConfig->hasTargetHttpPost()) {
-    String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1);
-    String doc = engine.create(tpl.c_str());
+    String doc =
+        push.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1, values);
 
     if (_gravConfig->isHttpPostSSL() && _gravConfig->isSkipSslOnTest())
       Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
@@ -202,8 +231,8 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     _pushTestEnabled = true;
   } else if (!_pushTestTarget.compareTo(PARAM_FORMAT_POST2_GRAVITY) &&
              _gravConfig->hasTargetHttpPost2()) {
-    String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP2);
-    String doc = engine.create(tpl.c_str());
+    String doc =
+        push.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP2, values);
     if (_gravConfig->isHttpPost2SSL() && _gravConfig->isSkipSslOnTest())
       Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
     else
@@ -211,8 +240,8 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     _pushTestEnabled = true;
   } else if (!_pushTestTarget.compareTo(PARAM_FORMAT_GET_GRAVITY) &&
              _gravConfig->hasTargetHttpGet()) {
-    String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP3);
-    String doc = engine.create(tpl.c_str());
+    String doc =
+        push.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP3, values);
     if (_gravConfig->isHttpGetSSL() && _gravConfig->isSkipSslOnTest())
       Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
     else
@@ -220,8 +249,8 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     _pushTestEnabled = true;
   } else if (!_pushTestTarget.compareTo(PARAM_FORMAT_INFLUXDB_GRAVITY) &&
              _gravConfig->hasTargetInfluxDb2()) {
-    String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_INFLUX);
-    String doc = engine.create(tpl.c_str());
+    String doc =
+        push.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_INFLUX, values);
     if (_gravConfig->isHttpInfluxDb2SSL() && _gravConfig->isSkipSslOnTest())
       Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
     else
@@ -229,8 +258,8 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     _pushTestEnabled = true;
   } else if (!_pushTestTarget.compareTo(PARAM_FORMAT_MQTT_GRAVITY) &&
              _gravConfig->hasTargetMqtt()) {
-    String tpl = push.getTemplate(BrewingPush::GRAVITY_TEMPLATE_MQTT);
-    String doc = engine.create(tpl.c_str());
+    String doc =
+        push.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_MQTT, values);
     if (_gravConfig->isMqttSSL() && _gravConfig->isSkipSslOnTest())
       Log.notice(F("PUSH: SSL enabled, skip run when not in gravity mode." CR));
     else
@@ -238,7 +267,6 @@ void GravitymonWebServer::doTaskPushTestSetup(TemplatingEngine &engine,
     _pushTestEnabled = true;
   }
 
-  engine.freeMemory();
   push.clearTemplate();
 }
 
@@ -318,9 +346,115 @@ void GravitymonWebServer::webHandleGyro(AsyncWebServerRequest *request) {
   request->send(response);
 }
 
+void GravitymonWebServer::webHandleGyroTempComp(AsyncWebServerRequest *request,
+                                                JsonVariant &json) {
+  if (!isAuthenticated(request)) {
+    return;
+  }
+
+  Log.notice(F("WEB : webServer callback for /api/gyro/tempcomp." CR));
+  JsonObject obj = json.as<JsonObject>();
+  String action = obj[PARAM_ACTION].as<String>();
+  bool success = true;
+  String message;
+
+  if (action == "start") {
+    myGyro.startTempCompCalibration();
+    message = "Temperature compensation calibration started";
+  } else if (action == "stop") {
+    GyroTempCompCalibration *cal = myGyro.getTempCompCalibration();
+    GyroTempCompensation comp;
+
+    if (cal && cal->fit(&comp)) {
+      Log.notice(F("WEB : Gyro temp drift %F deg/C, residual %F deg/C." CR),
+                 cal->getRawDriftPerC(), cal->getResidualDriftPerC());
+      _gravConfig->setGyroTempCompensation(comp);
+      _gravConfig->saveFile();
+      message = "Temperature compensation stored";
+    } else {
+      success = false;
+      message = "Not enough data, need a temperature span of at least 3C";
+    }
+
+    myGyro.stopTempCompCalibration();
+  } else if (action == "clear") {
+    myGyro.stopTempCompCalibration();
+    _gravConfig->setGyroTempCompensation({0, 0, 0, NAN});
+    _gravConfig->saveFile();
+    message = "Temperature compensation removed";
+  } else {
+    success = false;
+    message = "Unknown action";
+  }
+
+  AsyncJsonResponse *response = new AsyncJsonResponse(false);
+  obj = response->getRoot().as<JsonObject>();
+  obj[PARAM_SUCCESS] = success;
+  obj[PARAM_MESSAGE] = message;
+  response->setLength();
+  request->send(response);
+}
+
+void GravitymonWebServer::webHandleGyroTempCompStatus(
+    AsyncWebServerRequest *request) {
+  Log.notice(F("WEB : webServer callback for /api/gyro/tempcomp/status." CR));
+
+  AsyncJsonResponse *response = new AsyncJsonResponse(false);
+  JsonObject obj = response->getRoot().as<JsonObject>();
+  GyroTempCompCalibration *cal = myGyro.getTempCompCalibration();
+
+  obj[PARAM_RUNNING] = cal ? true : false;
+  obj[PARAM_GYRO_TEMP] =
+      serialized(String(myGyro.getSensorTempC(), DECIMALS_TEMP));
+
+  if (cal) {
+    obj[PARAM_SAMPLES] = cal->getNoSamples();
+    obj[PARAM_BUCKETS] = cal->getNoBuckets();
+
+    if (cal->getNoBuckets()) {
+      obj[PARAM_TEMP_MIN] =
+          serialized(String(cal->getMinTempC(), DECIMALS_TEMP));
+      obj[PARAM_TEMP_MAX] =
+          serialized(String(cal->getMaxTempC(), DECIMALS_TEMP));
+    }
+
+    // Preview of the result without storing it
+    GyroTempCompensation comp;
+    if (cal->fit(&comp)) {
+      obj[PARAM_RAW_DRIFT] = serialized(String(cal->getRawDriftPerC(), 4));
+      obj[PARAM_RESIDUAL_DRIFT] =
+          serialized(String(cal->getResidualDriftPerC(), 4));
+    }
+  }
+
+  const GyroTempCompensation &comp = _gravConfig->getGyroTempCompensation();
+
+  if (comp.isActive()) {
+    obj[PARAM_COMPENSATION]["ref"] = comp.refTempC;
+    obj[PARAM_COMPENSATION]["c1"] = comp.c1;
+    obj[PARAM_COMPENSATION]["c2"] = comp.c2;
+    if (!isnan(comp.residualDrift))
+      obj[PARAM_COMPENSATION][PARAM_RESIDUAL_DRIFT] =
+          serialized(String(comp.residualDrift, 4));
+  }
+
+  response->setLength();
+  request->send(response);
+}
+
 bool GravitymonWebServer::setupWebServer(const char *serviceName) {
   BrewingWebServer::setupWebServer(serviceName);
 
+  // Sub paths must be registered before /api/gyro since that will match them
+  _server->on("/api/gyro/tempcomp/status", (WebRequestMethodComposite)HTTP_GET,
+              [this](AsyncWebServerRequest *request) {
+                webHandleGyroTempCompStatus(request);
+              });
+  AsyncCallbackJsonWebHandler *handler = new AsyncCallbackJsonWebHandler(
+      "/api/gyro/tempcomp",
+      std::bind(&GravitymonWebServer::webHandleGyroTempComp, this,
+                std::placeholders::_1, std::placeholders::_2));
+  _server->addHandler(handler);
   _server->on(
       "/api/gyro", (WebRequestMethodComposite)HTTP_GET,
       [this](AsyncWebServerRequest *request) { webHandleGyro(request); });
@@ -38,7 +38,7 @@ class GravitymonWebServer : public BrewingWebServer {
   bool _gyroCalibrationSuccess = false;
 
   void doTaskSensorCalibration();
-  void doTaskPushTestSetup(TemplatingEngine &engine, BrewingPush &push);
+  void doTaskPushTestSetup(TemplateValues &values, BrewingPush &push);
   void doTaskHardwareScanning(JsonObject &obj);
 
   void doWebStatus(JsonObject &obj);
@@ -53,6 +53,8 @@ class GravitymonWebServer : public BrewingWebServer {
   virtual bool setupWebServer(const char *serviceName);
 
   void webHandleGyro(AsyncWebServerRequest *request);
+  void webHandleGyroTempComp(AsyncWebServerRequest *request, JsonVariant &json);
+  void webHandleGyroTempCompStatus(AsyncWebServerRequest *request);
 };
 
 // Global instance created
@@ -0,0 +1,202 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <log.hpp>
+#include <webassets.hpp>
+
+#if defined(ESP32)
+// Created by board_build.embed_txtfiles, weak since the unit test build does
+// not embed the files. A null is added after the content.
+extern const uint8_t indexHtmlStart[] asm(
+    "_binary_html_index_html_start") __attribute__((weak));
+extern const uint8_t indexHtmlEnd[] asm(
+    "_binary_html_index_html_end") __attribute__((weak));
+extern const uint8_t appJsStart[] asm(
+    "_binary_html_app_js_gz_start") __attribute__((weak));
+extern const uint8_t appJsEnd[] asm(
+    "_binary_html_app_js_gz_end") __attribute__((weak));
+extern const uint8_t appCssStart[] asm(
+    "_binary_html_app_css_gz_start") __attribute__((weak));
+extern const uint8_t appCssEnd[] asm(
+    "_binary_html_app_css_gz_end") __attribute__((weak));
+#endif
+
+int parseAssetRange(const char* header, size_t size, size_t* start,
+                    size_t* len) {
+  *start = 0;
+  *len = size;
+
+  if (strncmp(header, "bytes=", 6) || strchr(header, ',')) return 200;
+
+  const char* p = header + 6;
+  char* end;
+
+  if (*p == '-') {  // The last n bytes
+    size_t n = strtoul(p + 1, &end, 10);
+    if (end == p + 1 || *end) return 200;
+    if (!n || !size) return 416;
+    if (n > size) n = size;
+
+    *start = size - n;
+    *len = n;
+    return 206;
+  }
+
+  size_t first = strtoul(p, &end, 10);
+  if (end == p || *end != '-') return 200;
+
+  p = end + 1;
+  size_t last = size - 1;
+
+  if (*p) {
+    last = strtoul(p, &end, 10);
+    if (end == p || *end || last < first) return 200;
+  }
+
+  if (first >= size) return 416;
+  if (last >= size) last = size - 1;
+
+  *start = first;
+  *len = last - first + 1;
+  return 206;
+}
+
+// FNV-1a, only used to detect changed content between firmware versions
+static uint32_t getAssetHash(const uint8_t* data, size_t size) {
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+void WebAssets::setAsset(Asset* asset, const uint8_t* data, size_t size,
+                         const char* ext, const char* type, bool gzip) {
+  char hash[9];
+  snprintf(hash, sizeof(hash), "%08x", getAssetHash(data, size));
+
+  asset->data = data;
+  asset->size = size;
+  asset->type = type;
+  asset->gzip = gzip;
+  asset->cache = ASSET_CACHE_IMMUTABLE;
+  asset->path = String(ASSET_PATH) + "app." + hash + ext;
+  asset->etag = String("\"") + hash + "\"";
+}
+
+bool WebAssets::begin(AsyncWebServer* server) {
+#if defined(ESP32)
+  if (!indexHtmlStart || !appJsStart || !appCssStart) return false;
+
+  uint32_t start = millis();
+
+  setAsset(&_js, appJsStart, appJsEnd - appJsStart - 1, ".js",
+           "application/javascript", true);
+  setAsset(&_css, appCssStart, appCssEnd - appCssStart - 1, ".css",
+           "text/css", true);
+
+  _indexHtml = reinterpret_cast<const char*>(indexHtmlStart);
+
+  if (_indexHtml.indexOf("\"/js/app.js\"") < 0 ||
+      _indexHtml.indexOf("\"/css/app.css\"") < 0) {
+    Log.warning(F("WEB : Index does not refer to the ui files, using the "
+                  "framework handlers." CR));
+    _indexHtml = "";
+    return false;
+  }
+
+  _indexHtml.replace("\"/js/app.js\"", "\"" + _js.path + "\"");
+  _indexHtml.replace("\"/css/app.css\"", "\"" + _css.path + "\"");
+
+  setAsset(&_index, reinterpret_cast<const uint8_t*>(_indexHtml.c_str()),
+           _indexHtml.length(), ".html", "text/html", false);
+  _index.path = String(ASSET_PATH) + "index.html";
+  _index.cache = ASSET_CACHE_REVALIDATE;
+
+  for (const Asset* asset : {&_index, &_js, &_css}) {
+    server->on(asset->path.c_str(), HTTP_GET,
+               [this, asset](AsyncWebServerRequest* request) {
+                 send(request, *asset);
+               });
+  }
+
+  server->rewrite("/", _index.path.c_str());
+  server->rewrite("/index.html", _index.path.c_str());
+
+  Log.notice(F("WEB : Serving %s and %s, hashed in %dms." CR),
+             _js.path.c_str(), _css.path.c_str(), millis() - start);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void WebAssets::send(AsyncWebServerRequest* request, const Asset& asset) {
+  AsyncWebServerResponse* response;
+
+  if (request->hasHeader("If-None-Match") &&
+      request->header("If-None-Match") == asset.etag) {
+    response = request->beginResponse(304);
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", asset.cache);
+    request->send(response);
+    return;
+  }
+
+  size_t start = 0, len = asset.size;
+  int code = 200;
+
+  if (request->hasHeader("Range"))
+    code = parseAssetRange(request->header("Range").c_str(), asset.size,
+                           &start, &len);
+
+  if (code == 416) {
+    response = request->beginResponse(416);
+    response->addHeader("Content-Range", "bytes */" + String(asset.size));
+    request->send(response);
+    return;
+  }
+
+  // The content is in flash or in a member, so it is not copied
+  response = request->beginResponse(code, asset.type, asset.data + start, len);
+
+  if (code == 206)
+    response->addHeader("Content-Range", "bytes " + String(start) + "-" +
+                                             String(start + len - 1) + "/" +
+                                             String(asset.size));
+
+  if (asset.gzip) response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("Accept-Ranges", "bytes");
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", asset.cache);
+  request->send(response);
+}
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+// EOF
@@ -0,0 +1,80 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_WEBASSETS_HPP_
+#define SRC_WEBASSETS_HPP_
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+constexpr auto ASSET_PATH = "/ui/";
+constexpr auto ASSET_CACHE_IMMUTABLE = "public, max-age=31536000, immutable";
+constexpr auto ASSET_CACHE_REVALIDATE = "no-cache";
+
+// Returns the status for a Range header, 206 with the range set, 416 if it is
+// outside the content or 200 if the header is ignored and the full content
+// should be sent. Only a single byte range is supported.
+int parseAssetRange(const char* header, size_t size, size_t* start,
+                    size_t* len);
+
+// Serves the ui files embedded in the firmware under names that contain a
+// hash of the content, so the browser can cache them until the firmware is
+// updated instead of downloading them on every connect. The index is
+// rewritten to refer to the hashed names and is revalidated with an etag.
+// Without the embedded files (ESP8266) the framework serves the ui.
+class WebAssets {
+ private:
+  struct Asset {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const char* type = "";
+    const char* cache = "";
+    bool gzip = false;
+    String path;
+    String etag;
+  };
+
+  Asset _index;
+  Asset _js;
+  Asset _css;
+  String _indexHtml;
+
+  void setAsset(Asset* asset, const uint8_t* data, size_t size,
+                const char* ext, const char* type, bool gzip);
+  void send(AsyncWebServerRequest* request, const Asset& asset);
+
+ public:
+  WebAssets() {}
+
+  // Returns false if the files are not embedded or the index does not refer
+  // to them, the framework handlers are then used
+  bool begin(AsyncWebServer* server);
+};
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+#endif  // SRC_WEBASSETS_HPP_
+
+// EOF
@@ -0,0 +1,161 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <log.hpp>
+#include <webtask.hpp>
+
+#if defined(ESP32)
+WebTaskRunner::WebTaskRunner() { _mutex = xSemaphoreCreateMutex(); }
+
+void WebTaskRunner::lock() const { xSemaphoreTake(_mutex, portMAX_DELAY); }
+void WebTaskRunner::unlock() const { xSemaphoreGive(_mutex); }
+#else
+WebTaskRunner::WebTaskRunner() {}
+
+void WebTaskRunner::lock() const {}
+void WebTaskRunner::unlock() const {}
+#endif
+
+bool WebTaskRunner::find(WebTask t) const {
+  if (_running == t) return true;
+
+  for (int i = 0; i < _count; i++)
+    if (_queue[(_head + i) % WEB_TASK_QUEUE_SIZE] == t) return true;
+
+  return false;
+}
+
+bool WebTaskRunner::isQueued(WebTask t) const {
+  lock();
+  bool found = find(t);
+  unlock();
+  return found;
+}
+
+bool WebTaskRunner::enqueue(WebTask t) {
+  lock();
+
+  if (_count >= WEB_TASK_QUEUE_SIZE || find(t)) {
+    unlock();
+    return false;
+  }
+
+  _queue[(_head + _count) % WEB_TASK_QUEUE_SIZE] = t;
+  _count++;
+
+#if defined(ESP32)
+  bool start = !_taskRunning;
+  _taskRunning = true;
+  unlock();
+
+  if (start && xTaskCreate(taskMain, "webtask", WEB_TASK_STACK_SIZE, this, 1,
+                           nullptr) != pdPASS) {
+    Log.error(F("WEB : Failed to start the task for %d." CR), t);
+
+    // Nothing runs the queue without the task
+    lock();
+    _count = 0;
+    _taskRunning = false;
+    unlock();
+    return false;
+  }
+#else
+  unlock();
+#endif
+
+  return true;
+}
+
+WebTask WebTaskRunner::pop() {
+  WebTask t = WEB_TASK_NONE;
+
+  lock();
+  if (_count) {
+    t = _queue[_head];
+    _head = (_head + 1) % WEB_TASK_QUEUE_SIZE;
+    _count--;
+    _running = t;  // Set under the lock so isBusy() never sees a gap
+  }
+  unlock();
+
+  return t;
+}
+
+void WebTaskRunner::run(WebTask t) {
+  uint32_t start = millis();
+
+  _progress = 0;
+  _cancel = false;
+  Log.notice(F("WEB : Running task %d, %d queued." CR), t, _count);
+
+  if (_handler) _handler(t);
+
+  Log.notice(F("WEB : Task %d %s after %dms." CR), t,
+             _cancel ? "cancelled" : "completed", millis() - start);
+  _progress = 100;
+  _running = WEB_TASK_NONE;
+}
+
+void WebTaskRunner::cancel() {
+  lock();
+  _count = 0;
+  _cancel = _running != WEB_TASK_NONE;
+  unlock();
+}
+
+#if defined(ESP32)
+void WebTaskRunner::taskMain(void* arg) {
+  WebTaskRunner* runner = reinterpret_cast<WebTaskRunner*>(arg);
+
+  while (true) {
+    WebTask t = runner->pop();
+
+    if (t == WEB_TASK_NONE) {
+      runner->lock();
+      if (runner->_count) {  // Queued after pop()
+        runner->unlock();
+        continue;
+      }
+      runner->_taskRunning = false;
+      runner->unlock();
+      vTaskDelete(nullptr);
+      return;
+    }
+
+    runner->run(t);
+  }
+}
+
+void WebTaskRunner::loop() {}
+#else
+void WebTaskRunner::loop() {
+  WebTask t = pop();
+  if (t != WEB_TASK_NONE) run(t);
+}
+#endif
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+// EOF
@@ -0,0 +1,102 @@
+/*
+ * GravityMon
+ * Copyright (c) 2021-2026 Magnus
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Alternatively, this software may be used under the terms of a
+ * commercial license. See LICENSE_COMMERCIAL for details.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef SRC_WEBTASK_HPP_
+#define SRC_WEBTASK_HPP_
+
+#ifndef ESPFWK_DISABLE_WEBSERVER
+
+#include <Arduino.h>
+
+#include <functional>
+
+constexpr auto WEB_TASK_QUEUE_SIZE = 4;
+constexpr auto WEB_TASK_STACK_SIZE = 8192;  // Same as the loop task, for TLS
+
+enum WebTask {
+  WEB_TASK_NONE = 0,
+  WEB_TASK_CALIBRATION = 1,
+  WEB_TASK_PUSH_TEST = 2,
+  WEB_TASK_HARDWARE_SCAN = 3,
+};
+
+// Runs the long operations started from the web ui one at a time, so the
+// loop keeps serving wifi and the web server while they run. On ESP32 they
+// run in a worker task that is created when there is work and deleted when
+// the queue is empty. On ESP8266 there are no tasks, the next operation is
+// run from loop() and the web server is served when it yields. The operation
+// reports progress and checks for cancel between its steps.
+class WebTaskRunner {
+ public:
+  typedef std::function<void(WebTask)> Handler;
+
+ private:
+  Handler _handler;
+  WebTask _queue[WEB_TASK_QUEUE_SIZE];
+  int _head = 0;
+  int _count = 0;
+  volatile WebTask _running = WEB_TASK_NONE;
+  volatile int _progress = 0;
+  volatile bool _cancel = false;
+#if defined(ESP32)
+  bool _taskRunning = false;  // Cleared by the task itself when it ends
+  SemaphoreHandle_t _mutex = nullptr;
+
+  static void taskMain(void* arg);
+#endif
+
+  bool find(WebTask t) const;
+  WebTask pop();
+  void run(WebTask t);
+
+ public:
+  WebTaskRunner();
+
+  void setHandler(Handler h) { _handler = h; }
+
+  // Also used for data that the operation hands over to the web handlers
+  void lock() const;
+  void unlock() const;
+
+  // Returns false if the queue is full, the operation is already queued or
+  // the task could not be started
+  bool enqueue(WebTask t);
+  void loop();
+
+  // Drops the queued operations and asks the running one to stop
+  void cancel();
+  bool isCancelled() const { return _cancel; }
+
+  void setProgress(int percent) { _progress = percent; }
+  int getProgress() const { return _progress; }
+  WebTask getRunning() const { return _running; }
+  int getQueued() const { return _count; }
+  bool isBusy() const { return _running != WEB_TASK_NONE || _count > 0; }
+  bool isQueued(WebTask t) const;
+};
+
+#endif  // ESPFWK_DISABLE_WEBSERVER
+
+#endif  // SRC_WEBTASK_HPP_
+
+// EOF
@@ -1,4 +1,4 @@
-import unittest, requests, json, time, urllib3
+import unittest, requests, json, re, time, urllib3
 
 ver  = "2.0.0"
 
@@ -755,6 +755,49 @@ class API(unittest.TestCase):
         self.assertEqual(j["success"], True)
         self.assertNotEqual(j["message"], "")
         self.assertNotEqual(j["gravity_formula"], "")
+
+    def test_64_status_etag(self):
+        r = call_api_get( "/api/status" )
+        self.assertEqual(r.status_code, 200)
+        etag = r.headers["ETag"]
+
+        # Unchanged document, the device answers without a body
+        r = requests.get( "http://" + host + "/api/status", headers={ **headers, "If-None-Match": etag })
+        self.assertEqual(r.status_code, 304)
+        self.assertEqual(r.text, "")
+
+    def test_65_ui_assets(self):
+        r = requests.get( "http://" + host + "/" )
+        self.assertEqual(r.status_code, 200)
+        self.assertEqual(r.headers["Cache-Control"], "no-cache")
+        r = requests.get( "http://" + host + "/", headers={ "If-None-Match": r.headers["ETag"] } )
+        self.assertEqual(r.status_code, 304)
+        r = requests.get( "http://" + host + "/" )
+        js = re.search(r'src="(/ui/app\.[0-9a-f]{8}\.js)"', r.text).group(1)
+        r = requests.get( "http://" + host + js, headers={ "Range": "bytes=0-99" }, stream=True )
+        self.assertEqual(r.status_code, 206)
+        self.assertEqual(r.headers["Content-Length"], "100")
+        self.assertIn("immutable", r.headers["Cache-Control"])
+        r = requests.get( "http://" + host + js, headers={ "If-None-Match": r.headers["ETag"] } )
+        self.assertEqual(r.status_code, 304)
+
+    def test_66_task_cancel(self):
+        r = call_api_get( "/api/hardware" )
+        self.assertEqual(r.status_code, 200)
+        j = json.loads(r.text)
+        self.assertEqual(j["success"], True)
+        r = call_api_get( "/api/hardware" )
+        j = json.loads(r.text)
+        self.assertEqual(j["success"], False) # Already scheduled
+        r = call_api_get( "/api/task/cancel" )
+        if debugResult: print(r.text)
+        self.assertEqual(r.status_code, 200)
+        time.sleep(2)
+        r = call_api_get( "/api/hardware/status" )
+        if debugResult: print(r.text)
+        j = json.loads(r.text)
+        self.assertEqual(j["status"], False)
+        self.assertEqual(j["task_queued"], 0)
                
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,119 @@
+"""Local InfluxDB v2 write api stand-in that validates the line protocol.
+
+  python3 influx_server.py --port 8086
+
+Set the InfluxDB v2 target to http://<ip of computer>:8086. Each request is
+decompressed if it uses gzip, every line is parsed and the points are
+logged. Invalid lines are answered with 400 like the real server does.
+"""
+import argparse, gzip, http.server, re, time
+
+NUMBER = re.compile(r"^-?\d+(\.\d+)?([eE][-+]?\d+)?$")
+
+
+def split(s, sep):
+    """Splits on sep outside of quotes and not escaped with a backslash."""
+    parts, cur, quoted, i = [], "", False, 0
+    while i < len(s):
+        c = s[i]
+        if c == "\\" and i + 1 < len(s):
+            cur += s[i:i + 2]
+            i += 2
+            continue
+        if c == '"':
+            quoted = not quoted
+        if c == sep and not quoted:
+            parts.append(cur)
+            cur = ""
+        else:
+            cur += c
+        i += 1
+    parts.append(cur)
+    return parts
+
+
+def unescape(s):
+    return re.sub(r"\\(.)", r"\1", s)
+
+
+def parse_line(line):
+    """Returns (measurement, tags, fields, timestamp) or raises ValueError."""
+    parts = split(line, " ")
+    if len(parts) not in (2, 3):
+        raise ValueError("expected 2 or 3 space separated parts, got %d" % len(parts))
+
+    series = split(parts[0], ",")
+    measurement, tags = unescape(series[0]), {}
+    for t in series[1:]:
+        kv = split(t, "=")
+        if len(kv) != 2 or not kv[0] or not kv[1]:
+            raise ValueError("invalid tag '%s'" % t)
+        tags[unescape(kv[0])] = unescape(kv[1])
+    if list(tags) != sorted(tags):
+        print("  note: tags are not sorted")
+
+    fields = {}
+    for f in split(parts[1], ","):
+        kv = split(f, "=")
+        if len(kv) != 2 or not kv[0]:
+            raise ValueError("invalid field '%s'" % f)
+        v = kv[1]
+        if v.startswith('"') and v.endswith('"') and len(v) >= 2:
+            fields[unescape(kv[0])] = unescape(v[1:-1])
+        elif NUMBER.match(v):
+            fields[unescape(kv[0])] = float(v)
+        elif re.match(r"^-?\d+[iu]$", v) or v in ("t", "f", "true", "false", "T", "F"):
+            fields[unescape(kv[0])] = v
+        else:
+            raise ValueError("invalid field value '%s'" % v)
+
+    timestamp = None
+    if len(parts) == 3:
+        if not re.match(r"^\d{19}$", parts[2]):
+            raise ValueError("timestamp '%s' is not in ns" % parts[2])
+        timestamp = int(parts[2]) // 1000000000
+
+    return measurement, tags, fields, timestamp
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        encoding = self.headers.get("Content-Encoding", "")
+
+        if encoding == "gzip":
+            body = gzip.decompress(body)
+
+        text, error = body.decode(), None
+        for n, line in enumerate(text.split("\n")):
+            if not line:
+                continue
+            try:
+                m, tags, fields, ts = parse_line(line)
+                when = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(ts)) if ts else "server time"
+                print("  %s %s %s (%s)" % (m, tags, fields, when))
+            except ValueError as e:
+                error = "line %d: %s" % (n + 1, e)
+                break
+
+        self.log_message("%s %d points, %d bytes sent, %d bytes line protocol, %s",
+                         self.path.split("?")[0], len([l for l in text.split("\n") if l]),
+                         length, len(body), error or "ok")
+        self.send_response(400 if error else 204)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port", type=int, default=8086)
+    args = parser.parse_args()
+
+    server = http.server.HTTPServer(("0.0.0.0", args.port), Handler)
+    print(time.strftime("%H:%M:%S"), "Listening on port", args.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+"""Minimal MQTT broker stand-in for comparing the mqtt push implementations.
+
+It accepts any CONNECT, answers with CONNACK after an optional delay to
+simulate a remote broker, and logs for each connection how many packets and
+TCP reads were received and how long the device kept the connection open.
+
+  python3 mqtt_broker.py --port 1883 --delay 50
+
+Set the MQTT target to the ip of the computer. A pipelined push shows all
+packets in one or two reads with "pipelined=True", the connection time is
+then close to one round trip independent of the number of topics.
+"""
+import argparse, socket, threading, time
+
+
+def read_packet(data, i):
+    """Returns (type, body, next index) or None when incomplete."""
+    if i + 2 > len(data):
+        return None
+    length, mult, j = 0, 1, i + 1
+    while True:
+        if j >= len(data):
+            return None
+        b = data[j]
+        length += (b & 127) * mult
+        mult *= 128
+        j += 1
+        if not b & 128:
+            break
+    if j + length > len(data):
+        return None
+    return data[i] >> 4, data[j:j + length], j + length
+
+
+def handle(conn, addr, delay):
+    start = time.time()
+    data, i, reads, publish = b"", 0, 0, 0
+    connack_at, first_publish, pipelined = None, None, False
+
+    conn.settimeout(10)
+    try:
+        while True:
+            chunk = conn.recv(4096)
+            if not chunk:
+                break
+            reads += 1
+            data += chunk
+
+            while True:
+                p = read_packet(data, i)
+                if not p:
+                    break
+                t, body, i = p
+                if t == 1:  # CONNECT
+                    time.sleep(delay / 1000)
+                    conn.sendall(b"\x20\x02\x00\x00")
+                    connack_at = time.time()
+                elif t == 3:  # PUBLISH
+                    publish += 1
+                    tl = body[0] << 8 | body[1]
+                    if first_publish is None:
+                        first_publish = time.time()
+                        pipelined = connack_at is None or reads == 1
+                    print("  %s = %s" % (body[2:2 + tl].decode(), body[2 + tl:].decode(errors="replace")))
+                elif t == 14:  # DISCONNECT
+                    raise EOFError
+    except (EOFError, socket.timeout, ConnectionError):
+        pass
+    finally:
+        conn.close()
+
+    print("%s %s publish=%d reads=%d pipelined=%s connected=%.0fms" % (
+        time.strftime("%H:%M:%S"), addr[0], publish, reads, pipelined,
+        (time.time() - start) * 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--delay", type=int, default=0, help="ms before CONNACK")
+    args = parser.parse_args()
+
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("0.0.0.0", args.port))
+    server.listen(5)
+    print(time.strftime("%H:%M:%S"), "Listening on port", args.port)
+
+    while True:
+        conn, addr = server.accept()
+        threading.Thread(target=handle, args=(conn, addr, args.delay), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,52 @@
+"""Measures loading the ui the way a browser does, first without a cache and
+then revalidating with the etags from the first load.
+
+  python3 page_load.py --host 192.168.1.160 --count 5
+
+Run it against the old firmware first to get the baseline, it then only
+reports the cold loads since the files have no etag. A warm load should
+only transfer the index and get 304 for the hashed files.
+"""
+import argparse, re, time
+
+import requests
+
+
+def load(session, host, etags):
+    start = time.time()
+    total = 0
+    r = session.get("http://%s/" % host, headers=etags.get("/", {}))
+    total += int(r.headers.get("Content-Length", len(r.content)))
+    if r.status_code == 200:
+        etags["/"] = {"If-None-Match": r.headers["ETag"]} if "ETag" in r.headers else {}
+        etags["index"] = r.text
+    codes = [r.status_code]
+
+    for path in re.findall(r'(?:src|href)="(/[^"]+\.(?:js|css))"', etags.get("index", "")):
+        r = session.get("http://%s%s" % (host, path), headers=etags.get(path, {}))
+        total += int(r.headers.get("Content-Length", len(r.content)))
+        codes.append(r.status_code)
+        if "ETag" in r.headers:
+            etags[path] = {"If-None-Match": r.headers["ETag"]}
+
+    return time.time() - start, total, codes
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--count", type=int, default=5)
+    args = parser.parse_args()
+
+    for name, keep in (("cold", False), ("warm", True)):
+        etags = {}
+        for i in range(args.count):
+            if not keep:
+                etags = {}
+            with requests.Session() as session:
+                t, size, codes = load(session, args.host, etags)
+            print("%s %d: %5dms %7d bytes %s" % (name, i, t * 1000, size, codes))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,43 @@
+"""Client for the telemetry websocket, prints the frames sent by the device.
+
+  pip install websocket-client
+  python3 telemetry_client.py --host 192.168.1.160 --every 5
+
+The device must be in configuration mode. With --slow the client sleeps
+between reads to show that frames are dropped instead of queued, the
+sequence numbers then have gaps.
+"""
+import argparse, struct, time
+
+import websocket
+
+FRAME = struct.Struct("<BBHhhHH")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--every", type=int, default=1)
+    parser.add_argument("--slow", type=float, default=0)
+    args = parser.parse_args()
+
+    ws = websocket.create_connection("ws://%s/ws/telemetry" % args.host)
+    ws.send(str(args.every))
+    last = None
+
+    while True:
+        data = ws.recv()
+        if isinstance(data, str) or len(data) != FRAME.size:
+            continue
+        ver, flags, seq, angle, temp, gravity, battery = FRAME.unpack(data)
+        gap = "" if last is None else " gap=%d" % ((seq - last) % 65536)
+        last = seq
+        print("%s seq=%d valid=%d moving=%d angle=%.2f temp=%.2f gravity=%.4f battery=%.3f%s" % (
+            time.strftime("%H:%M:%S"), seq, flags & 1, (flags >> 1) & 1, angle / 100, temp / 100,
+            gravity / 10000, battery / 1000, gap))
+        if args.slow:
+            time.sleep(args.slow)
+
+
+if __name__ == "__main__":
+    main()
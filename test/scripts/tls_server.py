@@ -0,0 +1,54 @@
+"""Local HTTPS server for testing TLS session resumption of the push targets.
+
+Create a self signed certificate and start the server:
+
+  openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj "/CN=test" \
+      -keyout key.pem -out cert.pem
+  python3 tls_server.py --port 8443
+
+Set the HTTP Post target to https://<ip of computer>:8443/post and check the
+log for "resumed=True" on the second and later wakes.
+"""
+import argparse, http.server, ssl, time
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        self.log_message("resumed=%s cipher=%s body=%s", self.connection.session_reused,
+                         self.connection.cipher()[0], body.decode(errors="replace"))
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    do_PUT = do_POST
+
+    def do_GET(self):
+        self.log_message("resumed=%s path=%s", self.connection.session_reused, self.path)
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--cert", default="cert.pem")
+    parser.add_argument("--key", default="key.pem")
+    args = parser.parse_args()
+
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(args.cert, args.key)
+    # BearSSL resumes with session id, keep the server side cache enabled
+    context.options &= ~ssl.OP_NO_TICKET
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+
+    server = http.server.HTTPServer(("0.0.0.0", args.port), Handler)
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(time.strftime("%H:%M:%S"), "Listening on port", args.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -13,31 +13,97 @@
 
 test(batt_percentage) {
     assertEqual(getBatteryPercentage(4.2, BatteryType::LithiumIon), 100.0);
-    assertEqual(getBatteryPercentage(4.1, BatteryType::LithiumIon), 92.0);
+    assertEqual(getBatteryPercentage(4.1, BatteryType::LithiumIon), 93.0);
     assertEqual(getBatteryPercentage(4.0, BatteryType::LithiumIon), 83.0);
-    assertEqual(getBatteryPercentage(3.9, BatteryType::LithiumIon), 75.0);
-    assertEqual(getBatteryPercentage(3.8, BatteryType::LithiumIon), 67.0);
-    assertEqual(getBatteryPercentage(3.7, BatteryType::LithiumIon), 58.0);
-    assertEqual(getBatteryPercentage(3.6, BatteryType::LithiumIon), 50.0);
-    assertEqual(getBatteryPercentage(3.5, BatteryType::LithiumIon), 42.0);
-    assertEqual(getBatteryPercentage(3.4, BatteryType::LithiumIon), 33.0);
-    assertEqual(getBatteryPercentage(3.3, BatteryType::LithiumIon), 25.0);
-    assertEqual(getBatteryPercentage(3.2, BatteryType::LithiumIon), 17.0);
-    assertEqual(getBatteryPercentage(3.1, BatteryType::LithiumIon), 8.0);
+    assertEqual(getBatteryPercentage(3.9, BatteryType::LithiumIon), 66.0);
+    assertEqual(getBatteryPercentage(3.8, BatteryType::LithiumIon), 43.0);
+    assertEqual(getBatteryPercentage(3.7, BatteryType::LithiumIon), 13.0);
+    assertEqual(getBatteryPercentage(3.6, BatteryType::LithiumIon), 8.0);
+    assertEqual(getBatteryPercentage(3.5, BatteryType::LithiumIon), 6.0);
+    assertEqual(getBatteryPercentage(3.4, BatteryType::LithiumIon), 4.0);
+    assertEqual(getBatteryPercentage(3.3, BatteryType::LithiumIon), 3.0);
+    assertEqual(getBatteryPercentage(3.2, BatteryType::LithiumIon), 2.0);
+    assertEqual(getBatteryPercentage(3.1, BatteryType::LithiumIon), 1.0);
     assertEqual(getBatteryPercentage(3.0, BatteryType::LithiumIon), 0.0);
 }
 
 test(batt_percentage2) {
     assertEqual(getBatteryPercentage(4.2, BatteryType::LiPo), 100.0);
     assertEqual(getBatteryPercentage(4.1, BatteryType::LiPo), 89.0);
-    assertEqual(getBatteryPercentage(4.0, BatteryType::LiPo), 78.0);
-    assertEqual(getBatteryPercentage(3.9, BatteryType::LiPo), 67.0);
-    assertEqual(getBatteryPercentage(3.8, BatteryType::LiPo), 56.0);
-    assertEqual(getBatteryPercentage(3.7, BatteryType::LiPo), 44.0);
-    assertEqual(getBatteryPercentage(3.6, BatteryType::LiPo), 33.0);
-    assertEqual(getBatteryPercentage(3.5, BatteryType::LiPo), 22.0);
-    assertEqual(getBatteryPercentage(3.4, BatteryType::LiPo), 11.0);
+    assertEqual(getBatteryPercentage(4.0, BatteryType::LiPo), 77.0);
+    assertEqual(getBatteryPercentage(3.9, BatteryType::LiPo), 64.0);
+    assertEqual(getBatteryPercentage(3.8, BatteryType::LiPo), 40.0);
+    assertEqual(getBatteryPercentage(3.7, BatteryType::LiPo), 13.0);
+    assertEqual(getBatteryPercentage(3.6, BatteryType::LiPo), 5.0);
+    assertEqual(getBatteryPercentage(3.5, BatteryType::LiPo), 3.0);
+    assertEqual(getBatteryPercentage(3.4, BatteryType::LiPo), 2.0);
     assertEqual(getBatteryPercentage(3.3, BatteryType::LiPo), 0.0);
 }
 
+test(batt_reduceSamples) {
+    uint32_t samples[] = {2010, 1990, 2000, 3500, 2005, 1995, 100, 2000};
+    assertEqual(reduceBatterySamples(samples, 8, 2), 2000.0);
+    assertEqual(samples[0], (uint32_t)100);
+    assertEqual(samples[7], (uint32_t)3500);
+
+    uint32_t samples2[] = {30, 10, 20};
+    assertEqual(reduceBatterySamples(samples2, 3, 2), 20.0);
+
+    uint32_t samples3[] = {40, 10, 20, 30};
+    assertEqual(reduceBatterySamples(samples3, 4, 2), 25.0);
+}
+
+class BatteryTestConfig : public BatteryConfigInterface {
+ public:
+    float getVoltageFactor() const { return 1.0; }
+    BatteryType getBatteryType() const { return BatteryType::LithiumIon; }
+    int getBatteryCapacity() const { return 2200; }
+    int getBatterySleepCurrent() const { return 100; }
+};
+
+test(batt_estimator) {
+    BatteryTestConfig cfg;
+    BatteryEstimatorData data = {0};
+    BatteryEstimator est(&cfg, &data);
+
+    est.addWake(4.0, 3.0, 900, 100);
+    assertNear(est.getRemainingMah(100), 2200.0, 1.0);
+    assertNear(est.getAverageCurrent(900), 0.497, 0.01);
+    assertNear(est.getRemainingDays(100, 900), 184.1, 1.0);
+
+    // Longer interval is needed to last a year
+    int interval = est.getSleepIntervalForDays(100, 365, 300, 3600);
+    assertMore(interval, 900);
+    assertMoreOrEqual(est.getRemainingDays(100, interval), 365.0);
+    assertEqual(est.getSleepIntervalForDays(100, 30, 300, 3600), 300);
+
+    // Large difference to the discharge curve restarts the counting
+    est.addWake(4.0, 3.0, 900, 50);
+    assertNear(est.getRemainingMah(50), 1100.0, 1.0);
+}
+
+test(batt_savingInterval) {
+    BatteryTestConfig cfg;
+    BatteryEstimatorData data = {0};
+    BatteryEstimator est(&cfg, &data);  // No history, level from the curve
+
+    // Not below the limit, the configured interval is used
+    assertEqual(est.getBatterySavingInterval(100, 900), 900);
+    assertEqual(est.getBatterySavingInterval(BATTERY_SAVING_PERCENT, 900), 900);
+
+    // Never shorter than the old fixed interval, even if 30 days are reached
+    // with a shorter one
+    assertEqual(est.getBatterySavingInterval(29.9, 900),
+                BATTERY_SAVING_MIN_INTERVAL);
+    assertEqual(est.getBatterySavingInterval(16, 900),
+                BATTERY_SAVING_MIN_INTERVAL);
+
+    // Longer when the charge does not last, bounded by the max
+    int interval = est.getBatterySavingInterval(6, 900);
+    assertMore(interval, BATTERY_SAVING_MIN_INTERVAL);
+    assertLessOrEqual(interval, BATTERY_SAVING_MAX_INTERVAL);
+    assertEqual(est.getBatterySavingInterval(0, 900),
+                BATTERY_SAVING_MAX_INTERVAL);
+}
+
 // EOF
@@ -7,6 +7,166 @@
 */
 
 
-// No unit testing for the BLE module.
+#include <AUnit.h>
+
+#include <bleencoder.hpp>
+#include <blehistory.hpp>
+
+// Values are binary fractions so the truncation in the encoders is exact
+
+test(ble_tiltFrame) {
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  const uint8_t red[] = {0x4c, 0x00, 0x02, 0x15, 0xa4, 0x95, 0xbb, 0x10,
+                         0xc5, 0xb1, 0x4b, 0x44, 0xb5, 0x12, 0x13, 0x70,
+                         0xf0, 0x2d, 0x74, 0xde, 0x00, 0x46, 0x04, 0x26,
+                         0xc5};
+
+  assertEqual(encodeTilt(&buf[0], getTiltColorIndex("red"), 70.5, 1.0625,
+                         false),
+              sizeof(red));
+  assertEqual(memcmp(&buf[0], &red[0], sizeof(red)), 0);
+
+  encodeTilt(&buf[0], getTiltColorIndex("yellow"), 70.5, 1.0625, true);
+  assertEqual(buf[7], 0x70);
+  assertEqual(buf[20] << 8 | buf[21], 705);    // F * 10
+  assertEqual(buf[22] << 8 | buf[23], 10625);  // SG * 10000
+
+  encodeTilt(&buf[0], getTiltColorIndex("unknown"), NAN, NAN, false);
+  assertEqual(buf[7], 0x80);  // Pink
+  assertEqual(buf[20] << 8 | buf[21], 0xffff);
+  assertEqual(buf[22] << 8 | buf[23], 0xffff);
+}
+
+test(ble_gravitymonFrame) {
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  const uint8_t frame[] = {0x4c, 0x00, 0x03, 0x15, 'G',  'R',  'A',
+                           'V',  'M',  'O',  'N',  '.',  0x00, 0x12,
+                           0x34, 0x56, 0x0a, 0x34, 0x0f, 0x61, 0x29,
+                           0x81, 0x4e, 0x9d, 0x00};
+
+  assertEqual(encodeGravitymonBeacon(&buf[0], 0x123456, 3.9375, 20.125,
+                                     1.0625, 26.125),
+              sizeof(frame));
+  assertEqual(memcmp(&buf[0], &frame[0], sizeof(frame)), 0);
+}
+
+test(ble_eddystoneFrame) {
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  const uint8_t frame[] = {0x20, 0x00, 0x0f, 0x61, 0x4e, 0x9d, 0x29,
+                           0x81, 0x0a, 0x34, 0x00, 0x12, 0x34, 0x56};
+
+  assertEqual(encodeEddystone(&buf[0], 0x123456, 3.9375, 20.125, 1.0625,
+                              26.125),
+              sizeof(frame));
+  assertEqual(memcmp(&buf[0], &frame[0], sizeof(frame)), 0);
+}
+
+test(ble_raptV1Frame) {
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  const BleRaptV1Frame* f = reinterpret_cast<BleRaptV1Frame*>(&buf[0]);
+
+  assertEqual(encodeRaptV1(&buf[0], 0x123456, 87.5, 20.125, 1.0625, 26.125),
+              sizeof(BleRaptV1Frame));
+  assertEqual(memcmp(&buf[0], "RAPT\x01\x00\x00\x00\x12\x34\x56", 11), 0);
+  assertNear(f->temp.get() / 128.0 - 273.15, 20.125, 0.01);
+  assertNear(f->gravity.get() / 1000, 1.0625, 0.0001);
+  assertEqual(f->x.get(), 418);  // angle * 16
+  assertEqual(f->y.get(), 0);
+  assertEqual(f->z.get(), 0);
+  assertEqual(f->battery.get(), 22400);  // % * 256
+  assertEqual(buf[13], 0x44);  // Big endian float 1062.5
+  assertEqual(buf[14], 0x84);
+  assertEqual(buf[15], 0xd0);
+  assertEqual(buf[16], 0x00);
+}
+
+test(ble_raptV2Frame) {
+  uint8_t buf[BLE_PAYLOAD_SIZE];
+  const BleRaptV2Frame* f = reinterpret_cast<BleRaptV2Frame*>(&buf[0]);
+
+  assertEqual(encodeRaptV2(&buf[0], 87.5, 20.125, 1.0625, 26.125, -2.5),
+              sizeof(BleRaptV2Frame));
+  assertEqual(memcmp(&buf[0], "RAPT\x02\x00\x01", 7), 0);
+  assertNear(f->velocity.get(), -2.5, 0.0001);
+  assertNear(f->temp.get() / 128.0 - 273.15, 20.125, 0.01);
+  assertNear(f->gravity.get() / 1000, 1.0625, 0.0001);
+  assertEqual(f->x.get(), 418);
+  assertEqual(f->battery.get(), 22400);
+
+  encodeRaptV2(&buf[0], 87.5, 20.125, 1.0625, 26.125, NAN);
+  assertEqual(f->velocityValid, 0);
+}
+
+test(ble_adStructure) {
+  uint8_t adv[BLE_ADV_DATA_SIZE], buf[BLE_PAYLOAD_SIZE];
+  const uint8_t flags = 0x04;
+
+  size_t len = addAdStructure(&adv[0], 0, BLE_AD_FLAGS, &flags, 1);
+  assertEqual(len, 3u);
+  assertEqual(adv[0], 0x02);
+  assertEqual(adv[1], 0x01);
+  assertEqual(adv[2], 0x04);
+
+  size_t tilt = encodeTilt(&buf[0], 0, 70, 1.05, false);
+  len = addAdStructure(&adv[0], len, BLE_AD_MANUFACTURER, &buf[0], tilt);
+  assertEqual(len, 3 + 2 + tilt);
+  assertEqual(adv[3], tilt + 1);
+  assertEqual(adv[4], 0xff);
+  assertEqual(adv[5], 0x4c);
+
+  // Does not fit, the data is unchanged
+  assertEqual(addAdStructure(&adv[0], len, BLE_AD_FLAGS, &flags, 1), len);
+}
+
+test(ble_historyPages) {
+  BleHistoryData data = {0};
+  BleHistory history(&data);
+  uint8_t buf[BLE_HISTORY_PAGE_SIZE];
+  const BleHistoryHeader* h = reinterpret_cast<BleHistoryHeader*>(&buf[0]);
+  const BleHistoryRecord* r =
+      reinterpret_cast<BleHistoryRecord*>(&buf[sizeof(BleHistoryHeader)]);
+
+  for (int i = 0; i < BLE_HISTORY_SIZE + 3; i++) {
+    MeasurementRecord m;
+    m.set(100 + i, -1.5, 20.25, 1.05, 1.049, -2.5, 3.95);
+    history.add(m);
+  }
+
+  // The oldest records are replaced when the ring is full
+  assertEqual(history.getCount(), BLE_HISTORY_SIZE);
+  assertEqual(history.getFirstSequence(), static_cast<uint32_t>(3));
+
+  history.setCursor(0);  // Before the oldest, nothing is dropped
+  assertEqual(history.getCount(), BLE_HISTORY_SIZE);
+
+  size_t len = history.readPage(&buf[0], 500);
+  int count = BLE_HISTORY_SIZE < BLE_HISTORY_PAGE ? BLE_HISTORY_SIZE
+                                                  : BLE_HISTORY_PAGE;
+  assertEqual(len, sizeof(BleHistoryHeader) + count * sizeof(*r));
+  assertEqual(h->sequence.get(), static_cast<uint32_t>(3));
+  assertEqual(h->clock.get(), static_cast<uint32_t>(500));
+  assertEqual(h->count, count);
+  assertEqual(r[0].time.get(), static_cast<uint32_t>(103));
+  assertEqual(static_cast<int16_t>(r[0].angle.get()), -150);
+  assertEqual(r[0].tempC.get(), 2025);
+  assertEqual(r[0].gravity.get(), 10500);
+  assertEqual(r[0].corrGravity.get(), 10490);
+  assertEqual(static_cast<int16_t>(r[0].velocity.get()), -250);
+  assertEqual(r[0].battery.get(), 3950);
+
+  // Pages continue from the cursor until the count is zero
+  while (h->count) history.readPage(&buf[0], 500);
+  assertEqual(history.getCursor(), history.getNextSequence());
+
+  // Writing the cursor acknowledges the records before it
+  history.setCursor(history.getNextSequence() - 2);
+  assertEqual(history.getCount(), 2);
+  history.readPage(&buf[0], 500);
+  assertEqual(h->count, 2);
+  assertEqual(r[1].time.get(),
+              static_cast<uint32_t>(100 + BLE_HISTORY_SIZE + 2));
+  history.setCursor(history.getNextSequence() + 10);
+  assertEqual(history.getCount(), 0);
+}
 
 // EOF
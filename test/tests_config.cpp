@@ -60,6 +60,25 @@ test(config_tempSensorResolution) {
   assertEqual(myConfig.getTempSensorResolution(), 12);
 }
 
+test(config_tempProbes) {
+  TempProbeConfig probe = {{0x28, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07},
+                           0.5, 2.0};
+
+  myConfig.clearTempProbeConfig();
+  assertEqual(myConfig.setTempProbeConfig(probe), true);
+  assertEqual(myConfig.getTempProbeCount(), 1);
+  assertEqual(myConfig.getTempProbeConfig(&probe.address[0])->weight, 2.0);
+  probe.address[7] = 0x08;
+  assertEqual(myConfig.getTempProbeConfig(&probe.address[0]) == nullptr, true);
+
+  myConfig.setTempSensorAggregation(TEMP_AGGREGATION_WEIGHTED);
+  assertEqual(myConfig.getTempSensorAggregation(), TEMP_AGGREGATION_WEIGHTED);
+  myConfig.setTempSensorAggregation(7);
+  assertEqual(myConfig.getTempSensorAggregation(), TEMP_AGGREGATION_WEIGHTED);
+  myConfig.setTempSensorAggregation(TEMP_AGGREGATION_FIRST);
+  myConfig.clearTempProbeConfig();
+}
+
 test(config_batterySaving) {
   myConfig.setBatterySaving(false);
   assertEqual(myConfig.isBatterySaving(), false);
@@ -67,6 +86,63 @@ test(config_batterySaving) {
   assertEqual(myConfig.isBatterySaving(), true);
 }
 
+test(config_pushBatch) {
+  assertEqual(myConfig.getPushBatch(), 1);
+  myConfig.setPushBatch(12);
+  assertEqual(myConfig.getPushBatch(), 12);
+  myConfig.setPushBatch(PUSH_BATCH_MAX + 1);
+  assertEqual(myConfig.getPushBatch(), 12);
+  myConfig.setPushBatch(1);
+}
+
+test(config_pushEncoding) {
+  assertEqual(myConfig.getHttpPostEncoding(), PUSH_ENCODING_TEMPLATE);
+  myConfig.setHttpPostEncoding(PUSH_ENCODING_MSGPACK);
+  assertEqual(myConfig.getHttpPostEncoding(), PUSH_ENCODING_MSGPACK);
+  myConfig.setHttpPostEncoding(3);
+  assertEqual(myConfig.getHttpPostEncoding(), PUSH_ENCODING_MSGPACK);
+  myConfig.setHttpPostEncoding(PUSH_ENCODING_TEMPLATE);
+  assertEqual(myConfig.getHttpPost2Encoding(), PUSH_ENCODING_TEMPLATE);
+
+  assertEqual(myConfig.getInfluxDb2Encoding(), PUSH_ENCODING_TEMPLATE);
+  myConfig.setInfluxDb2Encoding(PUSH_ENCODING_MSGPACK);
+  assertEqual(myConfig.getInfluxDb2Encoding(), PUSH_ENCODING_TEMPLATE);
+  myConfig.setInfluxDb2Encoding(PUSH_ENCODING_LINE_PROTOCOL);
+  assertEqual(myConfig.getInfluxDb2Encoding(), PUSH_ENCODING_LINE_PROTOCOL);
+  myConfig.setInfluxDb2Encoding(PUSH_ENCODING_TEMPLATE);
+  assertEqual(myConfig.isInfluxDb2Gzip(), false);
+}
+
+test(config_bleTiming) {
+  assertEqual(myConfig.getBleInterval(), 100);
+  assertEqual(myConfig.getBleWindow(), 1000);
+  assertEqual(myConfig.isBleAck(), false);
+  assertEqual(myConfig.isBleHistory(), false);
+  myConfig.setBleInterval(20);
+  assertEqual(myConfig.getBleInterval(), 100);
+  myConfig.setBleInterval(250);
+  assertEqual(myConfig.getBleInterval(), 250);
+  myConfig.setBleInterval(100);
+  myConfig.setBleWindow(250);
+  assertEqual(myConfig.getBleWindow(), 250);
+  myConfig.setBleWindow(20000);
+  assertEqual(myConfig.getBleWindow(), 250);
+  myConfig.setBleWindow(1000);
+}
+
+test(config_bleFormats) {
+  assertEqual(myConfig.getBleFormatExtra(), 0);
+  myConfig.setGravitymonBleFormat(GravitymonBleFormat::BLE_TILT);
+  assertEqual(myConfig.getBleFormats(), 1 << 1);
+  myConfig.setBleFormatExtra(1 << GravitymonBleFormat::BLE_RAPT_V2 | 1 << 3);
+  assertEqual(myConfig.getBleFormatExtra(), 1 << 7);
+  assertEqual(myConfig.getBleFormats(), 1 << 1 | 1 << 7);
+  myConfig.setGravitymonBleFormat(GravitymonBleFormat::BLE_DISABLED);
+  assertEqual(myConfig.isBleActive(), true);
+  myConfig.setBleFormatExtra(0);
+  assertEqual(myConfig.isBleActive(), false);
+}
+
 test(config_gravitymonValues) {
   assertEqual(myConfig.getDefaultCalibrationTemp(), 20.0);
   assertEqual(myConfig.getGyroReadCount(), 50);
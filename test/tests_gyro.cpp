@@ -32,4 +32,41 @@ test(gyro_readGyroTemp) {
   assertNotEqual(myGyro.getSensorTempC(), f);
 }
 
+test(gyro_tempCompFit) {
+  GyroTempCompCalibration cal;
+  GyroTempCompensation comp;
+
+  for (float t = 20.0; t < 30.0; t += 0.1) {
+    float d = t - 25.0;
+    cal.addSample(t, 45.0 + 0.05 * d + 0.01 * d * d);
+  }
+
+  assertEqual(cal.getNoBuckets(), 20);
+  assertEqual(cal.fit(&comp), true);
+  assertNear(comp.c2, 0.01, 0.001);
+  assertMore(cal.getRawDriftPerC(), 0.05);
+  assertLess(cal.getResidualDriftPerC(), 0.001);
+  assertNear(comp.getOffset(29.0) - comp.getOffset(21.0), 0.4, 0.01);
+}
+
+test(gyro_tempCompNotEnoughData) {
+  GyroTempCompCalibration cal;
+  GyroTempCompensation comp;
+
+  cal.addSample(20.0, 45.0);
+  cal.addSample(21.0, 45.1);
+  assertEqual(cal.fit(&comp), false);
+}
+
+test(gyro_tempCompBucketFull) {
+  GyroTempCompCalibration cal;
+
+  for (int i = 0; i < TEMPCOMP_BUCKET_MAX_SAMPLES; i++)
+    assertEqual(cal.addSample(20.0, 45.0), true);
+
+  assertEqual(cal.addSample(20.0, 45.0), false);
+  assertEqual(cal.getNoSamples(), TEMPCOMP_BUCKET_MAX_SAMPLES);
+  assertEqual(cal.addSample(21.0, 45.0), true);
+}
+
 // EOF
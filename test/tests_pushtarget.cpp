@@ -7,7 +7,94 @@
 */
 
 
+#include <AUnit.h>
+
+#include <measurementqueue.hpp>
+#include <pushdispatch.hpp>
+#include <pushscheduler.hpp>
+
 // TODO: Build some php scripts that run on gravitymon.com for testing the push
 // data.
 
+test(queue_record) {
+  MeasurementRecord r;
+
+  assertEqual(sizeof(MeasurementRecord), 16U);
+  r.set(3600, 45.123, -1.5, 1.0512, 1.0498, -2.35, 3.912);
+  assertEqual(r.time, static_cast<uint32_t>(3600));
+  assertNear(r.getAngle(), 45.12, 0.001);
+  assertNear(r.getTempC(), -1.5, 0.001);
+  assertNear(r.getGravity(), 1.0512, 0.00001);
+  assertNear(r.getCorrGravity(), 1.0498, 0.00001);
+  assertNear(r.getVelocity(), -2.35, 0.001);
+  assertNear(r.getBattery(), 3.912, 0.0001);
+}
+
+test(queue_recordInvalid) {
+  MeasurementRecord r;
+
+  r.set(0, NAN, NAN, NAN, NAN, NAN, NAN);
+  assertTrue(isnan(r.getAngle()));
+  assertTrue(isnan(r.getTempC()));
+  assertTrue(isnan(r.getGravity()));
+  assertTrue(isnan(r.getCorrGravity()));
+  assertTrue(isnan(r.getVelocity()));
+  assertTrue(isnan(r.getBattery()));
+
+  // Out of range values are clamped and never read back as NaN
+  r.set(0, 400, -400, 7.5, -1, 1e9, 70);
+  assertNear(r.getAngle(), 327.67, 0.001);
+  assertNear(r.getTempC(), -327.67, 0.001);
+  assertNear(r.getGravity(), 6.5534, 0.00001);
+  assertNear(r.getCorrGravity(), 0, 0.00001);
+  assertNear(r.getVelocity(), 327.67, 0.001);
+  assertNear(r.getBattery(), 65.534, 0.0001);
+}
+
+test(push_schedulerInterval) {
+  PushScheduleData data = {0};
+  PushScheduler scheduler(&data);
+
+  scheduler.clear();
+  assertTrue(scheduler.isDue(0, 0, 900));
+  assertTrue(scheduler.isDue(0, 2, 900));  // Never pushed
+  scheduler.setDone(0);
+  assertFalse(scheduler.isDue(0, 2, 900));
+  assertTrue(scheduler.isDue(1, 2, 900));
+
+  scheduler.advanceDeviceClock(900);
+  assertFalse(scheduler.isDue(0, 2, 900));
+  scheduler.advanceDeviceClock(900);
+  assertFalse(scheduler.isDue(0, 2, 900));
+  scheduler.advanceDeviceClock(900);
+  assertTrue(scheduler.isDue(0, 2, 900));
+
+  // A stretched sleep interval counts as several skipped wakes
+  scheduler.setDone(0);
+  scheduler.advanceDeviceClock(3600);
+  assertTrue(scheduler.isDue(0, 2, 900));
+}
+
+test(push_mqttEncode) {
+  String doc = "gm/tilt:45.1| gm/temp : 21.2 |gm/unit:C";
+  uint8_t buf[128];
+
+  size_t size = AsyncMqttRequest::encode(nullptr, "gm", "", "", doc, false);
+  assertEqual(AsyncMqttRequest::encode(&buf[0], "gm", "", "", doc, false),
+              size);
+  assertLess(size, sizeof(buf));
+  assertEqual(buf[0], 0x10);         // CONNECT
+  assertEqual(buf[size - 2], 0xe0);  // DISCONNECT
+  assertEqual(buf[size - 1], 0x00);
+
+  int publish = 0;
+  for (size_t i = 0; i < size - 2; i += 2 + buf[i + 1]) {
+    if (buf[i] == 0x30) publish++;
+  }
+  assertEqual(publish, 3);
+
+  AsyncMqttRequest::encode(&buf[0], "gm", "", "", doc, true);
+  assertEqual(buf[16], 0x31);  // Retained PUBLISH after the 16 byte CONNECT
+}
+
 // EOF
@@ -8,8 +8,12 @@
 
 
 #include <AUnit.h>
+#include <log.hpp>
 
 #include <templating.hpp>
+#include <gzip.hpp>
+#include <lineprotocol.hpp>
+#include <payloadencoder.hpp>
 #include <pushtarget.hpp>
 #include <config_gravitymon.hpp>
 #include <push_gravitymon.hpp>
@@ -146,4 +150,229 @@ test(template_applyTemplate7) {
   assertEqual(s, v);
 }
 
+test(template_compiledUnknownKey) {
+  TemplateValues values;
+  CompiledTemplate tpl;
+
+  values.setVal(TPL_GRAVITY, 1.0512f, 3);
+  values.setVal(TPL_TEMP_UNITS, 'C');
+  assertEqual(tpl.compile("${gravity};${temp-unit};${pressure};${nokey}$"),
+              true);
+  assertEqual(tpl.getTokenCount(), 6);
+  assertEqual(tpl.render(values), "1.051;C;${pressure};${nokey}$");
+}
+
+test(template_compiledNeededValues) {
+  TemplateValues values;
+  CompiledTemplate tpl;
+
+  assertEqual(tpl.compile("${gravity};${battery-percent}"), true);
+  values.setNeeded(tpl.getVariables());
+  setupTemplateEngineGravity(&myConfig, values, 45.0, 0, 1.123, 1.223, 21.2,
+                             2.98, 4.20);
+
+  assertEqual(values.hasVal(getTemplateVariableId(TPL_GRAVITY)), true);
+  assertEqual(values.hasVal(getTemplateVariableId(TPL_ANGLE)), false);
+  assertEqual(values.hasVal(getTemplateVariableId(TPL_RSSI)), false);
+  assertEqual(values.hasVal(getTemplateVariableId(TPL_BATTERY_DAYS)), false);
+  assertEqual(values.getType(getTemplateVariableId(TPL_GRAVITY)),
+              TEMPLATE_VALUE_FLOAT);
+  assertEqual(tpl.render(values), "1.1230;100");
+}
+
+test(template_cache) {
+  BrewingPush p(&myConfig);
+  uint32_t misses = myTemplateCache.getMisses();
+  uint16_t generation = myTemplateCache.getGeneration();
+
+  myTemplateCache.invalidate();
+  assertEqual(myTemplateCache.getGeneration(), generation + 1);
+
+  const CompiledTemplate& first =
+      p.getCompiledTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1);
+  uint32_t hits = myTemplateCache.getHits();
+  const CompiledTemplate& second =
+      p.getCompiledTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1);
+
+  assertEqual(&first, &second);
+  assertEqual(myTemplateCache.getHits(), hits + 1);
+  assertEqual(myTemplateCache.getMisses(), misses + 1);
+
+  // Pressure uses its own slot for the same target
+  p.getCompiledTemplate(BrewingPush::PRESSURE_TEMPLATE_HTTP1);
+  assertEqual(myTemplateCache.getMisses(), misses + 2);
+
+  // Only dropped when the slot is used again
+  myTemplateCache.invalidate();
+  assertTrue(first.isCompiled());
+  assertTrue(myTemplateCache.get(BrewingPush::getTemplateSlot(
+                 BrewingPush::GRAVITY_TEMPLATE_HTTP1)) == nullptr);
+}
+
+test(template_slots) {
+  const BrewingPush::Templates formats[] = {
+      BrewingPush::GRAVITY_TEMPLATE_HTTP1,
+      BrewingPush::GRAVITY_TEMPLATE_HTTP2,
+      BrewingPush::GRAVITY_TEMPLATE_HTTP3,
+      BrewingPush::GRAVITY_TEMPLATE_INFLUX,
+      BrewingPush::GRAVITY_TEMPLATE_MQTT,
+      BrewingPush::PRESSURE_TEMPLATE_HTTP1,
+      BrewingPush::PRESSURE_TEMPLATE_HTTP2,
+      BrewingPush::PRESSURE_TEMPLATE_HTTP3,
+      BrewingPush::PRESSURE_TEMPLATE_INFLUX,
+      BrewingPush::PRESSURE_TEMPLATE_MQTT};
+  uint32_t used = 0;
+
+  for (BrewingPush::Templates f : formats) {
+    int slot = BrewingPush::getTemplateSlot(f);
+    assertLess(slot, TEMPLATE_CACHE_SLOTS);
+    assertEqual((used >> slot) & 1, static_cast<uint32_t>(0));
+    used |= 1 << slot;
+  }
+}
+
+test(template_valueTruncated) {
+  CompiledTemplate tpl;
+  TemplateValues values;
+  char buf[301];
+
+  memset(&buf[0], 'a', 300);
+  buf[300] = 0;
+  tpl.compile("${mdns};${id};${token};${token2}");
+  values.setVal(TPL_MDNS, &buf[0]);  // Longer than a value can be
+  values.setVal(TPL_ID, &buf[0]);
+  values.setVal(TPL_TOKEN, &buf[0]);
+  values.setVal(TPL_TOKEN2, &buf[0]);  // Buffer is full
+
+  String out = tpl.render(values);
+  assertEqual(out.indexOf("${"), -1);
+  assertEqual(values.getLength(getTemplateVariableId(TPL_MDNS)),
+              static_cast<size_t>(255));
+  assertEqual(values.getLength(getTemplateVariableId(TPL_TOKEN2)),
+              static_cast<size_t>(0));
+  assertEqual(out.length(), static_cast<size_t>(3 * 255 + 3));
+}
+
+// Compare the compiled templates with the templating engine for the five
+// gravity formats, output must be identical. The time for setting up the
+// values and rendering is logged for both.
+test(template_compiledMatchesEngine) {
+  const BrewingPush::Templates formats[] = {
+      BrewingPush::GRAVITY_TEMPLATE_HTTP1, BrewingPush::GRAVITY_TEMPLATE_HTTP2,
+      BrewingPush::GRAVITY_TEMPLATE_HTTP3, BrewingPush::GRAVITY_TEMPLATE_INFLUX,
+      BrewingPush::GRAVITY_TEMPLATE_MQTT};
+  const int loops = 20;
+  myConfig.setMDNS("gravitymon");
+
+  for (BrewingPush::Templates f : formats) {
+    BrewingPush p(&myConfig);
+    String t = p.getTemplate(f);
+    String engineOut, compiledOut;
+
+    uint32_t start = micros();
+    for (int i = 0; i < loops; i++) {
+      TemplatingEngine e;
+      setupTemplateEngineGravity(&myConfig, e, 45.0, 0, 1.123, 1.223, 21.2,
+                                 2.98, 3.88);
+      engineOut = e.create(t.c_str());
+      e.freeMemory();
+    }
+    uint32_t engineTime = (micros() - start) / loops;
+
+    start = micros();
+    for (int i = 0; i < loops; i++) {
+      TemplateValues values;
+      setupTemplateEngineGravity(&myConfig, values, 45.0, 0, 1.123, 1.223,
+                                 21.2, 2.98, 3.88);
+      compiledOut = p.renderTemplate(f, values);
+    }
+    uint32_t compiledTime = (micros() - start) / loops;
+
+    assertEqual(engineOut, compiledOut);
+    Log.notice(F("TEST: Format %d, %d bytes, engine %uus, compiled %uus." CR),
+               f, compiledOut.length(), engineTime, compiledTime);
+  }
+}
+
+test(template_payloadEncoding) {
+  BrewingPush p(&myConfig);
+  TemplateValues values;
+  uint8_t buf[PAYLOAD_BUFFER_SIZE];
+
+  setupTemplateEngineGravity(&myConfig, values, 45.0, 0, 1.123, 1.223, 21.2,
+                             2.98, 3.88);
+  String json = p.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1, values);
+  size_t msgpack = encodeMsgPack(values, false, &buf[0], sizeof(buf));
+  size_t binary = encodeBinary(values, &buf[0], sizeof(buf));
+
+  assertEqual(buf[0], 0x20);
+  assertEqual(buf[2] << 8 | buf[3], 3880);  // Battery, mV
+  assertEqual(buf[6] << 8 | buf[7], 11230);  // Gravity, SG * 10000
+  assertEqual(buf[8] << 8 | buf[9], 4500);   // Angle * 100
+  assertEqual(binary, static_cast<size_t>(PAYLOAD_BINARY_SIZE));
+  assertLess(msgpack, json.length());
+  assertEqual(encodeMsgPack(values, false, &buf[0], 20),
+              static_cast<size_t>(0));
+
+  const int loops = 100;
+  uint32_t start = micros();
+  for (int i = 0; i < loops; i++)
+    p.renderTemplate(BrewingPush::GRAVITY_TEMPLATE_HTTP1, values);
+  uint32_t jsonTime = (micros() - start) / loops;
+
+  start = micros();
+  for (int i = 0; i < loops; i++)
+    encodeMsgPack(values, false, &buf[0], sizeof(buf));
+  uint32_t msgpackTime = (micros() - start) / loops;
+
+  start = micros();
+  for (int i = 0; i < loops; i++) encodeBinary(values, &buf[0], sizeof(buf));
+  uint32_t binaryTime = (micros() - start) / loops;
+
+  Log.notice(F("TEST: Payload json %d bytes %uus, msgpack %d bytes %uus, "
+               "binary %d bytes %uus." CR),
+             json.length(), jsonTime, msgpack, msgpackTime, binary,
+             binaryTime);
+}
+
+test(template_lineProtocol) {
+  TemplateValues values;
+  String body;
+  LineProtocolWriter w(body);
+
+  values.setVal(TPL_MDNS, "my gravity,1");
+  values.setVal(TPL_ID, "e3a4b2");
+  values.setVal(TPL_TEMP_UNITS, 'C');
+  values.setVal(TPL_GRAVITY, 1.0501f, 4);
+  values.setVal(TPL_VELOCITY, NAN, 1);
+  values.setVal(TPL_RSSI, -60);
+  assertTrue(writeLineProtocol(w, values, false));
+  assertEqual(body.c_str(),
+              "measurement,device=e3a4b2,host=my\\ gravity\\,1,"
+              "temp-format=C gravity=1.0501,rssi=-60");
+
+  values.setVal(TPL_TIMESTAMP, 1700000000);
+  assertTrue(writeLineProtocol(w, values, false));
+  assertTrue(body.endsWith("rssi=-60 1700000000000000000"));
+
+  TemplateValues empty;
+  String before = body;
+  assertFalse(writeLineProtocol(w, empty, false));
+  assertEqual(body, before);
+  assertEqual(w.getLineCount(), 2);
+
+  uint8_t buf[256];
+  size_t length = gzipCompress(reinterpret_cast<const uint8_t*>(body.c_str()),
+                               body.length(), &buf[0], sizeof(buf));
+  assertMore(length, static_cast<size_t>(GZIP_OVERHEAD));
+  assertLess(length, body.length());
+  assertEqual(buf[0], 0x1f);
+  assertEqual(buf[1], 0x8b);
+  assertEqual(getCrc32(reinterpret_cast<const uint8_t*>("123456789"), 9),
+              static_cast<uint32_t>(0xcbf43926));
+  assertEqual(gzipCompress(reinterpret_cast<const uint8_t*>(body.c_str()),
+                           body.length(), &buf[0], 20),
+              static_cast<size_t>(0));
+}
+
 // EOF
@@ -23,4 +23,44 @@ test(temp_readSensor) {
   assertEqual(myTempSensor.isSensorAttached(), true);
 }
 
+test(temp_readSensorResolution) {
+  myConfig.setTempSensorResolution(10);
+  myTempSensor.setup(PIN_DS);
+  myTempSensor.readSensor();
+  assertMoreOrEqual(myTempSensor.getSensorCount(), 1);
+  assertEqual(myTempSensor.getSensorResolution(), 10);
+  myConfig.setTempSensorResolution(9);
+}
+
+test(temp_aggregate) {
+  float temps[] = {20.0, 22.0, NAN, 24.0};
+  float weights[] = {1.0, 1.0, 1.0, 2.0};
+
+  assertEqual(aggregateTemperatures(temps, weights, 4,
+                                    TEMP_AGGREGATION_FIRST), 20.0);
+  assertEqual(aggregateTemperatures(temps, weights, 4,
+                                    TEMP_AGGREGATION_MEAN), 22.0);
+  assertEqual(aggregateTemperatures(temps, weights, 4,
+                                    TEMP_AGGREGATION_MIN), 20.0);
+  assertEqual(aggregateTemperatures(temps, weights, 4,
+                                    TEMP_AGGREGATION_MAX), 24.0);
+  assertEqual(aggregateTemperatures(temps, weights, 4,
+                                    TEMP_AGGREGATION_WEIGHTED), 22.5);
+  assertTrue(isnan(aggregateTemperatures(temps, weights, 0,
+                                         TEMP_AGGREGATION_MEAN)));
+}
+
+test(temp_addressString) {
+  uint8_t adr[8] = {0x28, 0x0a, 0xff, 0x01, 0x00, 0x00, 0x00, 0xb2};
+  uint8_t adr2[8];
+  char buf[17];
+
+  convertTempAddressToString(adr, buf, sizeof(buf));
+  assertEqual(buf, "280aff01000000b2");
+  assertEqual(convertTempAddressFromString(buf, adr2), true);
+  assertEqual(memcmp(adr, adr2, 8), 0);
+  assertEqual(convertTempAddressFromString("280aff01", adr2), false);
+  assertEqual(convertTempAddressFromString("280aff01000000g2", adr2), false);
+}
+
 // EOF